@@ -9,109 +9,466 @@
 #include <mutex>
 #include <algorithm>
 #include <numeric>
+#include <future>
+#include <atomic>
+#include <memory>
+#include <string_view>
+#include <stdexcept>
+#include <sstream>
+#include <chrono>
 #include <nlohmann/json.hpp> // JSON library: https://github.com/nlohmann/json
+#include "thread_pool.hpp"
+#include "logger.hpp"
+#include "compiler.hpp"
+#include "qasm.hpp"
+#include "feedback.hpp"
+#include "qec.hpp"
+#include "compile_cache.hpp"
+#include "shots.hpp"
+#include "decoder.hpp"
+#include "calibration.hpp"
+#include "backend.hpp"
+#include "statevector.hpp"
+#include "stabilizer.hpp"
+#include "job_queue.hpp"
+#include "metrics.hpp"
+#include "result_store.hpp"
+#include "parallel_shots.hpp"
+#include "rng.hpp"
+#include "pulse.hpp"
 
 using json = nlohmann::json;
-std::mutex log_mutex;
 
 // --------------------------
 // Hardware Interface
 // --------------------------
 namespace HardwareInterface {
-    void calibrate(int q) {
-        std::cout << "[Hardware] Calibrating qubit " << q << std::endl;
+    // Readout feedlines that digitize independently; shots can be read on all
+    // of them at once.
+    constexpr int readout_channels = 8;
+
+    QubitCalibration calibrate(int q) {
+        ScopedHwTimer timer(HwOp::Calibrate, 0, q);
+        if(consoleEnabled(Trace)) ConsoleLine() << "[Hardware] Calibrating qubit " << q;
         std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        QubitCalibration c;
+        c.frequency_ghz = 5.0f + 0.001f*q; // Replace with measured drive frequency
+        c.pi_amplitude = 0.5f;
+        return c;
     }
 
-    void sendPulse(int q, const std::string &gate) {
-        std::cout << "[Hardware] Applying " << gate << " to qubit " << q << std::endl;
-        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    // Quick check that a stored calibration still holds (e.g. one Rabi point).
+    bool healthCheck(int q) {
+        ScopedHwTimer timer(HwOp::HealthCheck, 0, q);
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        return true;
     }
 
-    void sendTwoQubitPulse(int q1, int q2, const std::string &gate) {
-        std::cout << "[Hardware] Applying " << gate << " to qubits " << q1 << "," << q2 << std::endl;
-        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    // One pulse program (see pulse.hpp): a single DMA transfer of the image
+    // and one trigger. It pays the round trip a lone gate used to pay, plus
+    // the transfer at 1 GB/s and the program's own duration.
+    void runPulseProgram(const unsigned char *image, size_t bytes, uint32_t duration_ns) {
+        ScopedHwTimer timer(HwOp::PulseProgram, 0, -1);
+        if(consoleEnabled(Trace)) ConsoleLine() << "[Hardware] Uploading pulse program: " << bytes << " bytes, " << duration_ns << " ns";
+        std::this_thread::sleep_for(std::chrono::milliseconds(2) + std::chrono::nanoseconds(bytes + duration_ns));
     }
 
     int readState(int q) {
-        return rand() % 2; // Replace with real hardware readout
+        ScopedHwTimer timer(HwOp::ReadState, 0, q);
+        return (int)(threadRng()() >> 63); // Replace with real hardware readout
+    }
+
+    // Whole-register readout for one shot. Stand-in bits come from the
+    // counter-based stream: reproducible per (stream, shot, qubit).
+    void readRegister(const std::vector<int> &qubits, const CounterRng &stream, uint64_t shot, uint64_t *row) {
+        ScopedHwTimer timer(HwOp::ReadState, 0, -1);
+        stream.gather(shot, qubits.data(), qubits.size(), row);
     }
 }
 
+// Lab hardware behind the Backend interface. Gates are lowered into the
+// sequencer's open pulse program, which goes out on flush() or before
+// anything that must see their effect (readout, calibration, reset). Pulses
+// only append to that program, so they are issued one at a time.
+class HardwareBackend : public Backend {
+private:
+    int n;
+    CounterRng stream{rngSeed(), rngStream(0, 0)};
+    PulseSequencer sequencer;
+public:
+    explicit HardwareBackend(int qubits)
+        : n(qubits), sequencer(qubits, [](const unsigned char *image, size_t bytes, uint32_t ns) { HardwareInterface::runPulseProgram(image, bytes, ns); }) {}
+    const char *name() const override { return "hardware"; }
+    int numQubits() const override { return n; }
+    QubitCalibration calibrate(int q) override {
+        sequencer.flush();
+        QubitCalibration c = HardwareInterface::calibrate(q);
+        sequencer.setCalibration(q, c);
+        return c;
+    }
+    void setCalibration(int q, const QubitCalibration &c) override { sequencer.setCalibration(q, c); }
+    bool healthCheck(int q) override { sequencer.flush(); return HardwareInterface::healthCheck(q); }
+    void sendPulse(int q, GateOp op) override { sequencer.gate(op, q); }
+    void sendTwoQubitPulse(int q1, int q2, GateOp op) override { sequencer.twoQubit(op, q1, q2); }
+    bool supportsUnitary() const override { return true; }
+    void sendUnitary(int q, const double params[3]) override { sequencer.unitary(q, params); }
+    void sendRotation(int q, GateOp op, double angle) override { sequencer.rotation(op, q, angle); }
+    void sendControlledPhase(int q1, int q2, double angle) override { sequencer.twoQubit(GateOp::CPHASE, q1, q2, angle); }
+    int readState(int q) override { sequencer.flush(); return HardwareInterface::readState(q); }
+    void readRegister(const std::vector<int> &qubits, uint64_t shot, uint64_t *row) override { sequencer.flush(); HardwareInterface::readRegister(qubits, stream, shot, row); }
+    void setRngStream(uint64_t s) override { stream = CounterRng(rngSeed(), s); }
+    void reset() override { sequencer.reset(); }
+    void flush() override { sequencer.flush(); }
+    bool concurrentPulses() const override { return false; }
+    int readoutChannels() const override { return HardwareInterface::readout_channels; }
+
+    PulseStats pulseStats() { return sequencer.stats(); }
+};
+
 // --------------------------
 // Quantum Computer
 // --------------------------
 class QuantumComputer {
 private:
+    std::unique_ptr<Backend> backend;
     int num_qubits;
-    std::vector<bool> calibrated;
-    std::string log_file = "qc_lab_100qubits_cpp.json";
+    std::vector<uint8_t> calibrated; // one byte per qubit: written concurrently during calibration
+    std::vector<QubitCalibration> calibration;
+    std::string log_file;
+    AsyncLogger logger;
+    ThreadPool pool; // declared after the logger so workers stop first
+    std::shared_ptr<const LogicalDecoder> decoder = std::make_shared<MajorityDecoder>();
+    std::atomic<uint64_t> calibration_epoch{0}; // bumped whenever a qubit's calibration changes
+    CompileCache<CompiledCircuit> compile_cache;
+    std::unique_ptr<result_store::ResultWriter> result_writer; // binary shot records, off by default
+    uint64_t last_circuit = 0;                            // structural hash of the last run(), for result records
+    std::atomic<uint64_t> next_shot{0};                   // shot counter into the backend's random stream
+    std::shared_ptr<const CouplingMap> coupling;          // null: any pair can take a two-qubit gate
+    ClassicalRegister creg;                               // mid-circuit readouts of the current run
+    ArenaPool arenas;                                     // per-job scratch of shot runs and readouts
 
-    void log(const json &entry) {
-        std::lock_guard<std::mutex> guard(log_mutex);
-        std::ofstream f(log_file, std::ios::app);
-        if(f.is_open()) { f << entry.dump() << "\n"; f.close(); }
+    void checkCoupled(GateOp op, int q1, int q2) const {
+        if(coupling && !coupling->connected(q1, q2))
+            throw std::invalid_argument(std::string("QuantumComputer: ") + gateName(op) + " on " + std::to_string(q1) + "," + std::to_string(q2) + " has no coupler");
+    }
+
+    // Cold-path entries only; per-gate events use the logger's compact encoders.
+    void log(const json &entry) { logger.raw(entry.dump()); }
+
+    // With a result file, shots go there as a binary record and the JSON entry
+    // only references it; otherwise `summary` is embedded as before.
+    template<typename Summary>
+    void logResults(json entry, const ShotBuffer &shots, Summary &&summary) {
+        if(result_writer) entry["record"] = result_writer->write(shots, {last_circuit, calibration_epoch.load(), (uint64_t)wallClockMs()});
+        else entry["results"] = summary();
+        log(entry);
     }
 
 public:
-    QuantumComputer(int n=100) : num_qubits(n), calibrated(n,false) {
-        srand(time(0));
+    // workers == 0 sizes the gate pool to the hardware threads; pass the
+    // number of control channels to match the lab's electronics instead.
+    QuantumComputer(int n=100, unsigned workers=0) : QuantumComputer(std::make_unique<HardwareBackend>(n), workers) {}
+
+    // Any backend, e.g. a simulator; the qubit count comes from the backend.
+    explicit QuantumComputer(std::unique_ptr<Backend> b, unsigned workers=0, std::string log_path="qc_lab_100qubits_cpp.json")
+        : backend(std::move(b)), num_qubits(backend->numQubits()), calibrated(num_qubits,false), calibration(num_qubits),
+          log_file(std::move(log_path)), logger(log_file), pool(workers) {}
+
+    Backend &device() { return *backend; }
+
+    // Chip connectivity. Two-qubit gates off a coupler are rejected, and
+    // circuits compiled through QuantumCircuit are routed onto the map.
+    void setCouplingMap(std::shared_ptr<const CouplingMap> map) {
+        if(map && map->numQubits() != num_qubits) throw std::invalid_argument("QuantumComputer::setCouplingMap: map is for " + std::to_string(map->numQubits()) + " qubits");
+        coupling = std::move(map);
     }
+    const CouplingMap *couplingMap() const { return coupling.get(); }
 
-    void calibrateQubit(int q) {
-        HardwareInterface::calibrate(q);
+    QubitCalibration calibrateQubit(int q) {
+        QubitCalibration c = backend->calibrate(q);
+        c.timestamp_ms = wallClockMs();
+        c.status = Calibrated;
+        calibration[q] = c;
         calibrated[q] = true;
-        log({{"action","calibrate"},{"qubit",q}});
+        calibration_epoch++;
+        logger.calibrate(q);
+        return c;
     }
 
-    // Parallel single-qubit gate
-    void applyGateParallel(const std::string &gate, const std::vector<int> &qubits) {
-        std::vector<std::thread> threads;
-        for(int q : qubits) {
-            threads.emplace_back([this, gate, q]() {
-                if(calibrated[q]) {
-                    HardwareInterface::sendPulse(q, gate);
-                    log({{"action","gate"},{"gate",gate},{"qubits",{q}}});
-                }
-            });
+    // Calibrate every qubit, driving up to `lines` control lines at once.
+    CalibrationReport calibrateAll(unsigned lines=8, const CalibrationProgress &progress={}) {
+        return calibrateConcurrent(0, num_qubits, lines, [this](int q) { calibrateQubit(q); }, progress);
+    }
+
+    // Warm start: reuse snapshot entries younger than `ttl` that pass a health
+    // check, recalibrate everything else, then persist the refreshed snapshot.
+    CalibrationReport calibrateFromSnapshot(const std::string &path, std::chrono::milliseconds ttl, unsigned lines=8, const CalibrationProgress &progress={}) {
+        CalibrationSnapshot snapshot(0, num_qubits);
+        snapshot.load(path);
+        CalibrationReport report = calibrateIncremental(0, snapshot, ttl, lines,
+            [this](int q) { return calibrateQubit(q); },
+            [this](int q, const QubitCalibration &c) { calibration[q] = c; calibrated[q] = true; calibration_epoch++; backend->setCalibration(q, c); },
+            [this](int q) { return backend->healthCheck(q); }, progress);
+        snapshot.save(path);
+        return report;
+    }
+
+    const QubitCalibration &calibrationOf(int q) const { return calibration[q]; }
+    uint64_t calibrationEpoch() const { return calibration_epoch; }
+
+    // Compile through the cache: resubmitting the same circuit for this
+    // device, options and calibration epoch returns the earlier result (the
+    // same object, so the job queue can batch its runs).
+    std::shared_ptr<const CompiledCircuit> compileCached(const CircuitIR &ir, const CompileOptions &opts = {}) {
+        CompileKey key{structuralHash(ir), hashTarget(std::string(backend->name()) + "/" + std::to_string(num_qubits)), calibration_epoch, hashOptions(opts)};
+        return compile_cache.getOrBuild(key, ir.instructions(), [&]() { return compile(ir, opts); }, compiledBytes);
+    }
+
+    CompileCacheStats compileCacheStats() { return compile_cache.stats(); }
+
+    // Send measurement shots to a binary result file (see result_store.hpp)
+    // instead of embedding them in the JSON log. Call before measuring.
+    void recordResults(const std::string &path, result_store::WriterOptions opts = {}) {
+        result_writer = std::make_unique<result_store::ResultWriter>(path, opts);
+    }
+    void flushResults() { if(result_writer) result_writer->flush(); }
+
+    void applyGate(GateOp op, int q) {
+        if(calibrated[q]) {
+            backend->sendPulse(q, op);
+            logger.gate(gateName(op), q);
         }
-        for(auto &t: threads) t.join();
     }
 
-    void applyTwoQubitGate(const std::string &gate, int q1, int q2) {
+    void applyGate(std::string_view gate, int q) { applyGate(gateOp(gate), q); }
+
+    // Queue a gate on the worker pool; the future completes once the pulse is
+    // sent. Gates submitted while the device is busy share its next upload.
+    std::future<void> submitGate(GateOp op, int q) {
+        return pool.submit([this, op, q]() { applyGate(op, q); backend->flush(); });
+    }
+
+    std::future<void> submitTwoQubitGate(GateOp op, int q1, int q2) {
+        return pool.submit([this, op, q1, q2]() { applyTwoQubitGate(op, q1, q2); backend->flush(); });
+    }
+
+    std::future<void> submit(const Instruction &in) {
+        return pool.submit([this, in]() { apply(in); backend->flush(); });
+    }
+
+    std::future<void> submitGate(std::string_view gate, int q) { return submitGate(gateOp(gate), q); }
+    std::future<void> submitTwoQubitGate(std::string_view gate, int q1, int q2) { return submitTwoQubitGate(gateOp(gate), q1, q2); }
+
+    // Parallel single-qubit gate (one pulse program on hardware)
+    void applyGateParallel(const std::string &gate, const std::vector<int> &qubits) {
+        GateOp op = gateOp(gate);
+        if(!backend->concurrentPulses()) for(int q : qubits) applyGate(op, q);
+        else pool.parallelFor(qubits.size(), [this, op, &qubits](size_t i) { applyGate(op, qubits[i]); });
+        backend->flush();
+    }
+
+    void applyTwoQubitGate(GateOp op, int q1, int q2) {
+        checkCoupled(op, q1, q2);
         if(calibrated[q1] && calibrated[q2]) {
-            HardwareInterface::sendTwoQubitPulse(q1,q2,gate);
-            log({{"action","two_qubit_gate"},{"gate",gate},{"qubits",{q1,q2}}});
+            backend->sendTwoQubitPulse(q1,q2,op);
+            logger.twoQubitGate(gateName(op), q1, q2);
         }
     }
 
-    // Physical measurement
-    std::map<int,std::map<std::string,int>> measurePhysical(const std::vector<int> &qubits, int shots=1) {
-        std::map<int,std::map<std::string,int>> results;
-        for(auto q:qubits) results[q] = {{"0",0},{"1",0}};
-        for(int s=0;s<shots;s++){
-            for(auto q:qubits){
-                int val = HardwareInterface::readState(q);
-                results[q][std::to_string(val)]++;
+    void applyTwoQubitGate(std::string_view gate, int q1, int q2) { applyTwoQubitGate(gateOp(gate), q1, q2); }
+
+    // Fused U3 pulse from the optimizer; only emitted for backends that take one.
+    void applyUnitary(int q, const double params[3]) {
+        if(calibrated[q]) {
+            backend->sendUnitary(q, params);
+            logger.gate("U", q);
+        }
+    }
+
+    // RX/RY/RZ or CPHASE by a bound angle.
+    void applyRotation(const Instruction &in) {
+        if(in.op == GateOp::CPHASE) {
+            checkCoupled(in.op, in.q0, in.q1);
+            if(calibrated[in.q0] && calibrated[in.q1]) {
+                backend->sendControlledPhase(in.q0, in.q1, in.params[0]);
+                logger.twoQubitGate("CPHASE", in.q0, in.q1);
             }
+        } else if(calibrated[in.q0]) {
+            backend->sendRotation(in.q0, in.op, in.params[0]);
+            logger.gate(gateName(in.op), in.q0);
+        }
+    }
+
+    void apply(const Instruction &in) {
+        if(isClassical(in)) applyClassical(creg, in, 0, [this](int q) { return backend->readState(q); }, [this](const Instruction &g) { apply(g); });
+        else if(isRotation(in.op)) applyRotation(in);
+        else if(isTwoQubit(in.op)) applyTwoQubitGate(in.op, in.q0, in.q1);
+        else if(in.op == GateOp::U) applyUnitary(in.q0, in.params);
+        else applyGate(in.op, in.q0);
+    }
+
+    // Execute a compiled circuit one moment at a time. The gates of a moment act
+    // on disjoint qubits, so each moment goes out as a single parallel dispatch.
+    // On hardware the whole circuit becomes one pulse program, split only at
+    // mid-circuit readouts. The classical register starts cleared; read it
+    // with classicalBits().
+    void run(const CompiledCircuit &circuit) {
+        creg.reset(circuit.numBits());
+        dispatch(circuit);
+    }
+
+    const ClassicalRegister &classicalBits() const { return creg; }
+
+private:
+    void dispatch(const CompiledCircuit &circuit) {
+        if(circuit.numQubits() > num_qubits) throw std::out_of_range("QuantumComputer::run: circuit wider than device");
+        if(!circuit.bound()) throw std::invalid_argument("QuantumComputer::run: circuit has unbound parameters");
+        if(coupling) coupling->check(circuit.begin(), circuit.end()); // before any pulse goes out
+        if(result_writer) last_circuit = structuralHash(circuit.instructions(), circuit.numQubits());
+        for(size_t m=0;m<circuit.depth();m++){
+            const Instruction *first = circuit.momentBegin(m);
+            size_t n = circuit.momentSize(m);
+            if(n == 1 || !backend->concurrentPulses()) { for(size_t i=0;i<n;i++) apply(first[i]); }
+            else pool.parallelFor(n, [this, first](size_t i) { apply(first[i]); });
         }
-        log({{"action","measure_physical"},{"qubits",qubits},{"shots",shots},{"results",results}});
+        backend->flush();
+    }
+
+public:
+
+    // Stream an OpenQASM program to the device: segments of sealed moments go
+    // out while the rest of the text is still being parsed (see qasm.hpp), so
+    // the first pulse does not wait for the whole file and memory stays
+    // bounded. Streamed gates are not optimized or routed; on a device with a
+    // coupling map the program must already be mapped onto it. An error
+    // partway through surfaces after the segments before it have run.
+    QasmRunReport runQasm(std::istream &in, const QasmStreamOptions &opts = {}) {
+        auto start = std::chrono::steady_clock::now();
+        auto since = [&start]() { return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(); };
+        QasmRunReport report;
+        QasmStream stream(in, opts);
+        CompiledCircuit segment;
+        creg.reset(0);
+        while(stream.next(segment)){
+            if(!report.segments) report.first_pulse_ms = since();
+            creg.reserveBits(segment.numBits()); // bits carry over between segments
+            dispatch(segment);
+            report.segments++;
+            report.gates += segment.size();
+            report.depth += segment.depth();
+        }
+        report.readout = stream.readout();
+        report.total_ms = since();
+        return report;
+    }
+
+    // Raw shots, one packed bitstring per shot. Readout is split into shot
+    // chunks across the pool when the backend has several readout channels;
+    // `ones` (if given) receives the per-qubit counts merged from the chunks.
+    ShotBuffer sampleShots(const std::vector<int> &qubits, int shots=1, std::vector<uint64_t> *ones=nullptr) {
+        ShotBuffer buf;
+        if(ones) ones->assign(qubits.size(), 0);
+        sampleShots(qubits, shots, buf, ones ? ones->data() : nullptr);
+        return buf;
+    }
+
+    // The same into `out`, reusing its storage: once the buffer has held this
+    // many shots, readout allocates nothing. `ones` (one entry per qubit, if
+    // given) receives the counts.
+    void sampleShots(const std::vector<int> &qubits, int shots, ShotBuffer &out, uint64_t *ones=nullptr) {
+        uint64_t first = next_shot.fetch_add(shots, std::memory_order_relaxed);
+        if(backend->sampleShots(qubits, first, shots, out, &pool)){
+            if(ones) { std::fill(ones, ones + qubits.size(), 0); out.addOnes(0, out.shots(), ones); }
+            return;
+        }
+        out.reshape(qubits, shots);
+        ArenaPool::Lease job = arenas.lease();
+        readShots(&pool, *backend, qubits, first, out, job->arena, ones);
+    }
+
+    // Replayable readout: later shots come from the random stream of `job`,
+    // numbered from `first_shot`, so the same (seed, job, shot range) gives the
+    // same bits on any thread.
+    void seedShots(uint64_t job, uint64_t first_shot = 0) {
+        backend->setRngStream(rngStream(job, 0));
+        next_shot = first_shot;
+    }
+
+    // Return every qubit to |0>.
+    void reset() { backend->reset(); }
+
+    // One complete job: prepare the circuit from |0> and take `shots` shots.
+    // Backends that sample in bulk prepare once; otherwise readout collapses
+    // the state, so every shot is prepared again.
+    // `qubits` are the circuit's own; a routed circuit reads each one from
+    // where routing left it, and the buffer keeps the circuit's labels.
+    // Circuits with feedback are prepared for every shot; `classical` (if
+    // given) receives each shot's classical register, column i = bit i.
+    ShotBuffer runShots(const CompiledCircuit &circuit, const std::vector<int> &qubits, int shots, ShotBuffer *classical = nullptr) {
+        ShotBuffer buf;
+        runShots(circuit, qubits, shots, buf, classical);
+        return buf;
+    }
+
+    // The same into `out` (and `classical`), reusing their storage: repeated
+    // jobs of one shape allocate nothing after the first, unless a result
+    // file is recording them.
+    void runShots(const CompiledCircuit &circuit, const std::vector<int> &qubits, int shots, ShotBuffer &out, ShotBuffer *classical = nullptr) {
+        ArenaPool::Lease job = arenas.lease();
+        std::vector<int> &wires = job->wires;
+        for(int q: qubits) wires.push_back(circuit.physical(q));
+        if(classical) classical->reshape(circuit.numBits(), shots);
+        reset();
+        run(circuit);
+        uint64_t first = next_shot.fetch_add(shots, std::memory_order_relaxed);
+        if(!circuit.hasFeedback() && backend->sampleShots(wires, first, shots, out, &pool)) out.relabel(qubits);
+        else {
+            out.reshape(qubits, shots);
+            for(int s=0;s<shots;s++){
+                if(s) { reset(); run(circuit); }
+                backend->readRegister(wires, first+s, out.shot(s));
+                if(classical) for(int b=0;b<creg.size();b++) classical->set(s, b, creg.get(b));
+            }
+        }
+        if(result_writer) logResults({{"action","run_shots"},{"qubits",qubits},{"shots",shots}}, out, []() { return json(); });
+    }
+
+    // Parameter sweep: the circuit is compiled once; each point only rebinds
+    // the angles and runs `shots` shots.
+    std::vector<ShotBuffer> sweep(const CompiledCircuit &circuit, const std::vector<std::vector<double>> &points, const std::vector<int> &qubits, int shots) {
+        CompiledCircuit bound = circuit;
+        std::vector<ShotBuffer> results;
+        results.reserve(points.size());
+        for(const std::vector<double> &p: points){
+            bound.bind(p);
+            results.push_back(runShots(bound, qubits, shots));
+        }
+        return results;
+    }
+
+    // Physical measurement
+    std::map<int,std::map<std::string,int>> measurePhysical(const std::vector<int> &qubits, int shots=1) {
+        std::vector<uint64_t> ones;
+        ShotBuffer raw = sampleShots(qubits, shots, &ones);
+        std::map<int,std::map<std::string,int>> results = raw.marginals(ones);
+        logResults({{"action","measure_physical"},{"qubits",qubits},{"shots",shots}}, raw, [&]() { return results; });
         return results;
     }
 
+    // Swap in a decoder for larger codes; majority vote is the default.
+    void setDecoder(std::shared_ptr<const LogicalDecoder> d) { decoder = std::move(d); }
+
+    // Every logical group of every shot, decoded together: one bit per group per shot.
+    ShotBuffer measureLogicalBatch(const GroupLayout &groups, int shots=1) {
+        return decodeLogical(sampleShots(layoutQubits(groups), shots), groups, *decoder);
+    }
+
     // Logical qubit (distance-3 repetition code)
     std::map<std::string,int> measureLogical(const std::vector<int> &qubit_group, int shots=1) {
-        std::map<std::string,int> results = {{"0",0},{"1",0}};
-        for(int s=0;s<shots;s++){
-            std::vector<int> votes;
-            for(auto q:qubit_group){
-                votes.push_back(HardwareInterface::readState(q));
-            }
-            int sum = std::accumulate(votes.begin(),votes.end(),0);
-            int corrected = (sum > qubit_group.size()/2) ? 1 : 0;
-            results[std::to_string(corrected)]++;
-        }
-        log({{"action","measure_logical"},{"qubits",qubit_group},{"shots",shots},{"results",results}});
+        ShotBuffer raw = sampleShots(qubit_group, shots);
+        int ones = (int)decodeLogical(raw, {qubit_group}, *decoder).ones()[0];
+        std::map<std::string,int> results = {{"0",shots-ones},{"1",ones}};
+        logResults({{"action","measure_logical"},{"qubits",qubit_group},{"shots",shots}}, raw, [&]() { return results; });
         return results;
     }
 };
@@ -119,31 +476,129 @@ public:
 // --------------------------
 // Circuit Builder
 // --------------------------
+// Immediate mode: gates go out through the computer's worker pool without
+// blocking the caller. Each qubit remembers its last in-flight gate, so gates
+// on the same qubit keep program order while gates on disjoint qubits overlap.
+// Deferred mode: gates are only recorded into the IR; compile() freezes them
+// into a CompiledCircuit that QuantumComputer::run can replay.
 class QuantumCircuit {
+public:
+    enum Mode { Immediate, Deferred };
+
 private:
     QuantumComputer &qc;
+    Mode mode;
+    CircuitIR program;
+    std::vector<std::shared_future<void>> pending;
+
+    void waitFor(int q) {
+        if(q >= (int)pending.size() || !pending[q].valid()) return;
+        std::shared_future<void> f = std::move(pending[q]);
+        pending[q] = {};
+        f.get();
+    }
+
+    void track(int q, const std::shared_future<void> &f) {
+        if(q >= (int)pending.size()) pending.resize(q+1);
+        pending[q] = f;
+    }
+
+    void gate1(const Instruction &in) {
+        if(mode == Deferred) { program.append(in); return; }
+        if(in.param >= 0) throw std::invalid_argument("QuantumCircuit: symbolic parameters need deferred mode");
+        waitFor(in.q0);
+        track(in.q0, qc.submit(in).share());
+    }
+
+    void gate2(const Instruction &in) {
+        if(mode == Deferred) { program.append(in); return; }
+        if(in.param >= 0) throw std::invalid_argument("QuantumCircuit: symbolic parameters need deferred mode");
+        waitFor(in.q0); waitFor(in.q1);
+        std::shared_future<void> f = qc.submit(in).share();
+        track(in.q0,f); track(in.q1,f);
+    }
+
+    void deferredOnly(const char *what) const {
+        if(mode != Deferred) throw std::invalid_argument(std::string("QuantumCircuit: ") + what + " needs deferred mode");
+    }
+
+    void gate1(GateOp op, int q) { gate1(Instruction{op, q, -1, {}}); }
+    void gate2(GateOp op, int q1, int q2) { gate2(Instruction{op, q1, q2, {}}); }
+
 public:
-    QuantumCircuit(QuantumComputer &qc_) : qc(qc_) {}
-    void h(int q) { qc.applyGateParallel("H",{q}); }
-    void x(int q) { qc.applyGateParallel("X",{q}); }
-    void y(int q) { qc.applyGateParallel("Y",{q}); }
-    void z(int q) { qc.applyGateParallel("Z",{q}); }
-    void s(int q) { qc.applyGateParallel("S",{q}); }
-    void t(int q) { qc.applyGateParallel("T",{q}); }
-    void swap(int q1,int q2) { qc.applyTwoQubitGate("SWAP",q1,q2); }
-    void cnot(int q1,int q2) { qc.applyTwoQubitGate("CNOT",q1,q2); }
-    void cz(int q1,int q2) { qc.applyTwoQubitGate("CZ",q1,q2); }
+    QuantumCircuit(QuantumComputer &qc_, Mode mode_=Immediate) : qc(qc_), mode(mode_) {}
+    // Waits for every gate still in flight. A gate that failed here was never
+    // waited on, so there is no caller left to hand its error to; it is
+    // dropped rather than let out of the destructor.
+    ~QuantumCircuit() {
+        for(int q=0;q<(int)pending.size();q++){
+            try { waitFor(q); }
+            catch(...) {}
+        }
+    }
+    void h(int q) { gate1(GateOp::H,q); }
+    void x(int q) { gate1(GateOp::X,q); }
+    void y(int q) { gate1(GateOp::Y,q); }
+    void z(int q) { gate1(GateOp::Z,q); }
+    void s(int q) { gate1(GateOp::S,q); }
+    void t(int q) { gate1(GateOp::T,q); }
+    void sdg(int q) { gate1(GateOp::SDG,q); }
+    void tdg(int q) { gate1(GateOp::TDG,q); }
+    void swap(int q1,int q2) { gate2(GateOp::SWAP,q1,q2); }
+    void cnot(int q1,int q2) { gate2(GateOp::CNOT,q1,q2); }
+    void cz(int q1,int q2) { gate2(GateOp::CZ,q1,q2); }
+    void rx(int q, double angle) { gate1(Instruction{GateOp::RX, q, -1, {angle}}); }
+    void ry(int q, double angle) { gate1(Instruction{GateOp::RY, q, -1, {angle}}); }
+    void rz(int q, double angle) { gate1(Instruction{GateOp::RZ, q, -1, {angle}}); }
+    void rx(int q, Param p) { gate1(Instruction{GateOp::RX, q, -1, {}, p.index}); }
+    void ry(int q, Param p) { gate1(Instruction{GateOp::RY, q, -1, {}, p.index}); }
+    void rz(int q, Param p) { gate1(Instruction{GateOp::RZ, q, -1, {}, p.index}); }
+    void cphase(int q1, int q2, double angle) { gate2(Instruction{GateOp::CPHASE, q1, q2, {angle}}); }
+    void cphase(int q1, int q2, Param p) { gate2(Instruction{GateOp::CPHASE, q1, q2, {}, p.index}); }
+
+    // Mid-circuit readout and feedback (deferred mode): measure(a, 0) then
+    // when(0).x(a) resets ancilla a. See CircuitIR::when for wider conditions.
+    void measure(int q, int bit) { deferredOnly("measure"); program.measure(q, bit); }
+    QuantumCircuit &when(int bit) { deferredOnly("when"); program.when(bit); return *this; }
+    QuantumCircuit &when(int first, int width, unsigned value) { deferredOnly("when"); program.when(first, width, value); return *this; }
+
+    // Block until every gate issued through this circuit has been sent;
+    // rethrows the first failure.
+    void wait() { for(int q=0;q<(int)pending.size();q++) waitFor(q); }
+
+    const CircuitIR &ir() const { return program; }
+    CompiledCircuit compile(const CompileOptions &opts, OptimizationReport *report = nullptr) const { return ::compile(program, opts, report); }
+
+    // Default pipeline: fuses single-qubit runs when the device accepts U3
+    // pulses and routes onto its coupling map if it has one.
+    CompileOptions defaultOptions() const {
+        CompileOptions opts;
+        opts.fuse_single_qubit = qc.device().supportsUnitary();
+        opts.coupling = qc.couplingMap();
+        return opts;
+    }
+    CompiledCircuit compile(OptimizationReport *report = nullptr) const { return compile(defaultOptions(), report); }
+
+    // Same, through the computer's compile cache.
+    std::shared_ptr<const CompiledCircuit> compileShared() const { return qc.compileCached(program, defaultOptions()); }
+    void run(const CompiledCircuit &compiled) { wait(); qc.run(compiled); }
 };
 
 // --------------------------
 // Main Example
 // --------------------------
+// The benchmarks include this file for its classes and bring their own main.
+#ifndef QC_NO_MAIN
 int main() {
     QuantumComputer qc;
     QuantumCircuit circuit(qc);
 
-    // Calibrate all 100 qubits
-    for(int i=0;i<100;i++) qc.calibrateQubit(i);
+    // Calibrate all 100 qubits, 8 control lines at a time; qubits calibrated
+    // within the last hour by a previous run are reused from the snapshot
+    CalibrationReport cal = qc.calibrateFromSnapshot("qc_calibration_100qubits.bin", std::chrono::hours(1), 8, [](int, int done, int total) {
+        if(done % 25 == 0) std::cout << "Calibration " << done << "/" << total << std::endl;
+    });
+    std::cout << "Calibrated in " << cal.wall_ms << " ms, " << cal.reused << " qubits reused (slowest qubit " << cal.slowestQubitMs() << " ms)" << std::endl;
 
     // Logical qubits (first 3 qubits each)
     std::vector<int> logical0 = {0,1,2};
@@ -152,17 +607,34 @@ int main() {
     // Bell state on logical qubits
     circuit.h(logical0[0]);
     circuit.cnot(logical0[0],logical1[0]);
+    circuit.wait();
 
-    // Apply H gate to first 10 qubits
-    qc.applyGateParallel("H", {0,1,2,3,4,5,6,7,8,9});
+    // Record a GHZ preparation once and replay it
+    QuantumCircuit ghz(qc, QuantumCircuit::Deferred);
+    ghz.h(0); ghz.cnot(0,1); ghz.cnot(1,2);
+    CompiledCircuit ghz_program = ghz.compile();
+    for(int i=0;i<3;i++) qc.run(ghz_program);
 
-    // Apply CNOT between qubit 0 and 1
-    qc.applyTwoQubitGate("CNOT", 0, 1);
+    // Apply H gate to first 10 qubits, then CNOT between qubit 0 and 1,
+    // scheduled into moments and dispatched one moment at a time
+    QuantumCircuit layer(qc, QuantumCircuit::Deferred);
+    for(int q=0;q<10;q++) layer.h(q);
+    layer.cnot(0,1);
+    CompiledCircuit layered = layer.compile();
+    std::cout << "Scheduled " << layered.size() << " gates into " << layered.depth() << " moments" << std::endl;
+    qc.run(layered);
 
 
     // Measure logical qubits
     auto results0 = qc.measureLogical(logical0,10);
     auto results1 = qc.measureLogical(logical1,10);
+
+    // Decode many logical qubits in one pass
+    GroupLayout layout;
+    for(int g=0;g<33;g++) layout.push_back({3*g,3*g+1,3*g+2});
+    ShotBuffer logical_shots = qc.measureLogicalBatch(layout, 1000);
+    std::vector<uint64_t> logical_ones = logical_shots.ones();
+    std::cout << "Logical qubits 0..32: " << logical_shots.shots() << " shots, logical 32 read 1 in " << logical_ones[32] << std::endl;
     auto results = qc.measurePhysical({0,1,2}, 20);
     for(auto &[q, val]: results){
         std::cout << "Qubit " << q << " -> 0:" << val["0"] << " 1:" << val["1"] << std::endl;
@@ -176,4 +648,225 @@ int main() {
 
     std::cout << "Logical Qubit 0 Results: 0=" << results0["0"] << " 1=" << results0["1"] << std::endl;
     std::cout << "Logical Qubit 1 Results: 0=" << results1["0"] << " 1=" << results1["1"] << std::endl;
+
+    // The same circuit API on the statevector simulator: a Bell pair always
+    // reads out correlated
+    QuantumComputer sim(std::make_unique<StatevectorBackend>(4), 0, "qc_sim_cpp.json");
+    sim.calibrateAll();
+    QuantumCircuit bell(sim, QuantumCircuit::Deferred);
+    bell.h(0); bell.cnot(0,1);
+    sim.run(bell.compile());
+    ShotBuffer bell_shot = sim.sampleShots({0,1});
+    std::cout << "Simulated Bell pair -> " << bell_shot.get(0,0) << bell_shot.get(0,1) << std::endl;
+
+    // Bell shots into the binary result file, read back through the mapping
+    sim.recordResults("qc_results_sim.qcr");
+    sim.runShots(bell.compile(), {0,1}, 10000);
+    sim.flushResults();
+    {
+        result_store::ResultFile file("qc_results_sim.qcr");
+        const result_store::ResultRecord &rec = file[file.size()-1];
+        std::vector<uint64_t> ones = rec.ones();
+        std::cout << "Result record " << rec.sequence() << ": " << rec.shots() << " shots in " << rec.numChunks() << " chunks, ones "
+                  << ones[0] << "/" << ones[1] << " (circuit " << std::hex << rec.circuitHash() << std::dec << ")" << std::endl;
+    }
+
+    // Redundant gates are cancelled and phases merged before anything is sent;
+    // on the simulator the remaining single-qubit runs fuse into U3 pulses
+    QuantumCircuit noisy(sim, QuantumCircuit::Deferred);
+    noisy.h(2); noisy.x(2); noisy.x(2); noisy.h(2);
+    noisy.t(3); noisy.t(3); noisy.s(3); noisy.h(3); noisy.sdg(3);
+    noisy.cnot(2,3); noisy.cnot(2,3);
+    OptimizationReport opt;
+    sim.run(noisy.compile(&opt));
+    std::cout << "Optimized " << opt.gates_before << " gates to " << opt.gates_after << " (depth " << opt.depth_before << " -> " << opt.depth_after << ")" << std::endl;
+
+    // On a 4-qubit line chip, a GHZ state fanned out from qubit 0 needs a
+    // SWAP (qubit 0 talks to three others, a line qubit has two couplers);
+    // shots still name the circuit's own qubits
+    sim.setCouplingMap(std::make_shared<CouplingMap>(CouplingMap::line(4)));
+    {
+        QuantumCircuit star(sim, QuantumCircuit::Deferred);
+        star.h(0); star.cnot(0,1); star.cnot(0,2); star.cnot(0,3);
+        OptimizationReport routed;
+        std::map<std::string,uint64_t> hist = sim.runShots(star.compile(&routed), {0,1,2,3}, 200).histogram();
+        std::cout << "Line-routed GHZ: " << routed.swaps_inserted << " SWAP(s), 0000=" << hist["0000"] << " 1111=" << hist["1111"]
+                  << " other=" << 200 - hist["0000"] - hist["1111"] << std::endl;
+    }
+    sim.setCouplingMap(nullptr);
+
+    // OpenQASM in: the measure statements name the qubits to read
+    {
+        std::vector<int> readout;
+        CircuitIR from_qasm = parseQasm("OPENQASM 2.0;\ninclude \"qelib1.inc\";\nqreg q[3];\ncreg c[3];\n"
+                                        "h q[0];\ncx q[0],q[1];\ncx q[1],q[2];\nmeasure q -> c;\n", &readout);
+        std::map<std::string,uint64_t> hist = sim.runShots(compile(from_qasm), readout, 1000).histogram();
+        std::cout << "QASM GHZ: " << from_qasm.size() << " gates, 000=" << hist["000"] << " 111=" << hist["111"] << std::endl;
+    }
+
+    // Routing cost at full size: 2000 random CNOTs on a 10x10 grid
+    {
+        CouplingMap grid = CouplingMap::grid(10, 10);
+        CircuitIR scattered;
+        Xoshiro256 pick(7);
+        for(int i=0;i<2000;i++){ int a = (int)(pick() % 100); scattered.cnot(a, (a + 1 + (int)(pick() % 99)) % 100); }
+        CompileOptions grid_opts;
+        grid_opts.coupling = &grid;
+        OptimizationReport routed;
+        auto t0 = std::chrono::steady_clock::now();
+        CompiledCircuit program = compile(scattered, grid_opts, &routed);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        std::cout << "Routed 2000 CNOTs onto a 10x10 grid: " << routed.swaps_inserted << " SWAPs, depth " << program.depth() << ", " << ms << " ms" << std::endl;
+    }
+
+    // Several users sharing the simulator through the job queue: Bell jobs
+    // still queued when one starts share its run, the priority job overtakes
+    // them and the recalibration slots in between jobs
+    {
+        JobQueue jobs([&sim](const CompiledCircuit &c, const std::vector<int> &q, int n) { return sim.runShots(c, q, n); });
+        auto bell_job = bell.compileShared();
+        std::vector<std::future<JobResult>> submitted;
+        for(int user=0;user<3;user++) submitted.push_back(jobs.submit(bell_job, {0,1}, 1000));
+        submitted.push_back(jobs.submit(std::make_shared<const CompiledCircuit>(noisy.compile()), {2,3}, 500, 5));
+        jobs.submitMaintenance([&sim]() { sim.calibrateAll(); });
+        for(auto &f: submitted){
+            JobResult r = f.get();
+            std::cout << "Job " << r.id << ": " << r.shots.histogram().size() << " outcomes, batched with " << r.batch_size-1
+                      << " others, waited " << r.queue_ms << " ms" << std::endl;
+        }
+        JobQueueStats st = jobs.stats();
+        std::cout << "Job queue: " << st.completed << " jobs in " << st.runs << " runs, mean latency " << st.mean_latency_ms << " ms" << std::endl;
+    }
+
+    // Parameter sweep: RY(theta) on qubit 0 compiled once, rebound per point;
+    // P(1) follows sin^2(theta/2)
+    QuantumCircuit rot(sim, QuantumCircuit::Deferred);
+    rot.ry(0, Param{0});
+    rot.cnot(0,1);
+    std::vector<std::vector<double>> thetas;
+    for(int i=0;i<=4;i++) thetas.push_back({i * 3.14159265358979 / 4});
+    std::vector<ShotBuffer> sweep = sim.sweep(*rot.compileShared(), thetas, {0,1}, 2000);
+    std::cout << "RY sweep P(1):";
+    for(const ShotBuffer &b: sweep) std::cout << " " << (double)b.ones()[0] / b.shots();
+    std::cout << std::endl;
+
+    // A variational loop resubmits the same circuit; after the first pass
+    // every compile is a cache hit
+    for(int iter=0;iter<1000;iter++){
+        QuantumCircuit ansatz(sim, QuantumCircuit::Deferred);
+        for(int q=0;q<4;q++) ansatz.h(q);
+        ansatz.cnot(0,1); ansatz.cnot(2,3); ansatz.t(1); ansatz.t(1);
+        ansatz.compileShared();
+    }
+    CompileCacheStats cache = sim.compileCacheStats();
+    std::cout << "Compile cache: " << cache.hits << " hits, " << cache.misses << " misses (" << 100*cache.hitRate() << "% hit rate)" << std::endl;
+
+    // Pre-flight the 100-qubit H-layer program on the stabilizer simulator
+    if(StabilizerBackend::supports(layered)){
+        QuantumComputer preflight(std::make_unique<StabilizerBackend>(100), 0, "qc_sim_cpp.json");
+        preflight.calibrateAll();
+        preflight.run(layered);
+        ShotBuffer pf = preflight.sampleShots({0,1,2,3}, 10000);
+        std::cout << "Pre-flight: " << pf.histogram().size() << " distinct outcomes on qubits 0-3" << std::endl;
+
+        // A 200k-gate Clifford program streamed from QASM: the first segment
+        // runs long before the text is parsed through
+        std::string text = "OPENQASM 2.0;\ninclude \"qelib1.inc\";\nqreg q[100];\n";
+        Xoshiro256 pick(11);
+        for(int i=0;i<200000;i++){
+            int a = (int)(pick() % 100);
+            if(i % 2) text += "cx q[" + std::to_string(a) + "],q[" + std::to_string((a + 1 + (int)(pick() % 99)) % 100) + "];\n";
+            else text += (i % 4 ? "s q[" : "h q[") + std::to_string(a) + "];\n";
+        }
+        std::istringstream source(text);
+        preflight.reset();
+        QasmRunReport streamed = preflight.runQasm(source);
+        std::cout << "Streamed " << streamed.gates << " QASM gates in " << streamed.segments << " segments (depth " << streamed.depth
+                  << "): first pulse after " << streamed.first_pulse_ms << " ms of " << streamed.total_ms << " ms" << std::endl;
+    }
+
+    // Mid-circuit feedback: three rounds of a distance-3 repetition code.
+    // Ancillas 3 and 4 read the parities of data pairs (0,1) and (1,2), the
+    // syndrome picks which data qubit to flip back, and each ancilla is reset
+    // by a conditional X on its own readout. An X error is injected before
+    // every round; every shot still ends in 000.
+    {
+        QuantumComputer rep(std::make_unique<StabilizerBackend>(5), 0, "qc_sim_cpp.json");
+        rep.calibrateAll();
+        QuantumCircuit cycle(rep, QuantumCircuit::Deferred);
+        for(int round=0;round<3;round++){
+            int b = 2*round;
+            cycle.x(round);
+            cycle.cnot(0,3); cycle.cnot(1,3); cycle.cnot(1,4); cycle.cnot(2,4);
+            cycle.measure(3, b); cycle.measure(4, b+1);
+            cycle.when(b, 2, 1).x(0); cycle.when(b, 2, 3).x(1); cycle.when(b, 2, 2).x(2);
+            cycle.when(b).x(3); cycle.when(b+1).x(4);
+        }
+        ShotBuffer syndromes;
+        std::map<std::string,uint64_t> hist = rep.runShots(cycle.compile(), {0,1,2}, 200, &syndromes).histogram();
+        LatencyHistogram fb = metrics().snapshot().total(HwOp::Feedback);
+        std::cout << "Repetition code: 000=" << hist["000"] << "/200 after 3 corrected rounds, last syndrome " << syndromes.get(0,4) << syndromes.get(0,5)
+                  << ", feedback mean " << fb.meanMs() * 1000 << " us over " << fb.count << " decisions" << std::endl;
+    }
+
+    // A distance-5 repetition-code logical qubit kept alive for 100 rounds of
+    // syndrome extraction, with 1% bit flips on every data qubit and 1%
+    // readout errors on every ancilla per round; the union-find decoder
+    // tracks them in its frame while the rounds run
+    {
+        QecCode code = QecCode::repetition(5);
+        QuantumComputer device(std::make_unique<StabilizerBackend>(2*code.data - 1), 0, "qc_sim_cpp.json");
+        device.calibrateAll();
+        QecCycleEngine qec(code, QecLayout::contiguous(code), [&device](const CompiledCircuit &c) -> const ClassicalRegister & {
+            device.run(c);
+            return device.classicalBits();
+        });
+        Xoshiro256 noise(3);
+        auto flip = [&noise]() { return noise() % 100 == 0; };
+        int failures = 0, trials = 20, injected = 0;
+        for(int t=0;t<trials;t++){
+            device.reset();
+            qec.start();
+            for(int r=0;r<100;r++){
+                for(int q=0;q<2*code.data-1;q++) if(flip()) { device.applyGate(GateOp::X, q); injected++; }
+                qec.cycle();
+            }
+            failures += qec.readout();
+        }
+        QecStats st = qec.stats();
+        LatencyHistogram dec = metrics().snapshot().total(HwOp::Decode);
+        std::cout << "QEC d=5 (" << qec.syndromeDecoder().name() << "): " << failures << "/" << trials << " logical errors after " << injected
+                  << " injected faults, " << st.rounds << " rounds of " << st.mean_cycle_us << " us, decode latency mean " << dec.meanMs() * 1000
+                  << " us, max backlog " << st.max_backlog << std::endl;
+    }
+
+    // Ten layers over all 100 qubits as pulse programs: the first run
+    // uploads each envelope once, a rerun finds them all resident
+    {
+        QuantumCircuit deep(qc, QuantumCircuit::Deferred);
+        for(int layer=0;layer<10;layer++){
+            for(int q=0;q<100;q++) deep.h(q);
+            for(int q=layer%2;q+1<100;q+=2) deep.cnot(q, q+1);
+        }
+        CompiledCircuit program = deep.compile();
+        HardwareBackend &hw = dynamic_cast<HardwareBackend&>(qc.device());
+        for(int pass=0;pass<2;pass++){
+            PulseStats before = hw.pulseStats();
+            auto t0 = std::chrono::steady_clock::now();
+            qc.run(program);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+            PulseStats after = hw.pulseStats();
+            std::cout << "Pulse program " << pass << ": " << program.size() << " gates in " << ms << " ms, " << after.programs - before.programs << " upload(s) of "
+                      << after.uploaded_bytes - before.uploaded_bytes << " bytes, " << after.cache_misses - before.cache_misses << " new envelopes" << std::endl;
+        }
+    }
+
+    // Hardware call latencies (run with QC_VERBOSITY=2 for the call trace);
+    // metrics().snapshot().prometheus() is the scrape-ready form
+    MetricsSnapshot snap = metrics().snapshot();
+    for(HwOp op: {HwOp::Calibrate, HwOp::PulseProgram, HwOp::ReadState, HwOp::QueueWait, HwOp::Feedback, HwOp::Decode}){
+        LatencyHistogram h = snap.total(op);
+        std::cout << hwOpName(op) << ": " << h.count << " calls, mean " << h.meanMs() << " ms, p99 <= " << h.quantileMs(0.99) << " ms" << std::endl;
+    }
 }
+#endif
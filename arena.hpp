@@ -0,0 +1,119 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <type_traits>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+// --------------------------
+// Job Arenas
+// --------------------------
+// Scratch memory for one job (a run of shots, a readout). A monotonic arena
+// hands out arrays by bumping a pointer and frees nothing until reset(),
+// which rewinds it for the next job. If a job outgrew the first block, reset()
+// replaces the blocks with one of their combined size, so from the second job
+// of a shape on everything fits in one block and nothing is allocated.
+// Arrays are of trivially copyable types only: nothing is ever destroyed.
+class Arena {
+private:
+    struct Block {
+        std::unique_ptr<unsigned char[]> data;
+        size_t size;
+    };
+
+    std::vector<Block> blocks;
+    size_t used = 0; // bytes taken from blocks.back()
+    size_t first_block;
+
+    void grow(size_t need) {
+        size_t size = std::max(need, blocks.empty() ? first_block : blocks.back().size*2);
+        blocks.push_back({std::unique_ptr<unsigned char[]>(new unsigned char[size]), size});
+        used = 0;
+    }
+
+public:
+    explicit Arena(size_t first_block_bytes=4096) : first_block(first_block_bytes) {}
+
+    Arena(const Arena&) = delete;
+    Arena &operator=(const Arena&) = delete;
+
+    void *allocate(size_t bytes, size_t align=alignof(std::max_align_t)) {
+        if(!blocks.empty()){
+            uintptr_t base = (uintptr_t)blocks.back().data.get();
+            size_t at = (size_t)(((base + used + align - 1) & ~(uintptr_t)(align - 1)) - base);
+            if(at + bytes <= blocks.back().size) { used = at + bytes; return blocks.back().data.get() + at; }
+        }
+        grow(bytes + align);
+        return allocate(bytes, align);
+    }
+
+    // `n` zeroed T's.
+    template<typename T>
+    T *array(size_t n) {
+        static_assert(std::is_trivially_copyable<T>::value, "arena arrays are never destroyed");
+        T *p = static_cast<T*>(allocate(n * sizeof(T), alignof(T)));
+        std::memset(p, 0, n * sizeof(T));
+        return p;
+    }
+
+    void reset() {
+        if(blocks.size() > 1){
+            size_t total = 0;
+            for(const Block &b: blocks) total += b.size;
+            blocks.clear();
+            grow(total);
+        }
+        used = 0;
+    }
+};
+
+// One job's scratch: arrays from the arena, plus an index list for the
+// Backend calls that take a std::vector (it keeps its capacity between jobs).
+struct JobArena {
+    Arena arena;
+    std::vector<int> wires;
+
+    void reset() { arena.reset(); wires.clear(); }
+};
+
+// JobArenas reused from job to job. lease() hands out an idle one (a new one
+// only when all are busy, so there are as many as jobs ever ran at once) and
+// the lease returns it, reset, when it goes out of scope.
+class ArenaPool {
+private:
+    std::mutex mtx;
+    std::vector<std::unique_ptr<JobArena>> idle;
+
+    void release(std::unique_ptr<JobArena> a) {
+        a->reset();
+        std::lock_guard<std::mutex> guard(mtx);
+        idle.push_back(std::move(a));
+    }
+
+public:
+    class Lease {
+    private:
+        ArenaPool *pool;
+        std::unique_ptr<JobArena> job;
+    public:
+        Lease(ArenaPool *p, std::unique_ptr<JobArena> j) : pool(p), job(std::move(j)) {}
+        Lease(Lease&&) = default;
+        ~Lease() { if(job) pool->release(std::move(job)); }
+
+        JobArena &operator*() { return *job; }
+        JobArena *operator->() { return job.get(); }
+    };
+
+    Lease lease() {
+        std::unique_ptr<JobArena> job;
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            if(!idle.empty()) { job = std::move(idle.back()); idle.pop_back(); }
+        }
+        if(!job) job = std::make_unique<JobArena>();
+        return Lease(this, std::move(job));
+    }
+};
@@ -0,0 +1,102 @@
+#pragma once
+#include <stdexcept>
+#include <vector>
+#include <cstdint>
+#include "circuit_ir.hpp"
+#include "calibration.hpp"
+#include "shots.hpp"
+#include "link_scheduler.hpp"
+
+class ThreadPool;
+
+// --------------------------
+// Backend Interface
+// --------------------------
+// What QuantumComputer and QuantumModule drive. The hardware backend forwards
+// to HardwareInterface (one per program, since the two programs address their
+// electronics differently); simulators implement the same calls in software.
+class Backend {
+public:
+    virtual ~Backend() = default;
+
+    virtual const char *name() const = 0;
+    virtual int numQubits() const = 0;
+
+    virtual QubitCalibration calibrate(int q) = 0;
+    virtual bool healthCheck(int q) { return true; }
+    // A calibration taken over from a snapshot instead of calibrate(); backends
+    // that shape pulses from it (see pulse.hpp) keep it, the rest ignore it.
+    virtual void setCalibration(int q, const QubitCalibration &c) {}
+    virtual void sendPulse(int q, GateOp op) = 0;
+    virtual void sendTwoQubitPulse(int q1, int q2, GateOp op) = 0;
+    virtual int readState(int q) = 0;
+
+    // One readout of the whole register for shot number `shot` (bit i of
+    // `row` is qubits[i]; row starts zeroed). Backends that read a register
+    // at once, or generate whole words, override the per-qubit default.
+    virtual void readRegister(const std::vector<int> &qubits, uint64_t shot, uint64_t *row) {
+        for(size_t i=0;i<qubits.size();i++) row[i>>6] |= (uint64_t)readState(qubits[i]) << (i & 63);
+    }
+
+    // Shots [first, first+count) into consecutive rows (also zeroed). Remote
+    // backends override it to read a whole chunk per round trip.
+    virtual void readRegisters(const std::vector<int> &qubits, uint64_t first, size_t count, uint64_t *rows) {
+        size_t words = (qubits.size() + 63) / 64;
+        for(size_t s=0;s<count;s++) readRegister(qubits, first+s, rows + s*words);
+    }
+
+    // Switch to the random stream of a job/module (see rng.hpp), so a run can
+    // be replayed; backends without randomness ignore it.
+    virtual void setRngStream(uint64_t stream) {}
+
+    // Arbitrary single-qubit unitary U3(theta, phi, lambda), emitted by gate
+    // fusion. Only backends reporting supportsUnitary() accept it.
+    virtual bool supportsUnitary() const { return false; }
+    virtual void sendUnitary(int q, const double params[3]) {
+        throw std::domain_error(std::string(name()) + " backend does not accept arbitrary unitaries");
+    }
+
+    // RX/RY/RZ(angle) and CPHASE(angle). By default rotations go out as the
+    // equivalent U3 pulse where the backend takes one.
+    virtual void sendRotation(int q, GateOp op, double angle) {
+        if(!supportsUnitary()) throw std::domain_error(std::string(name()) + " backend does not support " + gateName(op));
+        const double half_pi = 1.57079632679489661923;
+        double u[3] = {angle, 0, 0};
+        if(op == GateOp::RX) { u[1] = -half_pi; u[2] = half_pi; }
+        else if(op == GateOp::RZ) { u[0] = 0; u[2] = angle; } // equal to RZ up to global phase
+        sendUnitary(q, u);
+    }
+    virtual void sendControlledPhase(int q1, int q2, double angle) {
+        throw std::domain_error(std::string(name()) + " backend does not support CPHASE");
+    }
+
+    // Return every qubit to |0> (active reset on hardware).
+    virtual void reset() {}
+
+    // This module's half of one link window to module `peer` (the gates name
+    // both ends). Backends without a link to other modules refuse it.
+    virtual void sendLinkWindow(int peer, const GlobalInstruction *gates, size_t n) {
+        throw std::domain_error(std::string(name()) + " backend has no inter-module link");
+    }
+
+    // Push out anything buffered; called when the caller runs out of work.
+    // Backends that send every call as it comes need nothing here. Pulses
+    // may be held until then (or until the next readout, which plays them
+    // first).
+    virtual void flush() {}
+
+    // Bulk sampling of independent shots from the current state, for backends
+    // that can do it without re-preparing (returns false if unsupported).
+    // Shots are numbered from `first` like readRegister's, so a shot range
+    // replays; `pool` (if given) may share out the drawing.
+    virtual bool sampleShots(const std::vector<int> &qubits, uint64_t first, int shots, ShotBuffer &out, ThreadPool *pool = nullptr) { return false; }
+
+    // False when pulses share state (e.g. one amplitude vector) and must be
+    // issued one at a time; the backend then parallelizes inside each call.
+    virtual bool concurrentPulses() const { return true; }
+
+    // How many readRegister calls (for different shots) may run at once:
+    // readout lines on hardware, cores for a stateless sampler. Collapsing
+    // readout shares the state between shots and keeps the default of 1.
+    virtual int readoutChannels() const { return 1; }
+};
@@ -0,0 +1,206 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <functional>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <thread>
+#include <atomic>
+#include <new>
+#include "../backend.hpp"
+#include "../rng.hpp"
+
+// --------------------------
+// Allocation Counter
+// --------------------------
+// Every benchmark executable is a single translation unit that includes this
+// header, so it replaces the global operator new here and counts each heap
+// allocation (from any thread); the runner reports them per iteration.
+namespace bench_detail {
+    inline std::atomic<uint64_t> allocations{0};
+
+    inline void *countedAlloc(std::size_t n) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        if(void *p = std::malloc(n ? n : 1)) return p;
+        throw std::bad_alloc();
+    }
+
+    inline void *countedAlignedAlloc(std::size_t n, std::align_val_t a) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        std::size_t align = (std::size_t)a;
+#if defined(_MSC_VER)
+        void *p = _aligned_malloc(n ? n : 1, align);
+#else
+        void *p = std::aligned_alloc(align, (std::max<std::size_t>(n, 1) + align - 1) / align * align);
+#endif
+        if(!p) throw std::bad_alloc();
+        return p;
+    }
+
+    inline void alignedFree(void *p) {
+#if defined(_MSC_VER)
+        _aligned_free(p);
+#else
+        std::free(p);
+#endif
+    }
+}
+
+inline uint64_t allocationCount() { return bench_detail::allocations.load(std::memory_order_relaxed); }
+
+void *operator new(std::size_t n) { return bench_detail::countedAlloc(n); }
+void *operator new[](std::size_t n) { return bench_detail::countedAlloc(n); }
+void *operator new(std::size_t n, std::align_val_t a) { return bench_detail::countedAlignedAlloc(n, a); }
+void *operator new[](std::size_t n, std::align_val_t a) { return bench_detail::countedAlignedAlloc(n, a); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { bench_detail::alignedFree(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { bench_detail::alignedFree(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { bench_detail::alignedFree(p); }
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept { bench_detail::alignedFree(p); }
+
+// --------------------------
+// Benchmark Harness
+// --------------------------
+// Minimal runner so the benchmarks build wherever the demos do. Each case is
+// a function that runs `iterations` times and returns the items processed;
+// the runner doubles the count until one batch takes at least --min-time, then
+// reports time per iteration. --json writes the same layout as Google
+// Benchmark's --benchmark_format=json, so its compare.py and dashboards can
+// read our results. Heap allocations per iteration are reported as well
+// (allocs_per_iter, a user counter in that format); cases under a prefix
+// passed to requireNoAllocations fail the run if they allocate at all.
+class BenchRunner {
+public:
+    using Case = std::function<uint64_t(uint64_t iterations)>;
+
+private:
+    struct Entry { std::string name; Case fn; };
+    struct Result { std::string name; uint64_t iterations; double real_ns, cpu_ns, items_per_second, allocs_per_iter; };
+
+    std::vector<Entry> cases;
+    std::vector<Result> results;
+    std::vector<std::string> zero_alloc_prefixes;
+    std::string filter, json_path;
+    double min_time = 0.2;
+
+    static double cpuSeconds() { return (double)std::clock() / CLOCKS_PER_SEC; }
+
+public:
+    void add(std::string name, Case fn) { cases.push_back({std::move(name), std::move(fn)}); }
+
+    // Cases whose name starts with `prefix` must not touch the heap once
+    // warmed up.
+    void requireNoAllocations(std::string prefix) { zero_alloc_prefixes.push_back(std::move(prefix)); }
+
+    // --filter=<substring> --min-time=<seconds> --json=<path>
+    void parseArgs(int argc, char **argv) {
+        for(int i=1;i<argc;i++){
+            std::string a = argv[i];
+            if(a.rfind("--filter=", 0) == 0) filter = a.substr(9);
+            else if(a.rfind("--min-time=", 0) == 0) min_time = std::atof(a.c_str() + 11);
+            else if(a.rfind("--json=", 0) == 0) json_path = a.substr(7);
+            else { std::cerr << "usage: " << argv[0] << " [--filter=substr] [--min-time=seconds] [--json=path]\n"; std::exit(2); }
+        }
+    }
+
+    int run() {
+        std::printf("%-48s %14s %14s %12s %12s\n", "Benchmark", "Time (ns)", "Items/s", "Iterations", "Allocs/iter");
+        int failures = 0;
+        for(const Entry &e: cases){
+            if(!filter.empty() && e.name.find(filter) == std::string::npos) continue;
+            e.fn(1); // warm-up: first-touch allocations, thread start-up
+            for(uint64_t n=1;;n*=2){
+                uint64_t a0 = allocationCount();
+                auto t0 = std::chrono::steady_clock::now();
+                double c0 = cpuSeconds();
+                uint64_t items = e.fn(n);
+                double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+                double cpu = cpuSeconds() - c0;
+                uint64_t allocs = allocationCount() - a0;
+                if(secs < min_time && n < (1ull << 30)) continue;
+                Result r{e.name, n, secs*1e9/n, cpu*1e9/n, secs > 0 ? items/secs : 0.0, (double)allocs/n};
+                std::printf("%-48s %14.0f %14.4g %12llu %12.4g\n", r.name.c_str(), r.real_ns, r.items_per_second, (unsigned long long)r.iterations, r.allocs_per_iter);
+                for(const std::string &prefix: zero_alloc_prefixes){
+                    if(allocs && e.name.rfind(prefix, 0) == 0){
+                        std::fprintf(stderr, "FAILED: %s made %llu heap allocations in %llu iterations\n", e.name.c_str(), (unsigned long long)allocs, (unsigned long long)n);
+                        failures++;
+                        break;
+                    }
+                }
+                results.push_back(r);
+                break;
+            }
+        }
+        if(!json_path.empty()) writeJson(json_path);
+        return failures ? 1 : 0;
+    }
+
+    void writeJson(const std::string &path) const {
+        std::ofstream out(path);
+        char date[32];
+        std::time_t now = std::time(nullptr);
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+        out << "{\n  \"context\": {\"date\": \"" << date << "\", \"num_cpus\": " << std::thread::hardware_concurrency()
+#ifdef NDEBUG
+            << ", \"library_build_type\": \"release\"},\n";
+#else
+            << ", \"library_build_type\": \"debug\"},\n";
+#endif
+        out << "  \"benchmarks\": [\n";
+        for(size_t i=0;i<results.size();i++){
+            const Result &r = results[i];
+            out << "    {\"name\": \"" << r.name << "\", \"run_name\": \"" << r.name << "\", \"run_type\": \"iteration\", \"iterations\": " << r.iterations
+                << ", \"real_time\": " << r.real_ns << ", \"cpu_time\": " << r.cpu_ns << ", \"time_unit\": \"ns\", \"items_per_second\": " << r.items_per_second
+                << ", \"allocs_per_iter\": " << r.allocs_per_iter << "}" << (i+1 < results.size() ? "," : "") << "\n";
+        }
+        out << "  ]\n}\n";
+    }
+};
+
+// Keeps the optimizer from discarding a result.
+#if defined(_MSC_VER)
+template<typename T> inline void doNotOptimize(const T &v) { static volatile const void *sink; sink = &v; }
+#else
+template<typename T> inline void doNotOptimize(const T &v) { asm volatile("" : : "r,m"(v) : "memory"); }
+#endif
+
+// --------------------------
+// Zero-latency Mock Backend
+// --------------------------
+// Stands in for HardwareInterface: no sleeps and no console output, so the
+// numbers are pure software overhead (dispatch, logging, sampling, decoding).
+// Readout draws from a counter-based stream like the hardware stand-in, so
+// decoding sees mixed outcomes.
+class MockBackend : public Backend {
+private:
+    int n;
+    CounterRng stream{rngSeed(), 0};
+public:
+    explicit MockBackend(int qubits) : n(qubits) {}
+    const char *name() const override { return "mock"; }
+    int numQubits() const override { return n; }
+    QubitCalibration calibrate(int) override { return QubitCalibration{}; }
+    void sendPulse(int, GateOp) override {}
+    void sendTwoQubitPulse(int, int, GateOp) override {}
+    bool supportsUnitary() const override { return true; }
+    void sendUnitary(int, const double*) override {}
+    void sendControlledPhase(int, int, double) override {}
+    int readState(int) override { return (int)(threadRng()() >> 63); }
+    void readRegister(const std::vector<int> &qubits, uint64_t shot, uint64_t *row) override {
+        stream.gather(shot, qubits.data(), qubits.size(), row);
+    }
+    void setRngStream(uint64_t s) override { stream = CounterRng(rngSeed(), s); }
+    void sendLinkWindow(int, const GlobalInstruction*, size_t) override {}
+    bool concurrentPulses() const override { return true; }
+    int readoutChannels() const override { return (int)std::max(1u, std::thread::hardware_concurrency()); }
+};
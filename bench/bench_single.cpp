@@ -0,0 +1,243 @@
+// Single-machine benchmarks: gate dispatch, measurement, logical and syndrome
+// decoding and the logger against the zero-latency mock backend, plus the
+// simulators' shot sampling.
+#define QC_NO_MAIN
+#include "../QuantumComputerFull.cpp"
+#include "bench.hpp"
+
+int main(int argc, char **argv) {
+    BenchRunner bench;
+    bench.parseArgs(argc, argv);
+    const std::string log_path = "qc_bench_single.json";
+
+    QuantumComputer qc(std::make_unique<MockBackend>(100), 0, log_path);
+    qc.calibrateAll();
+
+    // Dispatch overhead: the pool round trip per gate, and per parallel layer
+    for(int n: {1, 10, 100}){
+        std::vector<int> qubits(n);
+        std::iota(qubits.begin(), qubits.end(), 0);
+        bench.add("dispatch/applyGateParallel/" + std::to_string(n), [&qc, qubits](uint64_t iters) {
+            for(uint64_t i=0;i<iters;i++) qc.applyGateParallel("H", qubits);
+            return iters * qubits.size();
+        });
+    }
+    bench.add("dispatch/applyGate", [&qc](uint64_t iters) {
+        for(uint64_t i=0;i<iters;i++) qc.applyGate(GateOp::X, (int)(i % 100));
+        return iters;
+    });
+    {
+        QuantumCircuit layered(qc, QuantumCircuit::Deferred);
+        for(int layer=0;layer<10;layer++){
+            for(int q=0;q<100;q++) layered.h(q);
+            for(int q=layer%2;q+1<100;q+=2) layered.cnot(q, q+1);
+        }
+        auto program = std::make_shared<CompiledCircuit>(layered.compile());
+        bench.add("dispatch/run/100x10layers", [&qc, program](uint64_t iters) {
+            for(uint64_t i=0;i<iters;i++) qc.run(*program);
+            return iters * program->size();
+        });
+    }
+    // Mid-circuit readout feeding a conditional gate (items are decisions)
+    {
+        QuantumCircuit feedback(qc, QuantumCircuit::Deferred);
+        for(int q=0;q<50;q++) { feedback.measure(q, q); feedback.when(q).x(q+50); }
+        auto program = std::make_shared<CompiledCircuit>(feedback.compile());
+        bench.add("dispatch/run/feedback50", [&qc, program](uint64_t iters) {
+            for(uint64_t i=0;i<iters;i++) qc.run(*program);
+            return iters * 50;
+        });
+    }
+
+    // OpenQASM ingestion: parsing alone, then parse + dispatch streamed in
+    // segments (items are gates)
+    {
+        auto text = std::make_shared<std::string>("OPENQASM 2.0;\ninclude \"qelib1.inc\";\nqreg q[100];\n");
+        Xoshiro256 pick(5);
+        const int gates = 100000;
+        for(int i=0;i<gates;i++){
+            int a = (int)(pick() % 100);
+            if(i % 3 == 0) *text += "cx q[" + std::to_string(a) + "],q[" + std::to_string((a + 1 + (int)(pick() % 99)) % 100) + "];\n";
+            else *text += (i % 3 == 1 ? "h q[" : "rz(pi/8) q[") + std::to_string(a) + "];\n";
+        }
+        bench.add("qasm/parse/100k", [text, gates](uint64_t iters) {
+            for(uint64_t i=0;i<iters;i++) doNotOptimize(parseQasm(*text));
+            return iters * gates;
+        });
+        bench.add("qasm/runQasm/100k", [&qc, text, gates](uint64_t iters) {
+            for(uint64_t i=0;i<iters;i++){
+                std::istringstream source(*text);
+                doNotOptimize(qc.runQasm(source));
+            }
+            return iters * gates;
+        });
+    }
+
+    // Measurement throughput vs qubit count and shots
+    for(int n: {1, 10, 100})
+        for(int shots: {1, 100, 1000, 100000}){
+            std::vector<int> qubits(n);
+            std::iota(qubits.begin(), qubits.end(), 0);
+            bench.add("measure/sampleShots/" + std::to_string(n) + "q/" + std::to_string(shots), [&qc, qubits, shots](uint64_t iters) {
+                for(uint64_t i=0;i<iters;i++) doNotOptimize(qc.sampleShots(qubits, shots));
+                return iters * shots;
+            });
+            bench.add("measure/measurePhysical/" + std::to_string(n) + "q/" + std::to_string(shots), [&qc, qubits, shots](uint64_t iters) {
+                for(uint64_t i=0;i<iters;i++) doNotOptimize(qc.measurePhysical(qubits, shots));
+                return iters * shots;
+            });
+        }
+    for(int shots: {1, 100, 1000})
+        bench.add("measure/measureLogical/3q/" + std::to_string(shots), [&qc, shots](uint64_t iters) {
+            for(uint64_t i=0;i<iters;i++) doNotOptimize(qc.measureLogical({0,1,2}, shots));
+            return iters * shots;
+        });
+
+    // Logical decoding alone: 33 distance-3 groups over 99 qubits
+    {
+        GroupLayout groups;
+        for(int g=0;g<33;g++) groups.push_back({3*g, 3*g+1, 3*g+2});
+        for(int shots: {64, 4096}){
+            auto raw = std::make_shared<ShotBuffer>(qc.sampleShots(layoutQubits(groups), shots));
+            bench.add("decode/majority/33groups/" + std::to_string(shots), [raw, groups, shots](uint64_t iters) {
+                MajorityDecoder majority;
+                for(uint64_t i=0;i<iters;i++) doNotOptimize(decodeLogical(*raw, groups, majority));
+                return iters * shots * groups.size();
+            });
+        }
+    }
+
+    // Streaming syndrome decoding, one round per item: 3% data flips and 3%
+    // readout errors per round, 64 rounds per run ending in a perfect round
+    for(int d: {3, 9}){
+        QecCode code = QecCode::repetition(d);
+        const int rounds = 64, m = code.numChecks();
+        auto syndromes = std::make_shared<std::vector<uint8_t>>();
+        Xoshiro256 noise(9);
+        std::vector<uint8_t> err(d, 0);
+        for(int r=0;r<=rounds;r++){
+            for(auto &e: err) if(r < rounds && noise() % 100 < 3) e ^= 1;
+            for(int k=0;k<m;k++) syndromes->push_back(err[k] ^ err[k+1] ^ (r < rounds && noise() % 100 < 3));
+        }
+        std::shared_ptr<SyndromeDecoder> decoder = makeDecoder(code);
+        bench.add(std::string("qec/") + decoder->name() + "/d" + std::to_string(d), [decoder, syndromes, rounds, m](uint64_t iters) {
+            for(uint64_t i=0;i<iters;i++){
+                decoder->reset();
+                for(int r=0;r<=rounds;r++) decoder->push(syndromes->data() + r*m, r == rounds);
+                doNotOptimize(decoder->frame()[0]);
+            }
+            return iters * (rounds + 1);
+        });
+    }
+
+    // Pulse lowering alone: a 10-layer, 100-qubit circuit into one program
+    // per run, handed to a no-op upload; after the first run every envelope
+    // is resident and the sequencer allocates nothing (items are gates)
+    {
+        QuantumCircuit layered(qc, QuantumCircuit::Deferred);
+        for(int layer=0;layer<10;layer++){
+            for(int q=0;q<100;q++) layered.h(q);
+            for(int q=layer%2;q+1<100;q+=2) layered.cnot(q, q+1);
+        }
+        auto program = std::make_shared<CompiledCircuit>(layered.compile());
+        auto sequencer = std::make_shared<PulseSequencer>(100, [](const unsigned char *image, size_t bytes, uint32_t) { doNotOptimize(image[bytes-1]); });
+        bench.add("pulse/sequence/100x10layers", [sequencer, program](uint64_t iters) {
+            for(uint64_t i=0;i<iters;i++){
+                for(const Instruction &in: *program){
+                    if(isTwoQubit(in.op)) sequencer->twoQubit(in.op, in.q0, in.q1);
+                    else sequencer->gate(in.op, in.q0);
+                }
+                sequencer->flush();
+            }
+            return iters * program->size();
+        });
+        bench.requireNoAllocations("pulse/");
+    }
+
+    // Steady-state hot paths into reused result buffers: after warm-up these
+    // must not touch the heap at all (the runner fails the run otherwise)
+    {
+        std::vector<int> qubits(10);
+        std::iota(qubits.begin(), qubits.end(), 0);
+        std::vector<int> all(100);
+        std::iota(all.begin(), all.end(), 0);
+        QuantumCircuit layered(qc, QuantumCircuit::Deferred);
+        for(int layer=0;layer<10;layer++){
+            for(int q=0;q<100;q++) layered.h(q);
+            for(int q=layer%2;q+1<100;q+=2) layered.cnot(q, q+1);
+        }
+        auto program = std::make_shared<CompiledCircuit>(layered.compile());
+        QuantumCircuit bell(qc, QuantumCircuit::Deferred);
+        bell.h(0);
+        bell.cnot(0, 1);
+        bell.measure(1, 0);
+        bell.when(0).x(2);
+        auto feedback = std::make_shared<CompiledCircuit>(bell.compile());
+        auto out = std::make_shared<ShotBuffer>();
+        auto classical = std::make_shared<ShotBuffer>();
+        auto ones = std::make_shared<std::vector<uint64_t>>(qubits.size());
+        std::vector<int> bell_qubits = {0, 1, 2};
+        bench.add("zero_alloc/applyGateParallel/100", [&qc, all](uint64_t iters) {
+            for(uint64_t i=0;i<iters;i++) qc.applyGateParallel("H", all);
+            return iters * all.size();
+        });
+        bench.add("zero_alloc/run/100x10layers", [&qc, program](uint64_t iters) {
+            for(uint64_t i=0;i<iters;i++) qc.run(*program);
+            return iters * program->size();
+        });
+        bench.add("zero_alloc/sampleShots/10q/1000", [&qc, qubits, out, ones](uint64_t iters) {
+            for(uint64_t i=0;i<iters;i++) qc.sampleShots(qubits, 1000, *out, ones->data());
+            return iters * 1000;
+        });
+        bench.add("zero_alloc/runShots/feedback/100", [&qc, bell_qubits, out, classical, feedback](uint64_t iters) {
+            for(uint64_t i=0;i<iters;i++) qc.runShots(*feedback, bell_qubits, 100, *out, classical.get());
+            return iters * 100;
+        });
+    }
+
+    // ...and the same shot jobs on both simulators, which sample in bulk
+    // rather than reading out shot by shot
+    std::vector<std::pair<std::string, std::shared_ptr<QuantumComputer>>> sims = {
+        {"statevector", std::make_shared<QuantumComputer>(std::make_unique<StatevectorBackend>(12), 0, log_path)},
+        {"stabilizer", std::make_shared<QuantumComputer>(std::make_unique<StabilizerBackend>(100), 0, log_path)}};
+    for(auto &[label, sim]: sims){
+        sim->calibrateAll();
+        QuantumCircuit ghz(*sim, QuantumCircuit::Deferred);
+        ghz.h(0);
+        for(int q=0;q+1<10;q++) ghz.cnot(q, q+1);
+        auto program = std::make_shared<CompiledCircuit>(ghz.compile());
+        std::vector<int> qubits(10);
+        std::iota(qubits.begin(), qubits.end(), 0);
+        auto out = std::make_shared<ShotBuffer>();
+        auto ones = std::make_shared<std::vector<uint64_t>>(qubits.size());
+        bench.add("zero_alloc/runShots/" + label + "/ghz10/1000", [sim, program, qubits, out](uint64_t iters) {
+            for(uint64_t i=0;i<iters;i++) sim->runShots(*program, qubits, 1000, *out);
+            return iters * 1000;
+        });
+        bench.add("zero_alloc/sampleShots/" + label + "/10q/1000", [sim, qubits, out, ones](uint64_t iters) {
+            for(uint64_t i=0;i<iters;i++) sim->sampleShots(qubits, 1000, *out, ones->data());
+            return iters * 1000;
+        });
+    }
+    bench.requireNoAllocations("zero_alloc/");
+
+    // Logger: producer-side cost of one gate event
+    {
+        const std::string path = "qc_bench_logger.json";
+        auto logger = std::make_shared<AsyncLogger>(path);
+        bench.add("logger/gate", [logger](uint64_t iters) {
+            for(uint64_t i=0;i<iters;i++) logger->gate("H", (int)(i % 100));
+            return iters;
+        });
+        bench.add("logger/gate+flush", [logger](uint64_t iters) {
+            for(uint64_t i=0;i<iters;i++) logger->gate("CNOT", (int)(i % 100));
+            logger->flush();
+            return iters;
+        });
+        int rc = bench.run();
+        logger.reset();
+        std::remove(path.c_str());
+        std::remove(log_path.c_str());
+        return rc;
+    }
+}
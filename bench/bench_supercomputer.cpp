@@ -0,0 +1,131 @@
+// Multi-module benchmarks: how QuantumSupercomputer scales with module count,
+// what a module behind a loopback ModuleAgent costs over an in-process one,
+// plus the software-only link scheduling and placement passes.
+#define QC_NO_MAIN
+#include "../connect.cpp"
+#include "bench.hpp"
+
+namespace {
+    // A supercomputer of `n` zero-latency modules.
+    struct MockCluster {
+        QuantumSupercomputer super;
+
+        MockCluster(int n, int qubits=100) : super(8) {
+            for(int m=0;m<n;m++) super.addModule(std::make_unique<MockBackend>(qubits));
+            super.calibrateAll();
+        }
+    };
+
+#ifndef _WIN32
+    // The same over RPC: every module is a zero-latency mock behind its own
+    // agent on loopback, so the difference to MockCluster is the transport.
+    // (Agents need POSIX sockets, see rpc.hpp.)
+    struct RemoteMockCluster {
+        std::vector<std::unique_ptr<rpc::ModuleAgent>> agents; // outlive the connections
+        QuantumSupercomputer super;
+
+        RemoteMockCluster(int n, int qubits=100) : super(8) {
+            for(int m=0;m<n;m++){
+                agents.push_back(std::make_unique<rpc::ModuleAgent>(std::make_unique<MockBackend>(qubits)));
+                agents.back()->start();
+                super.addRemoteModule("127.0.0.1", agents.back()->port());
+            }
+            super.calibrateAll();
+        }
+    };
+#endif
+
+    CompiledCircuit layeredProgram(int width, int layers) {
+        CircuitIR ir;
+        for(int l=0;l<layers;l++){
+            for(int q=0;q<width;q++) ir.h(q);
+            for(int q=l%2;q+1<width;q+=2) ir.cnot(q, q+1);
+        }
+        CompileOptions opts;
+        opts.optimize = false;
+        return compile(ir, opts);
+    }
+}
+
+int main(int argc, char **argv) {
+    BenchRunner bench;
+    bench.parseArgs(argc, argv);
+
+    auto program = std::make_shared<CompiledCircuit>(layeredProgram(100, 10));
+
+    // Same program on every module at once; ideal scaling keeps time flat
+    for(int n: {1, 2, 4, 8}){
+        auto cluster = std::make_shared<MockCluster>(n);
+        bench.add("supercomputer/submit+sync/" + std::to_string(n) + "modules", [cluster, program, n](uint64_t iters) {
+            for(uint64_t i=0;i<iters;i++){
+                for(int m=0;m<n;m++) cluster->super.submit(*program, m);
+                cluster->super.sync();
+            }
+            return iters * n * program->size();
+        });
+        bench.add("supercomputer/measureLogical/" + std::to_string(n) + "modules", [cluster, n](uint64_t iters) {
+            for(uint64_t i=0;i<iters;i++)
+                for(int m=0;m<n;m++) doNotOptimize(cluster->super.measureLogical(m, {0,1,2}, 100));
+            return iters * n * 100;
+        });
+    }
+
+    // Immediate-mode gates through the per-module executors
+    {
+        auto cluster = std::make_shared<MockCluster>(4);
+        bench.add("supercomputer/applyGate/4modules", [cluster](uint64_t iters) {
+            for(uint64_t i=0;i<iters;i++) cluster->super.applyGate((int)(i % 4), "H", (int)(i % 100));
+            cluster->super.sync();
+            return iters;
+        });
+    }
+
+#ifndef _WIN32
+    // Per remote gate: pipelined single gates, whole programs, and a readout
+    // round trip, each next to the in-process module
+    {
+        auto local = std::make_shared<MockCluster>(1);
+        auto remote = std::make_shared<RemoteMockCluster>(1);
+        for(auto &[label, super]: {std::make_pair(std::string("local"), &local->super), std::make_pair(std::string("remote"), &remote->super)}){
+            QuantumSupercomputer *sc = super;
+            bench.add("supercomputer/applyGate/1module_" + label, [local, remote, sc](uint64_t iters) {
+                for(uint64_t i=0;i<iters;i++) sc->applyGate(0, "H", (int)(i % 100));
+                sc->sync();
+                return iters;
+            });
+            bench.add("supercomputer/measureLogical/1module_" + label, [local, remote, sc](uint64_t iters) {
+                for(uint64_t i=0;i<iters;i++) doNotOptimize(sc->measureLogical(0, {0,1,2}, 1));
+                return iters;
+            });
+        }
+        auto remote2 = std::make_shared<RemoteMockCluster>(2);
+        bench.add("supercomputer/submit+sync/2modules_remote", [remote2, program](uint64_t iters) {
+            for(uint64_t i=0;i<iters;i++){
+                for(int m=0;m<2;m++) remote2->super.submit(*program, m);
+                remote2->super.sync();
+            }
+            return iters * 2 * program->size();
+        });
+    }
+#endif
+
+    // Link scheduling and placement of a 500-qubit ring over five modules
+    {
+        auto cluster = std::make_shared<MockCluster>(5);
+        DistributedCircuit ring;
+        for(int l=0;l<4;l++)
+            for(int q=0;q<500;q++) ring.gate(GateOp::CNOT, q/100, q%100, ((q+1)%500)/100, ((q+1)%500)%100);
+        bench.add("link/schedule/500q_ring", [cluster, ring](uint64_t iters) {
+            for(uint64_t i=0;i<iters;i++) doNotOptimize(cluster->super.schedule(ring));
+            return iters * ring.size();
+        });
+        CircuitIR logical;
+        for(int q=0;q<500;q++) logical.cnot((q*37)%500, ((q+1)*37)%500);
+        bench.add("placement/place/500q_scrambled_ring", [cluster, logical](uint64_t iters) {
+            for(uint64_t i=0;i<iters;i++) doNotOptimize(cluster->super.place(logical));
+            return iters * logical.size();
+        });
+    }
+
+    return bench.run();
+}
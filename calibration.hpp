@@ -0,0 +1,177 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <exception>
+#include <string>
+#include <fstream>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// --------------------------
+// Concurrent Calibration
+// --------------------------
+// Qubits on independent control lines calibrate at the same time; the
+// concurrency limit is the number of lines driven at once.
+struct CalibrationReport {
+    int module = 0;
+    std::vector<double> qubit_ms; // time spent calibrating each qubit
+    double wall_ms = 0;           // elapsed time for the whole module
+    int reused = 0;               // qubits taken from a fresh snapshot instead of recalibrated
+
+    double slowestQubitMs() const { return qubit_ms.empty() ? 0 : *std::max_element(qubit_ms.begin(), qubit_ms.end()); }
+};
+
+// Called after every qubit with (module, qubits done, qubits total). Calls are
+// serialized, so the callback needs no locking of its own.
+using CalibrationProgress = std::function<void(int,int,int)>;
+
+// Calibrate qubits [0,n) of one module, at most `concurrency` at a time.
+template<typename F>
+CalibrationReport calibrateConcurrent(int module, int n, unsigned concurrency, F &&calibrate, const CalibrationProgress &progress = {}) {
+    CalibrationReport report;
+    report.module = module;
+    report.qubit_ms.assign(n, 0.0);
+    std::atomic<int> next{0};
+    std::mutex progress_mtx;
+    int done = 0;
+    std::exception_ptr error;
+
+    auto line = [&]() {
+        for(int q; (q = next++) < n;){
+            auto start = std::chrono::steady_clock::now();
+            try { calibrate(q); }
+            catch(...) {
+                std::lock_guard<std::mutex> guard(progress_mtx);
+                if(!error) error = std::current_exception();
+                next = n;
+                return;
+            }
+            report.qubit_ms[q] = std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now() - start).count();
+            std::lock_guard<std::mutex> guard(progress_mtx);
+            done++;
+            if(progress) progress(module, done, n);
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    unsigned lines = std::max(1u, std::min<unsigned>(concurrency, (unsigned)std::max(n, 1)));
+    std::vector<std::thread> threads;
+    for(unsigned i=1;i<lines;i++) threads.emplace_back(line);
+    line();
+    for(auto &t: threads) t.join();
+    report.wall_ms = std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now() - start).count();
+    if(error) std::rethrow_exception(error);
+    return report;
+}
+
+// --------------------------
+// Calibration Snapshot
+// --------------------------
+// Per-module binary file of the last calibration of every qubit, so a warm
+// restart only recalibrates qubits that went stale or fail a health check.
+// Layout (host byte order): "QCAL", u32 version, i32 module, u32 count,
+// count x QubitCalibration, u32 FNV-1a checksum of the records.
+enum CalibrationStatus : uint8_t { Uncalibrated = 0, Calibrated = 1, CalibrationFailed = 2 };
+
+struct QubitCalibration {
+    int64_t timestamp_ms = 0;   // wall clock, ms since the epoch
+    float frequency_ghz = 0;
+    float pi_amplitude = 0;
+    uint8_t status = Uncalibrated;
+    uint8_t reserved[7] = {};
+};
+static_assert(std::is_trivially_copyable<QubitCalibration>::value && sizeof(QubitCalibration) == 24, "snapshot record layout");
+
+inline int64_t wallClockMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+class CalibrationSnapshot {
+private:
+    static constexpr uint32_t version = 1;
+    int module;
+    std::vector<QubitCalibration> records;
+
+    static uint32_t checksum(const std::vector<QubitCalibration> &r) {
+        uint32_t h = 2166136261u;
+        const unsigned char *p = reinterpret_cast<const unsigned char*>(r.data());
+        for(size_t i=0;i<r.size()*sizeof(QubitCalibration);i++) { h ^= p[i]; h *= 16777619u; }
+        return h;
+    }
+
+public:
+    CalibrationSnapshot(int module_, int n) : module(module_), records(n) {}
+
+    // False (and every qubit left Uncalibrated) if the file is missing, torn,
+    // or was written for a different module or qubit count.
+    bool load(const std::string &path) {
+        std::ifstream f(path, std::ios::binary);
+        if(!f) return false;
+        char magic[4];
+        uint32_t ver, count, sum;
+        int32_t mod;
+        f.read(magic, 4);
+        f.read(reinterpret_cast<char*>(&ver), sizeof(ver));
+        f.read(reinterpret_cast<char*>(&mod), sizeof(mod));
+        f.read(reinterpret_cast<char*>(&count), sizeof(count));
+        if(!f || std::memcmp(magic, "QCAL", 4) != 0 || ver != version || mod != module || count != records.size()) return false;
+        std::vector<QubitCalibration> loaded(count);
+        f.read(reinterpret_cast<char*>(loaded.data()), count*sizeof(QubitCalibration));
+        f.read(reinterpret_cast<char*>(&sum), sizeof(sum));
+        if(!f || sum != checksum(loaded)) return false;
+        records = std::move(loaded);
+        return true;
+    }
+
+    // Written to a temporary file and renamed, so a crash never leaves a torn snapshot.
+    bool save(const std::string &path) const {
+        std::string tmp = path + ".tmp";
+        {
+            std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+            if(!f) return false;
+            uint32_t count = (uint32_t)records.size(), sum = checksum(records);
+            int32_t mod = module;
+            f.write("QCAL", 4);
+            f.write(reinterpret_cast<const char*>(&version), sizeof(version));
+            f.write(reinterpret_cast<const char*>(&mod), sizeof(mod));
+            f.write(reinterpret_cast<const char*>(&count), sizeof(count));
+            f.write(reinterpret_cast<const char*>(records.data()), records.size()*sizeof(QubitCalibration));
+            f.write(reinterpret_cast<const char*>(&sum), sizeof(sum));
+            if(!f) return false;
+        }
+        std::remove(path.c_str());
+        return std::rename(tmp.c_str(), path.c_str()) == 0;
+    }
+
+    bool fresh(int q, std::chrono::milliseconds ttl, int64_t now_ms) const {
+        const QubitCalibration &r = records[q];
+        return r.status == Calibrated && now_ms - r.timestamp_ms >= 0 && now_ms - r.timestamp_ms < ttl.count();
+    }
+
+    QubitCalibration &operator[](int q) { return records[q]; }
+    const QubitCalibration &operator[](int q) const { return records[q]; }
+    size_t size() const { return records.size(); }
+};
+
+// Reuse every qubit whose snapshot entry is younger than `ttl` and passes
+// `healthy(q)`; recalibrate the rest (calibrate(q) returns the new record).
+// The snapshot is updated in place for the caller to save.
+template<typename Calibrate, typename Reuse, typename Healthy>
+CalibrationReport calibrateIncremental(int module, CalibrationSnapshot &snapshot, std::chrono::milliseconds ttl, unsigned concurrency,
+                                       Calibrate &&calibrate, Reuse &&reuse, Healthy &&healthy, const CalibrationProgress &progress = {}) {
+    int64_t now = wallClockMs();
+    std::atomic<int> reused{0};
+    CalibrationReport report = calibrateConcurrent(module, (int)snapshot.size(), concurrency, [&](int q) {
+        if(snapshot.fresh(q, ttl, now) && healthy(q)) { reuse(q, snapshot[q]); reused++; }
+        else snapshot[q] = calibrate(q);
+    }, progress);
+    report.reused = reused;
+    return report;
+}
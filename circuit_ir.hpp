@@ -0,0 +1,254 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <complex>
+#include <cmath>
+
+// --------------------------
+// Gate IR
+// --------------------------
+// Compact POD instruction stream recorded by QuantumCircuit in deferred mode.
+// Opcodes replace the gate-name strings of the immediate path; the name is only
+// materialized (as a static string) when a pulse is actually sent.
+// U is an arbitrary single-qubit unitary U3(theta, phi, lambda), produced by
+// gate fusion for backends that accept one. RX/RY/RZ and CPHASE take an angle
+// in params[0], either literal or a symbolic parameter slot bound later.
+// MEASURE reads a qubit mid-circuit into a classical bit; any gate can be
+// conditioned on classical bits measured earlier in the same run.
+enum class GateOp : uint8_t { H, X, Y, Z, S, T, SDG, TDG, U, RX, RY, RZ, MEASURE, SWAP, CNOT, CZ, CPHASE };
+
+inline const char *gateName(GateOp op) {
+    static const char *names[] = {"H","X","Y","Z","S","T","SDG","TDG","U","RX","RY","RZ","MEASURE","SWAP","CNOT","CZ","CPHASE"};
+    return names[(int)op];
+}
+
+// Inverse of gateName for the string-based entry points.
+inline GateOp gateOp(std::string_view name) {
+    for(int i=0;i<=(int)GateOp::CPHASE;i++) if(name == gateName((GateOp)i)) return (GateOp)i;
+    throw std::invalid_argument("unknown gate \"" + std::string(name) + "\"");
+}
+
+inline bool isTwoQubit(GateOp op) { return op >= GateOp::SWAP; }
+inline bool isRotation(GateOp op) { return op == GateOp::RX || op == GateOp::RY || op == GateOp::RZ || op == GateOp::CPHASE; }
+
+// Symbolic angle: slot `index` of the parameter vector passed to bind().
+struct Param {
+    int32_t index;
+};
+
+struct Instruction {
+    GateOp op;
+    int32_t q0;
+    int32_t q1;    // second qubit for two-qubit ops, -1 otherwise
+    double params[3]; // gate parameters (U: theta, phi, lambda; rotations: angle), unused by the fixed gates
+    int32_t param = -1; // parameter slot feeding params[0], -1 when literal
+    // Classical side, in what would otherwise be padding. MEASURE writes bit
+    // `cbit`; a gate with cwidth > 0 only acts when bits cbit..cbit+cwidth-1
+    // read `cvalue` (bit i of the value is bit cbit+i).
+    int16_t cbit = -1;
+    uint8_t cwidth = 0;
+    uint8_t cvalue = 0;
+};
+
+constexpr int max_condition_bits = 8;
+
+inline bool isConditional(const Instruction &in) { return in.cwidth != 0; }
+// Touches the classical register: scheduling and optimization keep these in
+// order with each other and never merge them away.
+inline bool isClassical(const Instruction &in) { return in.op == GateOp::MEASURE || in.cwidth != 0; }
+// Classical bits after the instruction's last one (0 if it touches none).
+inline int classicalEnd(const Instruction &in) { return in.op == GateOp::MEASURE ? in.cbit + 1 : in.cwidth ? in.cbit + in.cwidth : 0; }
+
+inline bool conditionHolds(const Instruction &in, const uint8_t *bits) {
+    for(int i=0;i<in.cwidth;i++) if(bits[in.cbit + i] != ((in.cvalue >> i) & 1)) return false;
+    return true;
+}
+
+// 2x2 unitary of a single-qubit instruction, row-major {m00, m01, m10, m11}.
+using Matrix2 = std::complex<double>[4];
+
+inline void u3Matrix(double theta, double phi, double lambda, Matrix2 &m) {
+    double c = std::cos(theta/2), s = std::sin(theta/2);
+    m[0] = c;
+    m[1] = -std::polar(s, lambda);
+    m[2] = std::polar(s, phi);
+    m[3] = std::polar(c, phi + lambda);
+}
+
+inline void gateMatrix(const Instruction &in, Matrix2 &m) {
+    using C = std::complex<double>;
+    const double r = 1.0 / std::sqrt(2.0);
+    switch(in.op){
+    case GateOp::H:   m[0] = r; m[1] = r; m[2] = r; m[3] = -r; break;
+    case GateOp::X:   m[0] = 0; m[1] = 1; m[2] = 1; m[3] = 0; break;
+    case GateOp::Y:   m[0] = 0; m[1] = C(0,-1); m[2] = C(0,1); m[3] = 0; break;
+    case GateOp::Z:   m[0] = 1; m[1] = 0; m[2] = 0; m[3] = -1; break;
+    case GateOp::S:   m[0] = 1; m[1] = 0; m[2] = 0; m[3] = C(0,1); break;
+    case GateOp::T:   m[0] = 1; m[1] = 0; m[2] = 0; m[3] = C(r,r); break;
+    case GateOp::SDG: m[0] = 1; m[1] = 0; m[2] = 0; m[3] = C(0,-1); break;
+    case GateOp::TDG: m[0] = 1; m[1] = 0; m[2] = 0; m[3] = C(r,-r); break;
+    case GateOp::U:   u3Matrix(in.params[0], in.params[1], in.params[2], m); break;
+    case GateOp::RX:  m[0] = std::cos(in.params[0]/2); m[1] = C(0, -std::sin(in.params[0]/2)); m[2] = m[1]; m[3] = m[0]; break;
+    case GateOp::RY:  m[0] = std::cos(in.params[0]/2); m[1] = -std::sin(in.params[0]/2); m[2] = -m[1]; m[3] = m[0]; break;
+    case GateOp::RZ:  m[0] = std::polar(1.0, -in.params[0]/2); m[1] = 0; m[2] = 0; m[3] = std::polar(1.0, in.params[0]/2); break;
+    default: throw std::invalid_argument(std::string("gateMatrix: ") + gateName(in.op) + " is not a single-qubit gate");
+    }
+}
+
+// Records instructions without executing them.
+class CircuitIR {
+private:
+    std::vector<Instruction> instrs;
+    int width = 0;
+    int params = 0;
+    int bits = 0;
+    Instruction next_condition{GateOp::H, 0, -1, {}}; // set by when(), applies to the next gate
+
+    void add(Instruction in) {
+        if(next_condition.cwidth) { in.cbit = next_condition.cbit; in.cwidth = next_condition.cwidth; in.cvalue = next_condition.cvalue; next_condition.cwidth = 0; }
+        if(in.q0 < 0 || (isTwoQubit(in.op) && (in.q1 < 0 || in.q1 == in.q0))) throw std::invalid_argument("CircuitIR: bad qubit operands");
+        if(in.param >= 0 && !isRotation(in.op)) throw std::invalid_argument(std::string("CircuitIR: ") + gateName(in.op) + " takes no symbolic parameter");
+        if(in.op == GateOp::MEASURE && (in.cbit < 0 || in.cwidth)) throw std::invalid_argument("CircuitIR: MEASURE needs a classical bit and cannot be conditional");
+        if(in.cwidth && (in.cbit < 0 || in.cwidth > max_condition_bits || in.cvalue >> in.cwidth))
+            throw std::invalid_argument("CircuitIR: bad condition");
+        instrs.push_back(in);
+        width = std::max(width, std::max(in.q0, in.q1) + 1);
+        params = std::max(params, in.param + 1);
+        bits = std::max(bits, classicalEnd(in));
+    }
+
+    void add(GateOp op, int q0, int q1=-1) { add(Instruction{op, q0, q1, {0.0, 0.0, 0.0}}); }
+
+public:
+    void h(int q) { add(GateOp::H,q); }
+    void x(int q) { add(GateOp::X,q); }
+    void y(int q) { add(GateOp::Y,q); }
+    void z(int q) { add(GateOp::Z,q); }
+    void s(int q) { add(GateOp::S,q); }
+    void t(int q) { add(GateOp::T,q); }
+    void sdg(int q) { add(GateOp::SDG,q); }
+    void tdg(int q) { add(GateOp::TDG,q); }
+    void u(int q, double theta, double phi, double lambda) { add(Instruction{GateOp::U, q, -1, {theta, phi, lambda}}); }
+    void rx(int q, double angle) { add(Instruction{GateOp::RX, q, -1, {angle}}); }
+    void ry(int q, double angle) { add(Instruction{GateOp::RY, q, -1, {angle}}); }
+    void rz(int q, double angle) { add(Instruction{GateOp::RZ, q, -1, {angle}}); }
+    void rx(int q, Param p) { add(Instruction{GateOp::RX, q, -1, {}, p.index}); }
+    void ry(int q, Param p) { add(Instruction{GateOp::RY, q, -1, {}, p.index}); }
+    void rz(int q, Param p) { add(Instruction{GateOp::RZ, q, -1, {}, p.index}); }
+    void swap(int q1,int q2) { add(GateOp::SWAP,q1,q2); }
+    void cnot(int q1,int q2) { add(GateOp::CNOT,q1,q2); }
+    void cz(int q1,int q2) { add(GateOp::CZ,q1,q2); }
+    void cphase(int q1, int q2, double angle) { add(Instruction{GateOp::CPHASE, q1, q2, {angle}}); }
+    void cphase(int q1, int q2, Param p) { add(Instruction{GateOp::CPHASE, q1, q2, {}, p.index}); }
+
+    // Mid-circuit measurement of q into classical bit `bit`.
+    void measure(int q, int bit) {
+        if(bit < 0 || bit >= INT16_MAX) throw std::invalid_argument("CircuitIR: classical bit " + std::to_string(bit) + " out of range");
+        add(Instruction{GateOp::MEASURE, q, -1, {}, -1, (int16_t)bit});
+    }
+
+    // Condition the next gate: ir.when(b).x(q) flips q only if bit b read 1;
+    // when(first, width, value) tests up to max_condition_bits bits at once.
+    CircuitIR &when(int bit) { return when(bit, 1, 1); }
+    CircuitIR &when(int first, int width_, unsigned value) {
+        if(first < 0 || first + width_ >= INT16_MAX || width_ < 1 || width_ > max_condition_bits || value >> width_)
+            throw std::invalid_argument("CircuitIR::when: bad condition");
+        next_condition.cbit = (int16_t)first;
+        next_condition.cwidth = (uint8_t)width_;
+        next_condition.cvalue = (uint8_t)value;
+        return *this;
+    }
+
+    void append(const Instruction &in) { add(in); }
+    void clear() { instrs.clear(); width = 0; params = 0; bits = 0; next_condition.cwidth = 0; }
+
+    const std::vector<Instruction> &instructions() const { return instrs; }
+    int numQubits() const { return width; }
+    int numParams() const { return params; }
+    int numBits() const { return bits; }
+    size_t size() const { return instrs.size(); }
+};
+
+// --------------------------
+// Compiled Circuit
+// --------------------------
+// Immutable, validated instruction stream grouped into moments: contiguous runs
+// of gates on disjoint qubits that may be dispatched together. Executors walk it
+// directly, so a compiled circuit can be run any number of times with no
+// per-gate allocation.
+class CompiledCircuit {
+private:
+    std::vector<Instruction> instrs;
+    std::vector<uint32_t> moment_offsets{0}; // moment i is [offsets[i], offsets[i+1])
+    std::vector<uint32_t> param_sites;       // instructions reading a parameter slot
+    std::vector<int> final_layout;           // logical -> physical qubit after routing, empty if not routed
+    int width = 0;
+    int params = 0;
+    int bits = 0;
+    size_t two_qubit_count = 0;
+    size_t classical_count = 0;
+    bool is_bound = true;
+
+    void index() {
+        for(size_t i=0;i<instrs.size();i++){
+            if(isTwoQubit(instrs[i].op)) two_qubit_count++;
+            if(isClassical(instrs[i])) { classical_count++; bits = std::max(bits, classicalEnd(instrs[i])); }
+            if(instrs[i].param >= 0) { param_sites.push_back((uint32_t)i); params = std::max(params, instrs[i].param + 1); }
+        }
+        is_bound = param_sites.empty();
+    }
+
+public:
+    CompiledCircuit() = default;
+
+    // Program order, one moment per instruction.
+    explicit CompiledCircuit(const CircuitIR &ir) : instrs(ir.instructions()), width(ir.numQubits()) {
+        for(size_t i=0;i<instrs.size();i++) moment_offsets.push_back((uint32_t)i+1);
+        index();
+    }
+
+    CompiledCircuit(std::vector<Instruction> ordered, std::vector<uint32_t> offsets, int width_)
+        : instrs(std::move(ordered)), moment_offsets(std::move(offsets)), width(width_) {
+        if(moment_offsets.empty() || moment_offsets.front() != 0 || moment_offsets.back() != instrs.size())
+            throw std::invalid_argument("CompiledCircuit: moment offsets do not cover the instruction stream");
+        instrs.shrink_to_fit();
+        index();
+    }
+
+    // Patch every symbolic angle in place; scheduling and fusion are untouched,
+    // so a sweep compiles once and rebinds per point.
+    void bind(const std::vector<double> &values) {
+        if((int)values.size() < params) throw std::invalid_argument("CompiledCircuit::bind: " + std::to_string(params) + " parameters, " + std::to_string(values.size()) + " values");
+        for(uint32_t i: param_sites) instrs[i].params[0] = values[instrs[i].param];
+        is_bound = true;
+    }
+
+    int numParams() const { return params; }
+    bool bound() const { return is_bound; }
+
+    // Set by routing: where each logical qubit of the source circuit ends up,
+    // i.e. which physical qubit to read it from.
+    void setFinalLayout(std::vector<int> layout) { final_layout = std::move(layout); }
+    const std::vector<int> &finalLayout() const { return final_layout; }
+    int physical(int logical) const { return final_layout.empty() ? logical : final_layout.at(logical); }
+
+    const Instruction *begin() const { return instrs.data(); }
+    const Instruction *end() const { return instrs.data() + instrs.size(); }
+    const std::vector<Instruction> &instructions() const { return instrs; }
+    size_t size() const { return instrs.size(); }
+    int numQubits() const { return width; }
+    size_t twoQubitGates() const { return two_qubit_count; }
+    int numBits() const { return bits; }
+    // Mid-circuit measurements or conditional gates: each run depends on
+    // its own readouts, so shots cannot be sampled from one preparation.
+    bool hasFeedback() const { return classical_count != 0; }
+
+    size_t depth() const { return moment_offsets.size() - 1; }
+    const Instruction *momentBegin(size_t m) const { return instrs.data() + moment_offsets[m]; }
+    const Instruction *momentEnd(size_t m) const { return instrs.data() + moment_offsets[m+1]; }
+    size_t momentSize(size_t m) const { return moment_offsets[m+1] - moment_offsets[m]; }
+};
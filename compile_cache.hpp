@@ -0,0 +1,143 @@
+#pragma once
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <cstring>
+#include <cstdint>
+#include "circuit_ir.hpp"
+
+// --------------------------
+// Compile Cache
+// --------------------------
+// Content-addressed store of compile results (CompiledCircuit, distributed
+// schedules, ...). The key is a structural hash of the gate IR plus what the
+// result depends on besides the gates: the target (device or module layout),
+// the calibration epoch and the compile options. Entries keep a copy of the
+// source instructions, so a hash collision degrades to a miss rather than a
+// wrong circuit. LRU eviction keeps the estimated footprint under a byte cap.
+
+inline uint64_t mix64(uint64_t x) { // splitmix64 finalizer
+    x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27; x *= 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+inline uint64_t structuralHash(const std::vector<Instruction> &instrs, int width) {
+    uint64_t h = mix64(0x9e3779b97f4a7c15ull ^ (uint64_t)width);
+    for(const Instruction &in: instrs){
+        h = mix64(h ^ ((uint64_t)in.op << 56 | (uint64_t)(uint32_t)in.q0 << 24 | (uint32_t)(in.q1 + 1)));
+        if(in.param >= 0) h = mix64(h ^ (0x5ull << 60 | (uint32_t)in.param));
+        else if(in.op == GateOp::U || isRotation(in.op)) for(double p: in.params) { uint64_t b; std::memcpy(&b, &p, 8); h = mix64(h ^ b); }
+        if(isClassical(in)) h = mix64(h ^ (0x6ull << 60 | (uint64_t)(uint16_t)in.cbit << 16 | (uint64_t)in.cwidth << 8 | in.cvalue));
+    }
+    return h;
+}
+
+inline uint64_t structuralHash(const CircuitIR &ir) { return structuralHash(ir.instructions(), ir.numQubits()); }
+
+// FNV-1a, for target descriptions such as "statevector/20".
+inline uint64_t hashTarget(std::string_view s) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for(unsigned char c: s) { h ^= c; h *= 0x100000001b3ull; }
+    return h;
+}
+
+struct CompileKey {
+    uint64_t circuit = 0, target = 0, epoch = 0, options = 0;
+    bool operator==(const CompileKey &o) const { return circuit == o.circuit && target == o.target && epoch == o.epoch && options == o.options; }
+};
+
+struct CompileCacheStats {
+    uint64_t hits = 0, misses = 0, evictions = 0;
+    size_t entries = 0, bytes = 0;
+    double hitRate() const { return hits + misses ? (double)hits / (hits + misses) : 0.0; }
+};
+
+template<typename T>
+class CompileCache {
+private:
+    struct KeyHash {
+        size_t operator()(const CompileKey &k) const { return (size_t)mix64(k.circuit ^ mix64(k.target ^ mix64(k.epoch ^ k.options))); }
+    };
+    struct Entry {
+        CompileKey key;
+        std::vector<Instruction> source;
+        std::shared_ptr<const T> value;
+        size_t bytes;
+    };
+
+    size_t capacity_bytes;
+    std::list<Entry> lru; // most recently used first
+    std::unordered_map<CompileKey, typename std::list<Entry>::iterator, KeyHash> index;
+    CompileCacheStats counters;
+    std::mutex mtx;
+
+    static bool sameSource(const std::vector<Instruction> &a, const std::vector<Instruction> &b) {
+        if(a.size() != b.size()) return false;
+        for(size_t i=0;i<a.size();i++){
+            const Instruction &x = a[i], &y = b[i];
+            if(x.op != y.op || x.q0 != y.q0 || x.q1 != y.q1 || x.param != y.param || x.cbit != y.cbit || x.cwidth != y.cwidth || x.cvalue != y.cvalue || std::memcmp(x.params, y.params, sizeof(x.params)) != 0) return false;
+        }
+        return true;
+    }
+
+    void evict() {
+        while(counters.bytes > capacity_bytes && !lru.empty()){
+            counters.bytes -= lru.back().bytes;
+            index.erase(lru.back().key);
+            lru.pop_back();
+            counters.evictions++;
+        }
+    }
+
+public:
+    explicit CompileCache(size_t max_bytes = 64 << 20) : capacity_bytes(max_bytes) {}
+
+    // Cached result for (key, source), or build() on a miss. build runs
+    // outside the lock; `bytes` estimates the result's footprint.
+    template<typename Build, typename Bytes>
+    std::shared_ptr<const T> getOrBuild(const CompileKey &key, const std::vector<Instruction> &source, Build &&build, Bytes &&bytes) {
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            auto it = index.find(key);
+            if(it != index.end() && sameSource(it->second->source, source)){
+                lru.splice(lru.begin(), lru, it->second);
+                counters.hits++;
+                return it->second->value;
+            }
+            counters.misses++;
+        }
+        std::shared_ptr<const T> value = std::make_shared<const T>(build());
+        size_t size = bytes(*value) + source.size()*sizeof(Instruction) + sizeof(Entry);
+        std::lock_guard<std::mutex> guard(mtx);
+        auto it = index.find(key);
+        if(it != index.end()) { counters.bytes -= it->second->bytes; lru.erase(it->second); index.erase(it); }
+        if(size > capacity_bytes) return value; // too big to keep
+        lru.push_front(Entry{key, source, value, size});
+        index[key] = lru.begin();
+        counters.bytes += size;
+        evict();
+        return value;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> guard(mtx);
+        lru.clear();
+        index.clear();
+        counters.bytes = 0;
+    }
+
+    CompileCacheStats stats() {
+        std::lock_guard<std::mutex> guard(mtx);
+        CompileCacheStats s = counters;
+        s.entries = lru.size();
+        return s;
+    }
+};
+
+inline size_t compiledBytes(const CompiledCircuit &c) {
+    return sizeof(CompiledCircuit) + c.size()*sizeof(Instruction) + (c.depth()+1)*sizeof(uint32_t) + c.finalLayout().size()*sizeof(int);
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstring>
+#include "circuit_ir.hpp"
+#include "compile_cache.hpp"
+#include "optimizer.hpp"
+#include "routing.hpp"
+#include "scheduler.hpp"
+
+// --------------------------
+// Compile Pipeline
+// --------------------------
+// IR -> CompiledCircuit. Passes run in a fixed order: peephole optimization on
+// program order, SWAP routing onto the device's coupling map (if it has one),
+// then moment scheduling.
+struct CompileOptions {
+    SchedulePolicy schedule = SchedulePolicy::ASAP;
+    bool optimize = true;           // cancel inverse pairs, merge phases
+    bool fuse_single_qubit = false; // fold single-qubit runs into U3 (needs Backend::supportsUnitary)
+    const CouplingMap *coupling = nullptr; // route onto this map; null = all-to-all
+    RoutingOptions routing;
+};
+
+// Cache-key component for everything in CompileOptions: with a coupling map,
+// the map and every routing setting (doubles by their bits, as in
+// structuralHash).
+inline uint64_t hashOptions(const CompileOptions &opts) {
+    uint64_t h = (uint64_t)opts.schedule | (uint64_t)opts.optimize << 8 | (uint64_t)opts.fuse_single_qubit << 9;
+    if(!opts.coupling) return h;
+    const RoutingOptions &r = opts.routing;
+    uint64_t weight, decay;
+    std::memcpy(&weight, &r.lookahead_weight, 8);
+    std::memcpy(&decay, &r.decay_step, 8);
+    h = mix64(h ^ opts.coupling->hash());
+    h = mix64(h ^ ((uint64_t)(uint32_t)r.lookahead << 32 | (uint32_t)r.layout_passes));
+    h = mix64(h ^ (uint32_t)r.decay_reset);
+    h = mix64(h ^ weight);
+    return mix64(h ^ decay);
+}
+
+// With a report, gates_before/depth_before describe the input IR and
+// gates_after/depth_after the returned circuit, whichever passes ran.
+inline CompiledCircuit compile(const CircuitIR &ir, const CompileOptions &opts = {}, OptimizationReport *report = nullptr) {
+    std::vector<Instruction> instrs;
+    if(opts.optimize) {
+        OptimizeOptions o;
+        o.fuse_single_qubit = opts.fuse_single_qubit;
+        instrs = optimizeCircuit(ir.instructions(), ir.numQubits(), o, report);
+    } else if(report) {
+        uint32_t depth;
+        assignMoments(ir.instructions(), ir.numQubits(), SchedulePolicy::ASAP, depth);
+        *report = OptimizationReport{};
+        report->gates_before = ir.size();
+        report->depth_before = depth;
+    }
+    const std::vector<Instruction> &source = opts.optimize ? instrs : ir.instructions();
+    CompiledCircuit out;
+    if(!opts.coupling) out = scheduleMoments(source, ir.numQubits(), opts.schedule);
+    else {
+        RoutingReport routed;
+        out = scheduleMoments(routeCircuit(source, ir.numQubits(), *opts.coupling, opts.routing, &routed), opts.coupling->numQubits(), opts.schedule);
+        out.setFinalLayout(std::move(routed.final_layout));
+        if(report) report->swaps_inserted = routed.swaps;
+    }
+    if(report) {
+        report->gates_after = out.size();
+        report->depth_after = out.depth();
+    }
+    return out;
+}
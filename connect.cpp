@@ -7,9 +7,31 @@
 #include <ctime>
 #include <thread>
 #include <mutex>
+#include <atomic>
 #include <algorithm>
 #include <numeric>
+#include <string_view>
+#include <stdexcept>
 #include <nlohmann/json.hpp> // JSON library: https://github.com/nlohmann/json
+#include "thread_pool.hpp"
+#include "executor.hpp"
+#include "compiler.hpp"
+#include "link_scheduler.hpp"
+#include "placement.hpp"
+#include "compile_cache.hpp"
+#include "shots.hpp"
+#include "decoder.hpp"
+#include "calibration.hpp"
+#include "qubit_table.hpp"
+#include "backend.hpp"
+#include "statevector.hpp"
+#include "stabilizer.hpp"
+#include "metrics.hpp"
+#include "rng.hpp"
+#include "parallel_shots.hpp"
+#include "feedback.hpp"
+#include "rpc.hpp"
+#include "pulse.hpp"
 
 using json = nlohmann::json;
 std::mutex log_mutex;
@@ -18,103 +40,658 @@ std::mutex log_mutex;
 // Hardware Interface
 // --------------------------
 namespace HardwareInterface {
-    void calibrate(int q, int moduleID) {
-        std::cout << "[Module " << moduleID << "] Calibrating qubit " << q << std::endl;
+    // Readout feedlines per module that digitize independently; shots can be
+    // read on all of them at once.
+    constexpr int readout_channels = 8;
+
+    QubitCalibration calibrate(int q, int moduleID) {
+        ScopedHwTimer timer(HwOp::Calibrate, moduleID, q);
+        if(consoleEnabled(Trace)) ConsoleLine() << "[Module " << moduleID << "] Calibrating qubit " << q;
         std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        QubitCalibration c;
+        c.frequency_ghz = 5.0f + 0.001f*q + 0.1f*moduleID;
+        c.pi_amplitude = 0.5f;
+        return c;
+    }
+
+    bool healthCheck(int q, int moduleID) {
+        ScopedHwTimer timer(HwOp::HealthCheck, moduleID, q);
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        return true;
     }
 
-    void sendPulse(int q, const std::string &gate, int moduleID) {
-        std::cout << "[Module " << moduleID << "] Applying " << gate << " to qubit " << q << std::endl;
-        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    // One pulse program on the module's electronics (see pulse.hpp): one DMA
+    // transfer and one trigger, so one round trip however many gates it holds.
+    void runPulseProgram(const unsigned char *image, size_t bytes, uint32_t duration_ns, int moduleID) {
+        ScopedHwTimer timer(HwOp::PulseProgram, moduleID, -1);
+        if(consoleEnabled(Trace)) ConsoleLine() << "[Module " << moduleID << "] Uploading pulse program: " << bytes << " bytes, " << duration_ns << " ns";
+        std::this_thread::sleep_for(std::chrono::milliseconds(2) + std::chrono::nanoseconds(bytes + duration_ns));
     }
 
-    void sendTwoQubitPulse(int q1, int module1, int q2, int module2, const std::string &gate) {
-        std::cout << "[Modules " << module1 << "," << module2 << "] Applying " << gate << " to qubits " << q1 << "," << q2 << std::endl;
+    // One link window between two modules: fixed setup (entanglement
+    // distribution and heralding) shared by every gate in the window.
+    void sendLinkBatch(int module1, int module2, const GlobalInstruction *gates, size_t n) {
+        ScopedHwTimer window(HwOp::LinkWindow, module1, -1);
+        if(consoleEnabled(Trace)) ConsoleLine() << "[Link " << module1 << "-" << module2 << "] Opening window for " << n << " gates";
         std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        for(size_t i=0;i<n;i++){
+            ScopedHwTimer timer(HwOp::TwoQubitPulse, gates[i].a.module, gates[i].a.qubit, gates[i].b.module, gates[i].b.qubit);
+            if(consoleEnabled(Trace)){
+                ConsoleLine line;
+                line << "[Modules " << gates[i].a.module << "," << gates[i].b.module << "] Applying " << gateName(gates[i].op);
+                if(isRotation(gates[i].op)) line << "(" << gates[i].params[0] << ")";
+                line << " to qubits " << gates[i].a.qubit << "," << gates[i].b.qubit;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
     }
 
     int readState(int q, int moduleID) {
-        return rand() % 2;
+        ScopedHwTimer timer(HwOp::ReadState, moduleID, q);
+        return (int)(threadRng()() >> 63);
+    }
+
+    // Whole-register readout for one shot, from the module's counter-based
+    // stream: reproducible per (stream, shot, qubit).
+    void readRegister(const std::vector<int> &qubits, const CounterRng &stream, uint64_t shot, uint64_t *row, int moduleID) {
+        ScopedHwTimer timer(HwOp::ReadState, moduleID, -1);
+        stream.gather(shot, qubits.data(), qubits.size(), row);
     }
 }
 
+// One module's electronics behind the Backend interface. Gates collect in
+// the sequencer's open pulse program until the module's executor runs dry
+// (flush) or something must see their effect: readout, calibration, reset,
+// a link window.
+class HardwareBackend : public Backend {
+private:
+    int moduleID;
+    int n;
+    CounterRng stream;
+    PulseSequencer sequencer;
+public:
+    HardwareBackend(int id, int qubits)
+        : moduleID(id), n(qubits), stream(rngSeed(), rngStream(0, id)),
+          sequencer(qubits, [id](const unsigned char *image, size_t bytes, uint32_t ns) { HardwareInterface::runPulseProgram(image, bytes, ns, id); }) {}
+    const char *name() const override { return "hardware"; }
+    int numQubits() const override { return n; }
+    QubitCalibration calibrate(int q) override {
+        sequencer.flush();
+        QubitCalibration c = HardwareInterface::calibrate(q, moduleID);
+        sequencer.setCalibration(q, c);
+        return c;
+    }
+    void setCalibration(int q, const QubitCalibration &c) override { sequencer.setCalibration(q, c); }
+    bool healthCheck(int q) override { sequencer.flush(); return HardwareInterface::healthCheck(q, moduleID); }
+    void sendPulse(int q, GateOp op) override { sequencer.gate(op, q); }
+    void sendTwoQubitPulse(int q1, int q2, GateOp op) override { sequencer.twoQubit(op, q1, q2); }
+    bool supportsUnitary() const override { return true; }
+    void sendUnitary(int q, const double params[3]) override { sequencer.unitary(q, params); }
+    void sendRotation(int q, GateOp op, double angle) override { sequencer.rotation(op, q, angle); }
+    void sendControlledPhase(int q1, int q2, double angle) override { sequencer.twoQubit(GateOp::CPHASE, q1, q2, angle); }
+    int readState(int q) override { sequencer.flush(); return HardwareInterface::readState(q, moduleID); }
+    void readRegister(const std::vector<int> &qubits, uint64_t shot, uint64_t *row) override { sequencer.flush(); HardwareInterface::readRegister(qubits, stream, shot, row, moduleID); }
+    void setRngStream(uint64_t s) override { stream = CounterRng(rngSeed(), s); }
+    void reset() override { sequencer.reset(); }
+    void sendLinkWindow(int peer, const GlobalInstruction *gates, size_t n) override { sequencer.flush(); HardwareInterface::sendLinkBatch(moduleID, peer, gates, n); }
+    void flush() override { sequencer.flush(); }
+    bool concurrentPulses() const override { return false; }
+    int readoutChannels() const override { return HardwareInterface::readout_channels; }
+
+    PulseStats pulseStats() { return sequencer.stats(); }
+};
+
 // --------------------------
 // Quantum Module (100 qubits)
 // --------------------------
+// Created by QuantumSupercomputer::addModule. Per-qubit state lives in the
+// supercomputer's QubitTable, rows [base, base+num_qubits).
 class QuantumModule {
 public:
     int moduleID;
     int num_qubits;
-    std::vector<bool> calibrated;
+    int base;          // global index of local qubit 0
+    QubitTable &table;
+    std::unique_ptr<Backend> backend;
+    std::atomic<uint64_t> next_shot{0}; // shot counter into the backend's random stream
+    ThreadPool *readout_pool = nullptr; // shot chunks run here when set (the supercomputer's pool)
+    std::shared_ptr<const CouplingMap> coupling; // chip connectivity; null = all-to-all
+    ClassicalRegister creg;             // mid-circuit readouts; written on the executor thread
+    rpc::RemoteBackend *remote = nullptr; // the backend, when the module is served by a ModuleAgent
+    // Last: its thread uses the members above. Batched pulses to a remote
+    // module go out whenever the queue runs dry.
+    ModuleExecutor executor{[this](const Instruction &in) { apply(in); }, 1024, [this]() { backend->flush(); }};
+
+    QuantumModule(int id, QubitTable &t, std::unique_ptr<Backend> b)
+        : moduleID(id), num_qubits(b->numQubits()), base(t.addModule(num_qubits)), table(t), backend(std::move(b)) {}
+
+    bool calibrated(int q) const { return table.calibrated[base+q]; }
+
+    QubitCalibration calibrateQubit(int q, uint64_t pass) {
+        QubitCalibration c = backend->calibrate(q);
+        c.timestamp_ms = wallClockMs();
+        c.status = Calibrated;
+        table.setCalibration(base+q, c, pass);
+        return c;
+    }
+
+    CalibrationReport calibrateAll(uint64_t pass, unsigned lines=8, const CalibrationProgress &progress={}) {
+        return calibrateConcurrent(moduleID, num_qubits, lines, [this, pass](int q) { calibrateQubit(q, pass); }, progress);
+    }
+
+    CalibrationReport calibrateFromSnapshot(const std::string &path, std::chrono::milliseconds ttl, uint64_t pass, unsigned lines=8, const CalibrationProgress &progress={}) {
+        CalibrationSnapshot snapshot(moduleID, num_qubits);
+        snapshot.load(path);
+        CalibrationReport report = calibrateIncremental(moduleID, snapshot, ttl, lines,
+            [this, pass](int q) { return calibrateQubit(q, pass); },
+            [this, pass](int q, const QubitCalibration &c) { table.setCalibration(base+q, c, pass); backend->setCalibration(q, c); },
+            [this](int q) { return backend->healthCheck(q); }, progress);
+        snapshot.save(path);
+        return report;
+    }
+
+    // Last-used time of the qubits a pulse just went to.
+    void touch(int q1, int q2=-1) {
+        int64_t now = wallClockMs();
+        table.last_used_ms[base+q1] = now;
+        if(q2 >= 0) table.last_used_ms[base+q2] = now;
+    }
+
+    void applyGate(GateOp op, int q) {
+        if(calibrated(q)) { backend->sendPulse(q, op); touch(q); }
+    }
+
+    void applyTwoQubitGate(int q1, int q2, GateOp op) {
+        if(calibrated(q1) && calibrated(q2)) { backend->sendTwoQubitPulse(q1, q2, op); touch(q1, q2); }
+    }
+
+    void applyGate(std::string_view gate, int q) { applyGate(gateOp(gate), q); }
+    void applyTwoQubitGate(int q1, int q2, std::string_view gate) { applyTwoQubitGate(q1, q2, gateOp(gate)); }
 
-    QuantumModule(int id, int n=100) : moduleID(id), num_qubits(n), calibrated(n,false) { srand(time(0)); }
+    void apply(const Instruction &in) {
+        if(isClassical(in)) applyClassical(creg, in, moduleID, [this](int q) { return backend->readState(q); }, [this](const Instruction &g) { apply(g); });
+        else if(in.op == GateOp::CPHASE) { if(calibrated(in.q0) && calibrated(in.q1)) { backend->sendControlledPhase(in.q0, in.q1, in.params[0]); touch(in.q0, in.q1); } }
+        else if(isRotation(in.op)) { if(calibrated(in.q0)) { backend->sendRotation(in.q0, in.op, in.params[0]); touch(in.q0); } }
+        else if(isTwoQubit(in.op)) applyTwoQubitGate(in.q0, in.q1, in.op);
+        else if(in.op == GateOp::U) { if(calibrated(in.q0)) { backend->sendUnitary(in.q0, in.params); touch(in.q0); } }
+        else applyGate(in.op, in.q0);
+    }
+
+    void run(const CompiledCircuit &circuit) {
+        if(circuit.numQubits() > num_qubits) throw std::out_of_range("QuantumModule::run: circuit wider than module");
+        if(!circuit.bound()) throw std::invalid_argument("QuantumModule::run: circuit has unbound parameters");
+        creg.reset(circuit.numBits());
+        for(const Instruction &in: circuit) apply(in);
+        backend->flush();
+    }
 
-    void calibrateQubit(int q) {
-        HardwareInterface::calibrate(q, moduleID);
-        calibrated[q] = true;
+    ShotBuffer sampleShots(const std::vector<int> &qubits, int shots=1) {
+        ShotBuffer buf;
+        uint64_t first = next_shot.fetch_add(shots, std::memory_order_relaxed);
+        if(backend->sampleShots(qubits, first, shots, buf, readout_pool)) return buf;
+        buf = ShotBuffer(qubits, shots);
+        readShots(readout_pool, *backend, qubits, first, buf);
+        return buf;
     }
 
-    void applyGate(const std::string &gate, int q) {
-        if(calibrated[q]) HardwareInterface::sendPulse(q, gate, moduleID);
+    // Replayable readout: later shots come from the stream of (job, this
+    // module), numbered from `first_shot`.
+    void seedShots(uint64_t job, uint64_t first_shot = 0) {
+        backend->setRngStream(rngStream(job, moduleID));
+        next_shot = first_shot;
     }
 
-    void applyTwoQubitGate(int q1, int q2, const std::string &gate) {
-        if(calibrated[q1] && calibrated[q2]) HardwareInterface::sendTwoQubitPulse(q1, moduleID, q2, moduleID, gate);
+    ShotBuffer measureLogicalBatch(const GroupLayout &groups, int shots=1, const LogicalDecoder &decoder=MajorityDecoder()) {
+        return decodeLogical(sampleShots(layoutQubits(groups), shots), groups, decoder);
     }
 
     std::map<std::string,int> measureLogical(const std::vector<int> &qubits, int shots=1) {
-        std::map<std::string,int> results = {{"0",0},{"1",0}};
-        for(int s=0;s<shots;s++){
-            std::vector<int> votes;
-            for(int q: qubits) votes.push_back(HardwareInterface::readState(q,moduleID));
-            int sum = std::accumulate(votes.begin(),votes.end(),0);
-            int corrected = (sum > qubits.size()/2) ? 1 : 0;
-            results[std::to_string(corrected)]++;
-        }
-        return results;
+        int ones = (int)measureLogicalBatch({qubits}, shots).ones()[0];
+        return {{"0",shots-ones},{"1",ones}};
     }
 };
 
 // --------------------------
 // Quantum Supercomputer (multi-module)
 // --------------------------
+// A logical circuit after placement and link scheduling.
+struct PlacedCircuit {
+    Placement placement;
+    DistributedSchedule schedule;
+};
+
+// Start-time agreement of link windows with a remote end.
+struct LinkSyncStats {
+    uint64_t windows = 0;
+    int64_t max_skew_ns = 0;   // worst start difference between the two ends of a window
+    int64_t total_skew_ns = 0;
+    double meanSkewUs() const { return windows ? total_skew_ns / 1e3 / windows : 0.0; }
+};
+
+inline size_t placedBytes(const PlacedCircuit &p) {
+    size_t bytes = sizeof(PlacedCircuit) + p.placement.map.size()*sizeof(QubitRef);
+    for(const DistributedStage &st: p.schedule.stages){
+        bytes += sizeof(DistributedStage);
+        for(auto &l: st.local) bytes += sizeof(l) + l.second.size()*sizeof(Instruction);
+        for(auto &b: st.links) bytes += sizeof(b) + b.gates.size()*sizeof(GlobalInstruction);
+    }
+    return bytes;
+}
+
 class QuantumSupercomputer {
 private:
-    std::vector<QuantumModule*> modules;
-    std::mutex mtx;
+    QubitTable table;                                    // before the modules: their executors write it
+    std::vector<std::unique_ptr<QuantumModule>> modules;
+    ThreadPool pool;
+    uint64_t calibration_epoch = 0; // bumped by every calibration pass
+    CompileCache<PlacedCircuit> placement_cache;
+    LinkOptions link_opts;
+    std::map<std::pair<int,int>, std::vector<GlobalInstruction>> link_queue; // immediate-mode remote gates not yet sent
+    int remote_modules = 0;
+    std::mutex link_sync_mtx;
+    LinkSyncStats link_sync;
+
+    bool calibrated(QubitRef r) const { return table.calibrated[table.base(r.module) + r.qubit]; }
+
+    // Link gates touch both modules' qubits, so everything already handed to
+    // their executors must have gone out first. Executors are only driven
+    // from the caller's thread, so this runs there, not on the pool.
+    void joinLink(int module1, int module2) {
+        modules[module1]->executor.drain();
+        modules[module2]->executor.drain();
+        if(modules[module1]->remote || modules[module2]->remote) settleRemotes({module1, module2});
+    }
+
+    // A drained remote module has only sent its work; barrier the agents
+    // (all at once) until they have run it.
+    void settleRemotes(const std::vector<int> &ids) {
+        std::vector<std::pair<rpc::RemoteBackend*, rpc::RemoteBackend::Pending>> waits;
+        for(int m: ids) if(rpc::RemoteBackend *r = modules[m]->remote) waits.emplace_back(r, r->postBarrier());
+        for(auto &w: waits) w.first->awaitBarrier(w.second);
+    }
+
+    // A link with a remote end opens every window at an agreed instant, far
+    // enough ahead for the slower agent to have the request by then (its best
+    // round trip plus a guard). Agents wait for it on their own clocks, a
+    // local end waits here; the barrier after the window reports when each
+    // agent really started, and the gap between the two ends is the skew.
+    void sendTimedWindows(int module1, int module2, const std::vector<GlobalInstruction> &gates, size_t window) {
+        QuantumModule *ends[2] = {modules[module1].get(), modules[module2].get()};
+        int64_t lead = 0;
+        for(QuantumModule *m: ends) if(m->remote) lead = std::max(lead, m->remote->roundTripNs() + m->remote->options().link_guard_ns);
+        for(size_t i=0;i<gates.size();i+=window){
+            size_t n = std::min(window, gates.size()-i);
+            int64_t start = rpc::steadyNs() + lead, started[2] = {0, 0};
+            rpc::RemoteBackend::Pending done[2];
+            for(int e=0;e<2;e++) if(ends[e]->remote) {
+                ends[e]->remote->scheduleLinkWindow(start, ends[1-e]->moduleID, gates.data()+i, n);
+                done[e] = ends[e]->remote->postBarrier();
+            }
+            for(int e=0;e<2;e++) if(!ends[e]->remote) {
+                rpc::sleepUntil(start);
+                started[e] = rpc::steadyNs();
+                ends[e]->backend->sendLinkWindow(ends[1-e]->moduleID, gates.data()+i, n);
+            }
+            for(int e=0;e<2;e++) if(ends[e]->remote) started[e] = ends[e]->remote->awaitBarrier(done[e]);
+            int64_t skew = std::abs(started[0] - started[1]);
+            std::lock_guard<std::mutex> guard(link_sync_mtx);
+            link_sync.windows++;
+            link_sync.max_skew_ns = std::max(link_sync.max_skew_ns, skew);
+            link_sync.total_skew_ns += skew;
+        }
+    }
+
+    // Each end's backend plays its own half of every window (the two halves
+    // of a local link side by side), so a backend without a link refuses the
+    // gates rather than dropping them.
+    void sendWindows(int module1, int module2, const std::vector<GlobalInstruction> &gates, size_t window) {
+        if(modules[module1]->remote || modules[module2]->remote) sendTimedWindows(module1, module2, gates, window);
+        else for(size_t i=0;i<gates.size();i+=window){
+            size_t n = std::min(window, gates.size()-i);
+            const int ends[2] = {module1, module2};
+            pool.parallelFor(2, [&](size_t e) { modules[ends[e]]->backend->sendLinkWindow(ends[1-e], gates.data()+i, n); });
+        }
+        int64_t now = wallClockMs();
+        for(const GlobalInstruction &g: gates) table.last_used_ms[table.base(g.a.module) + g.a.qubit] = table.last_used_ms[table.base(g.b.module) + g.b.qubit] = now;
+    }
+
+    bool touches(const GlobalInstruction &g, QubitRef r) const {
+        return (g.a.module == r.module && g.a.qubit == r.qubit) || (g.b.module == r.module && g.b.qubit == r.qubit);
+    }
+
+    // Run fn(module) on every module at once and rethrow the first failure.
+    template<typename F>
+    std::vector<CalibrationReport> eachModuleConcurrently(F &&fn) {
+        std::vector<CalibrationReport> reports(modules.size());
+        std::vector<std::exception_ptr> errors(modules.size());
+        std::vector<std::thread> threads;
+        for(size_t i=0;i<modules.size();i++){
+            threads.emplace_back([&, i]() {
+                try { reports[i] = fn(*modules[i]); }
+                catch(...) { errors[i] = std::current_exception(); }
+            });
+        }
+        for(auto &t: threads) t.join();
+        for(auto &e: errors) if(e) std::rethrow_exception(e);
+        return reports;
+    }
+
+    CalibrationProgress serialize(const CalibrationProgress &progress, std::mutex &m) {
+        if(!progress) return {};
+        return [&m, progress](int mod, int done, int total) {
+            std::lock_guard<std::mutex> guard(m);
+            progress(mod, done, total);
+        };
+    }
 
 public:
-    void addModule(QuantumModule* module) { modules.push_back(module); }
+    // Hardware calls block on the electronics rather than the CPU, so the pool
+    // is sized for concurrent modules and links, not for cores.
+    explicit QuantumSupercomputer(unsigned workers=8, LinkOptions links={}) : pool(workers), link_opts(links) {}
+
+    // The new module is numbered modules.size() and its qubits take the next
+    // global indices.
+    QuantumModule &addModule(std::unique_ptr<Backend> backend) {
+        sync();
+        modules.push_back(std::make_unique<QuantumModule>((int)modules.size(), table, std::move(backend)));
+        modules.back()->readout_pool = &pool;
+        return *modules.back();
+    }
+    QuantumModule &addModule(int qubits=100) { return addModule(std::make_unique<HardwareBackend>((int)modules.size(), qubits)); }
+
+    // A module served by a ModuleAgent at host:port (rpc.hpp), numbered and
+    // indexed like a local one. The agent's backend should be set up for
+    // the module number it gets here.
+    QuantumModule &addRemoteModule(const std::string &host, int port, rpc::RemoteOptions opts = {}) {
+        auto backend = std::make_unique<rpc::RemoteBackend>(host, port, opts);
+        rpc::RemoteBackend *r = backend.get();
+        QuantumModule &m = addModule(std::move(backend));
+        m.remote = r;
+        remote_modules++;
+        return m;
+    }
+
+    LinkSyncStats linkSyncStats() {
+        std::lock_guard<std::mutex> guard(link_sync_mtx);
+        return link_sync;
+    }
+
+    // Global qubit index space, 0..numQubits()-1 in module order.
+    int numQubits() const { return table.size(); }
+    QubitRef locate(int g) const { return table.locate(g); }
+    int globalIndex(int moduleID, int q) const { return table.global(moduleID, q); }
+    const QubitTable &qubits() const { return table; }
 
-    void calibrateAll() {
-        for(auto mod: modules) 
-            for(int i=0;i<mod->num_qubits;i++) mod->calibrateQubit(i);
+    // Measured T1/T2 and error rates for one qubit, e.g. from a characterization run.
+    void recordCharacterization(int g, float t1_us, float t2_us, float gate_error, float readout_error) {
+        sync();
+        table.setCharacterization(g, t1_us, t2_us, gate_error, readout_error);
     }
 
+    // Global indices due for recalibration (see QubitTable::needsRecalibration).
+    std::vector<int> healthScan(std::chrono::milliseconds max_age, float max_error=1.0f) {
+        sync();
+        return table.needsRecalibration(wallClockMs(), max_age.count(), max_error);
+    }
+
+    // Modules calibrate concurrently, each on up to `lines_per_module` control
+    // lines, so startup takes as long as the slowest module rather than the sum.
+    std::vector<CalibrationReport> calibrateAll(unsigned lines_per_module=8, const CalibrationProgress &progress={}) {
+        sync();
+        calibration_epoch++;
+        std::mutex progress_mtx;
+        CalibrationProgress serialized = serialize(progress, progress_mtx);
+        return eachModuleConcurrently([&](QuantumModule &m) { return m.calibrateAll(calibration_epoch, lines_per_module, serialized); });
+    }
+
+    // Warm start from one snapshot per module, "<prefix><moduleID>.bin".
+    std::vector<CalibrationReport> calibrateFromSnapshots(const std::string &prefix, std::chrono::milliseconds ttl, unsigned lines_per_module=8, const CalibrationProgress &progress={}) {
+        sync();
+        calibration_epoch++;
+        std::mutex progress_mtx;
+        CalibrationProgress serialized = serialize(progress, progress_mtx);
+        return eachModuleConcurrently([&](QuantumModule &m) {
+            return m.calibrateFromSnapshot(prefix + std::to_string(m.moduleID) + ".bin", ttl, calibration_epoch, lines_per_module, serialized);
+        });
+    }
+
+    // Gates go to the module's executor and return immediately; modules run
+    // concurrently until the next synchronization point (inter-module gate,
+    // measurement, sync()).
     void applyGate(int moduleID, const std::string &gate, int q) {
-        modules[moduleID]->applyGate(gate,q);
+        flushLinks();
+        modules[moduleID]->executor.submit(Instruction{gateOp(gate), q, -1, {}});
     }
 
+    // Inter-module gates are queued per module pair and go out in link windows
+    // once a window fills or anything else needs the machine (flushLinks).
     void applyTwoQubitGate(int module1, int q1, int module2, int q2, const std::string &gate) {
-        HardwareInterface::sendTwoQubitPulse(q1,module1,q2,module2,gate);
+        GateOp op = gateOp(gate);
+        if(module1 == module2) {
+            const CouplingMap *map = modules[module1]->coupling.get();
+            if(map && !map->connected(q1, q2)) throw std::invalid_argument("QuantumSupercomputer: qubits " + std::to_string(q1) + "," + std::to_string(q2) + " of module " + std::to_string(module1) + " share no coupler");
+            flushLinks();
+            modules[module1]->executor.submit(Instruction{op, q1, q2, {}});
+            return;
+        }
+        GlobalInstruction g{op, {module1, q1}, {module2, q2}, {}};
+        if(!calibrated(g.a) || !calibrated(g.b)) return;
+        std::pair<int,int> link{std::min(module1, module2), std::max(module1, module2)};
+        // A queued gate on another link sharing a qubit must go first.
+        bool conflict = false;
+        for(auto &[other, gates]: link_queue)
+            if(other != link) for(auto &p: gates) conflict = conflict || touches(p, g.a) || touches(p, g.b);
+        if(conflict) flushLinks();
+        std::vector<GlobalInstruction> &q = link_queue[link];
+        q.push_back(g);
+        if(q.size() >= link_opts.window) { joinLink(link.first, link.second); sendWindows(link.first, link.second, q, link_opts.window); q.clear(); }
+    }
+
+    // The same on global qubit indices.
+    void applyGate(const std::string &gate, int g) {
+        QubitRef r = locate(g);
+        applyGate(r.module, gate, r.qubit);
+    }
+    void applyTwoQubitGate(int g1, int g2, const std::string &gate) {
+        QubitRef a = locate(g1), b = locate(g2);
+        applyTwoQubitGate(a.module, a.qubit, b.module, b.qubit, gate);
+    }
+
+    // Send every queued inter-module gate; distinct links open concurrently.
+    void flushLinks() {
+        std::vector<std::pair<std::pair<int,int>, std::vector<GlobalInstruction>>> ready;
+        for(auto &[link, gates]: link_queue) if(!gates.empty()) ready.emplace_back(link, std::move(gates));
+        link_queue.clear();
+        for(auto &r: ready) joinLink(r.first.first, r.first.second);
+        pool.parallelFor(ready.size(), [&](size_t i) { sendWindows(ready[i].first.first, ready[i].first.second, ready[i].second, link_opts.window); });
+    }
+
+    DistributedSchedule schedule(const DistributedCircuit &circuit) const {
+        std::vector<int> widths;
+        for(auto &m: modules) widths.push_back(m->num_qubits);
+        return scheduleDistributed(circuit, widths, link_opts);
+    }
+
+    // Block until every module executor and link queue is empty, and every
+    // remote module has run what it was sent.
+    void sync() {
+        flushLinks();
+        for(auto &m: modules) m->executor.drain();
+        if(remote_modules){
+            std::vector<int> all(modules.size());
+            std::iota(all.begin(), all.end(), 0);
+            settleRemotes(all);
+        }
+    }
+
+    // Run a multi-module program stage by stage. Local gates stream into the
+    // module executors without waiting; only the modules a stage's links touch
+    // are joined before the windows open, so the others keep working while a
+    // link is busy.
+    void run(const DistributedSchedule &sched) {
+        flushLinks();
+        for(const DistributedStage &stage: sched.stages){
+            for(const LinkBatch &batch: stage.links) joinLink(batch.module1, batch.module2);
+            for(auto &[m, gates]: stage.local) modules[m]->executor.submit(gates.data(), gates.size());
+            pool.parallelFor(stage.links.size(), [&](size_t t) {
+                const LinkBatch &batch = stage.links[t];
+                std::vector<GlobalInstruction> gates;
+                gates.reserve(batch.gates.size());
+                for(const GlobalInstruction &g: batch.gates) if(calibrated(g.a) && calibrated(g.b)) gates.push_back(g);
+                sendWindows(batch.module1, batch.module2, gates, sched.window);
+            });
+        }
+        sync();
+    }
+
+    void run(const DistributedCircuit &circuit) { run(schedule(circuit)); }
+
+    // Partition a circuit on global logical qubits across the modules,
+    // minimizing inter-module gates.
+    Placement place(const CircuitIR &circuit, const PlacementOptions &opts = {}) const {
+        std::vector<int> widths;
+        for(auto &m: modules) widths.push_back(m->num_qubits);
+        return placeQubits(circuit, widths, opts);
+    }
+
+    // Placement plus link scheduling, cached by circuit structure, module
+    // layout and calibration epoch: resubmitted circuits skip both passes.
+    std::shared_ptr<const PlacedCircuit> prepare(const CircuitIR &circuit) {
+        std::string layout = "modules";
+        for(auto &m: modules) layout += "/" + std::to_string(m->num_qubits);
+        CompileKey key{structuralHash(circuit), hashTarget(layout), calibration_epoch, link_opts.window};
+        return placement_cache.getOrBuild(key, circuit.instructions(), [&]() {
+            for(const Instruction &in: circuit.instructions())
+                if(isClassical(in)) throw std::invalid_argument("QuantumSupercomputer: mid-circuit measurement and feedback run on one module (submit a CompiledCircuit)");
+            PlacedCircuit p;
+            p.placement = place(circuit);
+            p.schedule = schedule(applyPlacement(circuit, p.placement));
+            return p;
+        }, placedBytes);
+    }
+
+    CompileCacheStats placementCacheStats() { return placement_cache.stats(); }
+
+    // Parameter sweep over a logical circuit: placement and scheduling happen
+    // once (and are cached); each point rebinds the angles and runs, then
+    // `after_each(i)` can read out before the next point.
+    void sweep(const CircuitIR &circuit, const std::vector<std::vector<double>> &points, const std::function<void(size_t)> &after_each = {}) {
+        DistributedSchedule bound = prepare(circuit)->schedule;
+        for(size_t i=0;i<points.size();i++){
+            bound.bind(points[i]);
+            run(bound);
+            if(after_each) after_each(i);
+        }
+    }
+
+    // Place, remap and run a logical circuit; returns where each logical qubit went.
+    Placement run(const CircuitIR &circuit) {
+        std::shared_ptr<const PlacedCircuit> p = prepare(circuit);
+        run(p->schedule);
+        return p->placement;
+    }
+
+    // Queue a compiled circuit on one module and return at once; the circuit
+    // must stay alive until the next sync(). Circuits on different modules run
+    // at the same time. A circuit with classical bits first waits for the
+    // module to go idle, then starts from a cleared register.
+    void submit(const CompiledCircuit &circuit, int moduleID) {
+        QuantumModule &m = *modules[moduleID];
+        if(circuit.numQubits() > m.num_qubits) throw std::out_of_range("QuantumSupercomputer::submit: circuit wider than module");
+        if(m.coupling) m.coupling->check(circuit.begin(), circuit.end());
+        flushLinks();
+        if(circuit.numBits()) { m.executor.drain(); m.creg.reset(circuit.numBits()); }
+        m.executor.submit(circuit.begin(), circuit.size());
+    }
+
+    // Classical bits of the last feedback circuit run on a module.
+    const ClassicalRegister &classicalBits(int moduleID) {
+        modules[moduleID]->executor.drain();
+        return modules[moduleID]->creg;
+    }
+
+    // Chip connectivity of one module. Circuits for it then go through
+    // compileFor, which routes them onto the map with SWAPs.
+    void setCouplingMap(int moduleID, std::shared_ptr<const CouplingMap> map) {
+        if(map && map->numQubits() != modules[moduleID]->num_qubits) throw std::invalid_argument("QuantumSupercomputer::setCouplingMap: map is for " + std::to_string(map->numQubits()) + " qubits");
+        sync();
+        modules[moduleID]->coupling = std::move(map);
+    }
+
+    // Compile a circuit for one module, routed onto its coupling map if it has one.
+    CompiledCircuit compileFor(const CircuitIR &circuit, int moduleID, CompileOptions opts = {}, OptimizationReport *report = nullptr) const {
+        opts.coupling = modules[moduleID]->coupling.get();
+        return compile(circuit, opts, report);
+    }
+
+    // Replay a compiled circuit on one module.
+    void run(const CompiledCircuit &circuit, int moduleID) {
+        submit(circuit, moduleID);
+        modules[moduleID]->executor.drain();
+    }
+
+    // Every module onto the random streams of `job`, shot numbering from 0.
+    void seedShots(uint64_t job) {
+        sync();
+        for(auto &m: modules) m->seedShots(job);
     }
 
     std::map<std::string,int> measureLogical(int moduleID, const std::vector<int> &qubits, int shots=1) {
+        flushLinks();
+        modules[moduleID]->executor.drain();
         return modules[moduleID]->measureLogical(qubits, shots);
     }
+
+    // Logical qubit on global indices; the group has to sit on one module.
+    std::map<std::string,int> measureLogical(const std::vector<int> &group, int shots=1) {
+        if(group.empty()) throw std::invalid_argument("QuantumSupercomputer::measureLogical: empty group");
+        int moduleID = locate(group[0]).module;
+        std::vector<int> local;
+        for(int g: group){
+            QubitRef r = locate(g);
+            if(r.module != moduleID) throw std::invalid_argument("QuantumSupercomputer::measureLogical: group spans modules");
+            local.push_back(r.qubit);
+        }
+        return measureLogical(moduleID, local, shots);
+    }
+
+    ShotBuffer measureLogicalBatch(int moduleID, const GroupLayout &groups, int shots=1, const LogicalDecoder &decoder=MajorityDecoder()) {
+        flushLinks();
+        modules[moduleID]->executor.drain();
+        return modules[moduleID]->measureLogicalBatch(groups, shots, decoder);
+    }
 };
 
 // --------------------------
 // Example Usage
 // --------------------------
-int main() {
+// The benchmarks include this file for its classes and bring their own main.
+#ifndef QC_NO_MAIN
+int main(int argc, char **argv) {
+    // --agent <port> [module_id] [qubits]: serve one hardware module to a
+    // supercomputer on another host instead of running the demo
+    if(argc >= 3 && std::string(argv[1]) == "--agent"){
+        int id = argc > 3 ? std::atoi(argv[3]) : 0, qubits = argc > 4 ? std::atoi(argv[4]) : 100;
+        rpc::ModuleAgent agent(std::make_unique<HardwareBackend>(id, qubits), std::atoi(argv[2]));
+        std::cout << "Module " << id << " agent listening on port " << agent.port() << std::endl;
+        agent.serve();
+        return 0;
+    }
+
     QuantumSupercomputer supercomp;
 
     // Add 5 modules (each 100 qubits)
-    for(int i=0;i<5;i++) supercomp.addModule(new QuantumModule(i));
+    for(int i=0;i<5;i++) supercomp.addModule();
 
-    // Calibrate all modules
-    supercomp.calibrateAll();
+    // A 20-qubit statevector module for checking circuits without hardware
+    supercomp.addModule(std::make_unique<StatevectorBackend>(20));
+
+    // Calibrate all modules concurrently, reusing last hour's snapshots
+    auto reports = supercomp.calibrateFromSnapshots("qc_calibration_module", std::chrono::hours(1), 8, [](int m, int done, int total) {
+        if(done == total) std::cout << "Module " << m << " calibrated" << std::endl;
+    });
+    for(auto &r: reports)
+        std::cout << "Module " << r.module << ": " << r.wall_ms << " ms, " << r.reused << " reused (slowest qubit " << r.slowestQubitMs() << " ms)" << std::endl;
 
     // Apply H gate to qubit 0 on module 0
     supercomp.applyGate(0,"H",0);
@@ -122,7 +699,117 @@ int main() {
     // Apply CNOT between qubit 0 on module 0 and qubit 0 on module 1
     supercomp.applyTwoQubitGate(0,0,1,0,"CNOT");
 
+    // Entangle qubit i of modules 0..3 with the same qubit of the next module
+    // while every module runs its own H layer: 4 links open concurrently, each
+    // carrying its 3 gates in one window
+    DistributedCircuit chain;
+    for(int m=0;m<5;m++) for(int q=0;q<3;q++) chain.gate(GateOp::H, m, q);
+    for(int m=0;m<4;m++) for(int q=0;q<3;q++) chain.gate(GateOp::CNOT, m, q, m+1, q+10);
+    DistributedSchedule chain_sched = supercomp.schedule(chain);
+    supercomp.run(chain_sched);
+    std::cout << "Distributed: " << chain_sched.local_gates << " local, " << chain_sched.remote_gates << " remote gates in "
+              << chain_sched.stages.size() << " stages, " << chain_sched.link_windows << " link windows" << std::endl;
+
+    // Four 50-qubit rings scattered over 200 logical qubits (ring r visits
+    // qubits 97*k mod 200 for k in [50r, 50r+50)): in index order most gates
+    // cross a module, placement packs two whole rings per module
+    CircuitIR rings;
+    for(int r=0;r<4;r++) for(int i=0;i<50;i++) rings.cnot((97*(50*r+i)) % 200, (97*(50*r+(i+1)%50)) % 200);
+    std::shared_ptr<const PlacedCircuit> placed = supercomp.prepare(rings);
+    std::cout << "Placement: " << placed->placement.naive_cut << " inter-module gates in index order, " << placed->placement.cut
+              << " after placement (" << placed->schedule.remote_gates << " scheduled)" << std::endl;
+    supercomp.prepare(rings); // resubmission: served from the cache
+    std::cout << "Placement cache: " << supercomp.placementCacheStats().hits << " hit" << std::endl;
+
+    // QAOA-style sweep over two angles on a 4-qubit line: placed once, then
+    // rebound per (gamma, beta) point
+    CircuitIR qaoa;
+    for(int q=0;q<4;q++) qaoa.h(q);
+    for(int q=0;q<3;q++) qaoa.cphase(q, q+1, Param{0});
+    for(int q=0;q<4;q++) qaoa.rx(q, Param{1});
+    supercomp.sweep(qaoa, {{0.1, 0.2}, {0.3, 0.4}});
+    std::cout << "QAOA sweep: 2 points, placement cache " << supercomp.placementCacheStats().hits << " hits" << std::endl;
+
+    // Replay a compiled GHZ preparation on module 2
+    CircuitIR ghz;
+    ghz.h(0); ghz.cnot(0,1); ghz.cnot(1,2);
+    CompiledCircuit ghz_program = compile(ghz);
+    supercomp.run(ghz_program, 2);
+
+    // Independent work on all five hardware modules runs side by side
+    auto t0 = std::chrono::steady_clock::now();
+    for(int m=0;m<5;m++) supercomp.submit(ghz_program, m);
+    supercomp.sync();
+    auto fanout_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << "GHZ on 5 modules concurrently: " << fanout_ms << " ms" << std::endl;
+
+    // Module 4 is a 10x10 grid chip: qubit 0 of this fan-out talks to five
+    // others, one more than a grid qubit has couplers, so routing adds SWAPs
+    supercomp.setCouplingMap(4, std::make_shared<CouplingMap>(CouplingMap::grid(10, 10)));
+    CircuitIR fanout;
+    fanout.h(0);
+    for(int q=1;q<=5;q++) fanout.cnot(0, q);
+    OptimizationReport routed;
+    supercomp.run(supercomp.compileFor(fanout, 4, {}, &routed), 4);
+    std::cout << "Grid-routed fan-out on module 4: " << routed.swaps_inserted << " SWAP(s)" << std::endl;
+
+    // ...and on the simulated module, where all three qubits read out equal
+    supercomp.run(ghz_program, 5);
+    ShotBuffer ghz_shot = supercomp.measureLogicalBatch(5, {{0},{1},{2}});
+    std::cout << "Simulated GHZ -> " << ghz_shot.get(0,0) << ghz_shot.get(0,1) << ghz_shot.get(0,2) << std::endl;
+
     // Measure logical qubit on module 0
     auto res = supercomp.measureLogical(0,{0,1,2},10);
     std::cout << "Logical measurement results: 0=" << res["0"] << " 1=" << res["1"] << std::endl;
+
+    // The same machine on global qubit indices (module m's qubit q is 100*m + q
+    // for the hardware modules): a CNOT across the module 0/1 boundary, a
+    // logical read on module 2, and a health scan after one qubit's
+    // characterization came back with a high gate error
+    supercomp.applyTwoQubitGate(99, 100, "CNOT");
+    auto global_res = supercomp.measureLogical({200,201,202}, 10);
+    supercomp.recordCharacterization(250, 80.0f, 60.0f, 0.02f, 0.01f);
+    std::vector<int> due = supercomp.healthScan(std::chrono::hours(1), 0.01f);
+    QubitRef q250 = supercomp.locate(250);
+    std::cout << "Global qubits: " << supercomp.numQubits() << " (qubit 250 is module " << q250.module << " qubit " << q250.qubit
+              << "), logical 0=" << global_res["0"] << " 1=" << global_res["1"] << ", " << due.size() << " due for recalibration" << std::endl;
+
+#ifndef _WIN32
+    // Two more modules behind module agents, the way a lab runs them on the
+    // hosts next to their electronics (here on loopback, the second with its
+    // clock 2.5 s ahead). Pulses stream to the agents in batches, and the link
+    // windows of a GHZ chain 0 -> 6 -> 7 open at one agreed instant on both
+    // ends' clocks (agents need POSIX sockets, see rpc.hpp)
+    rpc::AgentOptions ahead;
+    ahead.clock_offset_ns = 2500000000;
+    rpc::ModuleAgent agent6(std::make_unique<HardwareBackend>(6, 100)), agent7(std::make_unique<HardwareBackend>(7, 100), 0, ahead);
+    agent6.start();
+    agent7.start();
+    supercomp.addRemoteModule("127.0.0.1", agent6.port());
+    QuantumModule &m7 = supercomp.addRemoteModule("127.0.0.1", agent7.port());
+    supercomp.calibrateAll();
+    DistributedCircuit remote_chain;
+    remote_chain.gate(GateOp::H, 0, 0);
+    remote_chain.gate(GateOp::CNOT, 0, 0, 6, 0);
+    remote_chain.gate(GateOp::CNOT, 6, 0, 7, 0);
+    for(int q=1;q<3;q++) remote_chain.gate(GateOp::CNOT, 7, 0, 7, q);
+    auto t1 = std::chrono::steady_clock::now();
+    supercomp.run(remote_chain);
+    auto remote_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t1).count();
+    auto remote_res = supercomp.measureLogical(7, {0,1,2}, 10);
+    LinkSyncStats link_sync = supercomp.linkSyncStats();
+    std::cout << "Remote modules: chain in " << remote_ms << " ms, module 7 clock offset " << m7.remote->clockOffsetNs()/1e6 << " ms (round trip "
+              << m7.remote->roundTripNs()/1e3 << " us), " << link_sync.windows << " timed link windows, max skew " << link_sync.max_skew_ns/1e3
+              << " us; logical 0=" << remote_res["0"] << " 1=" << remote_res["1"] << std::endl;
+#endif
+
+    // Per-module pulse programs from the hardware metrics
+    MetricsSnapshot snap = metrics().snapshot();
+    for(int m=0;m<5;m++){
+        const LatencyHistogram &h = snap.hist[(int)HwOp::PulseProgram][m];
+        std::cout << "Module " << m << " pulse programs: " << h.count << ", mean " << h.meanMs() << " ms, p99 <= " << h.quantileMs(0.99) << " ms" << std::endl;
+    }
+    const LatencyHistogram &links = snap.total(HwOp::LinkWindow);
+    std::cout << "Link windows: " << links.count << ", mean " << links.meanMs() << " ms" << std::endl;
 }
+#endif
@@ -0,0 +1,93 @@
+#pragma once
+#include <vector>
+#include <map>
+#include <string>
+#include <cstdint>
+#include <stdexcept>
+#include "shots.hpp"
+
+// --------------------------
+// Batch Logical Decoding
+// --------------------------
+// A layout lists the physical qubits of each logical qubit, e.g.
+// {{0,1,2},{3,4,5}}. Decoding works on qubit-major shot columns, so one 64-bit
+// word carries the same physical qubit for 64 shots and every decoder step
+// handles 64 shots at once.
+using GroupLayout = std::vector<std::vector<int>>;
+
+class LogicalDecoder {
+public:
+    virtual ~LogicalDecoder() = default;
+    // bits[k] is the column of the k-th qubit of one group (blocks words each);
+    // writes the decoded logical column to out.
+    virtual void decodeGroup(const uint64_t *const *bits, size_t n, size_t blocks, uint64_t *out) const = 0;
+};
+
+// Repetition-code majority vote; a tie (even group) decodes to 0.
+class MajorityDecoder : public LogicalDecoder {
+public:
+    void decodeGroup(const uint64_t *const *bits, size_t n, size_t blocks, uint64_t *out) const override {
+        if(n == 0) throw std::invalid_argument("MajorityDecoder: empty group");
+        if(n == 3){
+            const uint64_t *a = bits[0], *b = bits[1], *c = bits[2];
+            for(size_t w=0;w<blocks;w++) out[w] = (a[w]&b[w]) | (a[w]&c[w]) | (b[w]&c[w]);
+            return;
+        }
+        // Any distance: bit-sliced counters, then a bit-sliced "count > n/2".
+        size_t width = 1;
+        while((size_t(1) << width) <= n) width++;
+        std::vector<uint64_t> count(width);
+        size_t threshold = n/2;
+        for(size_t w=0;w<blocks;w++){
+            std::fill(count.begin(), count.end(), 0);
+            for(size_t k=0;k<n;k++){
+                uint64_t carry = bits[k][w];
+                for(size_t i=0;i<width && carry;i++){
+                    uint64_t t = count[i] & carry;
+                    count[i] ^= carry;
+                    carry = t;
+                }
+            }
+            uint64_t gt = 0, eq = ~0ull;
+            for(size_t i=width;i-- > 0;){
+                if((threshold >> i) & 1) eq &= count[i];
+                else { gt |= eq & count[i]; eq &= ~count[i]; }
+            }
+            out[w] = gt;
+        }
+    }
+};
+
+// Decode every group of every shot. The result has one bit per group
+// (labelled 0..groups-1) per shot.
+inline ShotBuffer decodeLogical(const ShotBuffer &shots, const GroupLayout &groups, const LogicalDecoder &decoder) {
+    std::map<int,size_t> column_of;
+    for(size_t i=0;i<shots.width();i++) column_of.emplace(shots.qubits()[i], i);
+
+    std::vector<std::vector<uint64_t>> cols = shots.columns();
+    size_t blocks = (shots.shots()+63)/64;
+    std::vector<std::vector<uint64_t>> logical(groups.size(), std::vector<uint64_t>(blocks, 0));
+    std::vector<const uint64_t*> ptrs;
+    for(size_t g=0;g<groups.size();g++){
+        ptrs.clear();
+        for(int q: groups[g]){
+            auto it = column_of.find(q);
+            if(it == column_of.end()) throw std::invalid_argument("decodeLogical: qubit " + std::to_string(q) + " was not measured");
+            ptrs.push_back(cols[it->second].data());
+        }
+        decoder.decodeGroup(ptrs.data(), ptrs.size(), blocks, logical[g].data());
+    }
+
+    std::vector<int> labels(groups.size());
+    for(size_t g=0;g<groups.size();g++) labels[g] = (int)g;
+    return ShotBuffer::fromColumns(std::move(labels), logical, shots.shots());
+}
+
+// Distinct physical qubits of a layout, in order of first appearance.
+inline std::vector<int> layoutQubits(const GroupLayout &groups) {
+    std::vector<int> qubits;
+    for(const auto &g: groups)
+        for(int q: g)
+            if(std::find(qubits.begin(), qubits.end(), q) == qubits.end()) qubits.push_back(q);
+    return qubits;
+}
@@ -0,0 +1,160 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <exception>
+#include <cstdint>
+#include "circuit_ir.hpp"
+
+// --------------------------
+// Lock-free SPSC Ring
+// --------------------------
+// Single producer, single consumer, bounded. Head and tail live on their own
+// cache lines; each side caches the other's index and only reloads it when
+// the ring looks full (producer) or empty (consumer).
+template<typename T>
+class SpscQueue {
+private:
+    std::unique_ptr<T[]> ring;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head{0}; // written by the producer
+    size_t tail_cache = 0;
+    alignas(64) std::atomic<size_t> tail{0}; // written by the consumer
+    size_t head_cache = 0;
+
+public:
+    explicit SpscQueue(size_t capacity) {
+        size_t c = 2;
+        while(c < capacity) c <<= 1;
+        ring.reset(new T[c]);
+        mask = c-1;
+    }
+
+    bool tryPush(const T &v) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if(h - tail_cache > mask) {
+            tail_cache = tail.load(std::memory_order_acquire);
+            if(h - tail_cache > mask) return false;
+        }
+        ring[h & mask] = v;
+        head.store(h+1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T &v) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if(t == head_cache) {
+            head_cache = head.load(std::memory_order_acquire);
+            if(t == head_cache) return false;
+        }
+        v = ring[t & mask];
+        tail.store(t+1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const { return tail.load(std::memory_order_acquire) == head.load(std::memory_order_acquire); }
+};
+
+// --------------------------
+// Module Executor
+// --------------------------
+// One dedicated thread per module draining an SPSC queue of commands, so the
+// supercomputer can hand work to every module at once and only block where a
+// result is needed (drain). Commands are PODs: a single gate, or a fragment of
+// an instruction stream the caller keeps alive until the next drain. The
+// producer side (submit/drain) must stay on one thread. `on_idle` runs on the
+// worker whenever a command leaves the queue empty, before the command
+// counts as done (a remote module flushes its batched pulses there).
+class ModuleExecutor {
+public:
+    using Apply = std::function<void(const Instruction&)>;
+
+private:
+    struct Command {
+        Instruction gate;          // used when first == nullptr
+        const Instruction *first;
+        size_t count;
+    };
+
+    Apply apply;
+    std::function<void()> on_idle;
+    SpscQueue<Command> queue;
+    uint64_t submitted = 0;                 // producer only
+    alignas(64) std::atomic<uint64_t> completed{0};
+    std::atomic<bool> sleeping{false};      // worker parked on `wake`
+    std::atomic<bool> waiting{false};       // producer parked on `done`
+    std::atomic<bool> stopping{false};
+    std::exception_ptr error;               // first failure, read after drain
+    std::mutex mtx;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::thread worker;
+
+    void run() {
+        Command c;
+        for(;;){
+            int idle = 0;
+            while(!queue.tryPop(c)){
+                if(stopping.load(std::memory_order_acquire) && queue.empty()) return;
+                if(++idle < 64) { std::this_thread::yield(); continue; }
+                std::unique_lock<std::mutex> lock(mtx);
+                sleeping.store(true);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                wake.wait(lock, [this]() { return !queue.empty() || stopping.load(); });
+                sleeping.store(false);
+                idle = 0;
+            }
+            if(!error){
+                try {
+                    if(!c.first) apply(c.gate);
+                    else for(size_t i=0;i<c.count;i++) apply(c.first[i]);
+                    if(on_idle && queue.empty()) on_idle();
+                } catch(...) { error = std::current_exception(); }
+            }
+            completed.fetch_add(1, std::memory_order_seq_cst);
+            if(waiting.load()) { std::lock_guard<std::mutex> guard(mtx); done.notify_one(); }
+        }
+    }
+
+    void push(const Command &c) {
+        while(!queue.tryPush(c)) std::this_thread::yield();
+        submitted++;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(sleeping.load()) { std::lock_guard<std::mutex> guard(mtx); wake.notify_one(); }
+    }
+
+public:
+    explicit ModuleExecutor(Apply fn, size_t capacity=1024, std::function<void()> idle_fn={})
+        : apply(std::move(fn)), on_idle(std::move(idle_fn)), queue(capacity) {
+        worker = std::thread([this]() { run(); });
+    }
+
+    ~ModuleExecutor() {
+        { std::lock_guard<std::mutex> guard(mtx); stopping = true; }
+        wake.notify_one();
+        worker.join();
+    }
+
+    void submit(const Instruction &in) { push(Command{in, nullptr, 0}); }
+    void submit(const Instruction *first, size_t count) { if(count) push(Command{{}, first, count}); }
+
+    bool idle() const { return completed.load(std::memory_order_acquire) == submitted; }
+
+    // Block until every submitted command has run; rethrows the first failure
+    // (later commands are skipped once one fails).
+    void drain() {
+        for(int spin=0;!idle() && spin<64;spin++) std::this_thread::yield();
+        if(!idle()){
+            std::unique_lock<std::mutex> lock(mtx);
+            waiting.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            done.wait(lock, [this]() { return idle(); });
+            waiting.store(false);
+        }
+        if(error) { std::exception_ptr e = error; error = nullptr; std::rethrow_exception(e); }
+    }
+};
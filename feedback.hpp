@@ -0,0 +1,68 @@
+#pragma once
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include "circuit_ir.hpp"
+#include "metrics.hpp"
+
+// --------------------------
+// Classical Register
+// --------------------------
+// Classical bits of the run in progress. Mid-circuit readouts are written
+// here and conditional gates test them in place, one byte per bit, so the
+// path from readState to the dependent pulse is a store, a compare and
+// nothing else: no log entry, no map, no allocation once it is sized.
+//
+// Every bit also keeps the time it was read out. When a conditional gate is
+// decided, the gap since the last readout it depends on is recorded as
+// HwOp::Feedback (per module, like hardware calls), so feedback
+// latency shows up next to pulse and readout latency in the metrics.
+//
+// Bits are written by the gates that own them; a moment never writes a bit
+// that another gate of the same moment tests, so parallel dispatch is safe.
+class ClassicalRegister {
+private:
+    std::vector<uint8_t> bits;
+    std::vector<int64_t> read_ns; // steady clock at the bit's last readout
+
+    static int64_t now() { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+public:
+    // Clear for a new run of `n` bits; reuses the storage.
+    void reset(int n) { bits.assign(n, 0); read_ns.assign(n, 0); }
+    // Grow to `n` bits keeping the values (streamed programs).
+    void reserveBits(int n) { if(n > size()) { bits.resize(n, 0); read_ns.resize(n, 0); } }
+
+    void write(int bit, int value) {
+        bits[bit] = (uint8_t)value;
+        read_ns[bit] = now();
+    }
+
+    // Whether conditional gate `in` fires; records the feedback latency.
+    bool test(const Instruction &in, int module) {
+        bool fire = conditionHolds(in, bits.data());
+        if(metrics().isEnabled()){
+            int64_t settled = 0;
+            for(int i=0;i<in.cwidth;i++) settled = std::max(settled, read_ns[in.cbit + i]);
+            if(settled) metrics().record(HwOp::Feedback, module, in.q0, (uint64_t)(now() - settled));
+        }
+        return fire;
+    }
+
+    int size() const { return (int)bits.size(); }
+    int get(int bit) const { return bits[bit]; }
+    const uint8_t *data() const { return bits.data(); }
+};
+
+// Run `in` through the register: MEASURE reads into its bit, a conditional
+// gate goes to `pulse` unconditioned if it fires. Shared by the single
+// machine and the supercomputer's modules.
+template<typename ReadState, typename Pulse>
+inline void applyClassical(ClassicalRegister &creg, const Instruction &in, int module, ReadState &&read, Pulse &&pulse) {
+    if(in.op == GateOp::MEASURE) { creg.write(in.cbit, read(in.q0)); return; }
+    if(!creg.test(in, module)) return;
+    Instruction gate = in;
+    gate.cwidth = 0;
+    pulse(gate);
+}
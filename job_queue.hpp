@@ -0,0 +1,207 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <memory>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include "circuit_ir.hpp"
+#include "shots.hpp"
+#include "metrics.hpp"
+
+// --------------------------
+// Job Queue
+// --------------------------
+// Single front door for a shared machine. Submitters hand over a compiled
+// circuit, the qubits to read and a shot count; one dispatcher thread owns the
+// machine and runs jobs one at a time, so gates from different users never
+// interleave and calibration only happens between jobs.
+//
+// Order: higher priority first, FIFO within a priority. When a job is picked,
+// every job of the same circuit object and readout queued ahead of the next
+// maintenance task is folded into the same run: the circuit is prepared once
+// and the summed shots are sampled in one go, then split back per job. Jobs
+// behind a maintenance task wait for it.
+struct JobResult {
+    uint64_t id = 0;
+    ShotBuffer shots;
+    double queue_ms = 0;    // submitted -> started
+    double latency_ms = 0;  // submitted -> finished
+    size_t batch_size = 1;  // jobs that shared the run
+};
+
+struct JobQueueStats {
+    uint64_t submitted = 0, completed = 0, failed = 0;
+    uint64_t runs = 0;        // machine runs; completed - runs jobs were batched away
+    uint64_t shots = 0;
+    size_t queued = 0;        // waiting right now
+    double mean_queue_ms = 0, max_queue_ms = 0;
+    double mean_latency_ms = 0, max_latency_ms = 0;
+};
+
+class JobQueue {
+public:
+    // Prepare `circuit` from |0>, then sample `shots` shots of `qubits`.
+    using Runner = std::function<ShotBuffer(const CompiledCircuit &circuit, const std::vector<int> &qubits, int shots)>;
+    using Clock = std::chrono::steady_clock;
+
+private:
+    struct Job {
+        uint64_t id;
+        int priority;
+        std::shared_ptr<const CompiledCircuit> circuit; // null for maintenance tasks
+        std::vector<int> qubits;
+        int shots;
+        std::function<void()> task;
+        Clock::time_point submitted;
+        std::promise<JobResult> result;
+    };
+
+    Runner runner;
+    std::deque<Job> queue;   // kept sorted: priority desc, id asc
+    uint64_t next_id = 1;
+    JobQueueStats counters;
+    double queue_ms_sum = 0, latency_ms_sum = 0;
+    bool stopping = false;
+    std::mutex mtx;
+    std::condition_variable wake;
+    std::thread dispatcher;
+
+    static double ms(Clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); }
+
+    void enqueue(Job job) {
+        std::lock_guard<std::mutex> guard(mtx);
+        if(stopping) throw std::logic_error("JobQueue: submit after shutdown");
+        job.id = next_id++;
+        job.submitted = Clock::now();
+        auto at = std::find_if(queue.begin(), queue.end(), [&](const Job &j) { return j.priority < job.priority; });
+        queue.insert(at, std::move(job));
+        counters.submitted++;
+        wake.notify_one();
+    }
+
+    // Pop the head job plus every queued job that can share its run.
+    std::vector<Job> takeBatch() {
+        std::vector<Job> batch;
+        batch.push_back(std::move(queue.front()));
+        queue.pop_front();
+        const Job &head = batch.front();
+        if(!head.circuit) return batch;
+        for(auto it=queue.begin();it!=queue.end() && it->circuit;){
+            if(it->circuit == head.circuit && it->qubits == head.qubits) { batch.push_back(std::move(*it)); it = queue.erase(it); }
+            else ++it;
+        }
+        return batch;
+    }
+
+    void finish(Job &job, JobResult &r, Clock::time_point started, Clock::time_point done) {
+        r.id = job.id;
+        r.queue_ms = ms(started - job.submitted);
+        r.latency_ms = ms(done - job.submitted);
+        if(metrics().isEnabled()) metrics().record(HwOp::QueueWait, 0, -1, (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(started - job.submitted).count());
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            counters.completed++;
+            queue_ms_sum += r.queue_ms;
+            latency_ms_sum += r.latency_ms;
+            counters.max_queue_ms = std::max(counters.max_queue_ms, r.queue_ms);
+            counters.max_latency_ms = std::max(counters.max_latency_ms, r.latency_ms);
+        }
+        job.result.set_value(std::move(r));
+    }
+
+    void fail(std::vector<Job> &batch, std::exception_ptr e) {
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            counters.failed += batch.size();
+        }
+        for(Job &j: batch) j.result.set_exception(e);
+    }
+
+    void execute(std::vector<Job> &batch) {
+        Clock::time_point started = Clock::now();
+        if(!batch[0].circuit) {
+            try { batch[0].task(); }
+            catch(...) { fail(batch, std::current_exception()); return; }
+            JobResult r;
+            finish(batch[0], r, started, Clock::now());
+            return;
+        }
+        int total = 0;
+        for(const Job &j: batch) total += j.shots;
+        ShotBuffer all;
+        try { all = runner(*batch[0].circuit, batch[0].qubits, total); }
+        catch(...) { fail(batch, std::current_exception()); return; }
+        Clock::time_point done = Clock::now();
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            counters.runs++;
+            counters.shots += total;
+        }
+        size_t first = 0;
+        for(Job &j: batch){
+            JobResult r;
+            r.shots = all.rows(first, j.shots);
+            r.batch_size = batch.size();
+            first += j.shots;
+            finish(j, r, started, done);
+        }
+    }
+
+    void run() {
+        for(;;){
+            std::vector<Job> batch;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                wake.wait(lock, [this]() { return stopping || !queue.empty(); });
+                if(queue.empty()) return;
+                batch = takeBatch();
+            }
+            execute(batch);
+        }
+    }
+
+public:
+    explicit JobQueue(Runner r) : runner(std::move(r)) {
+        dispatcher = std::thread([this]() { run(); });
+    }
+
+    // Finishes every queued job before returning.
+    ~JobQueue() {
+        { std::lock_guard<std::mutex> guard(mtx); stopping = true; }
+        wake.notify_one();
+        dispatcher.join();
+    }
+
+    // Jobs sharing one circuit should share the pointer, so they can batch.
+    std::future<JobResult> submit(std::shared_ptr<const CompiledCircuit> circuit, std::vector<int> qubits, int shots, int priority=0) {
+        if(!circuit) throw std::invalid_argument("JobQueue: null circuit");
+        if(shots < 1) throw std::invalid_argument("JobQueue: shots must be positive");
+        Job job{0, priority, std::move(circuit), std::move(qubits), shots, {}, {}, {}};
+        std::future<JobResult> f = job.result.get_future();
+        enqueue(std::move(job));
+        return f;
+    }
+
+    // Exclusive access to the machine between jobs (e.g. recalibration).
+    std::future<JobResult> submitMaintenance(std::function<void()> task, int priority=1000) {
+        Job job{0, priority, nullptr, {}, 0, std::move(task), {}, {}};
+        std::future<JobResult> f = job.result.get_future();
+        enqueue(std::move(job));
+        return f;
+    }
+
+    JobQueueStats stats() {
+        std::lock_guard<std::mutex> guard(mtx);
+        JobQueueStats s = counters;
+        s.queued = queue.size();
+        if(s.completed) { s.mean_queue_ms = queue_ms_sum / s.completed; s.mean_latency_ms = latency_ms_sum / s.completed; }
+        return s;
+    }
+};
@@ -0,0 +1,149 @@
+#pragma once
+#include <vector>
+#include <map>
+#include <utility>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+#include "circuit_ir.hpp"
+
+// --------------------------
+// Link-Aware Distributed Scheduler
+// --------------------------
+// A multi-module program addresses qubits as (module, qubit). Gates inside one
+// module use the module's own control lines; gates across modules need the
+// inter-module link for that module pair, which is slow and opened in windows
+// that carry several gates at once.
+//
+// Gates are levelled ASAP on per-qubit dependencies exactly like
+// assignMoments. Each level becomes a stage: every module's local gates and
+// every link's remote gates of the stage touch disjoint qubits, so they are
+// issued concurrently. Remote gates of one link in one stage share link
+// windows (up to `window` gates each), so a link is opened once per stage
+// instead of once per gate while the other modules keep working.
+struct QubitRef {
+    int32_t module;
+    int32_t qubit;
+};
+
+struct GlobalInstruction {
+    GateOp op;
+    QubitRef a;
+    QubitRef b; // second operand of two-qubit ops, {-1,-1} otherwise
+    double params[3];
+    int32_t param = -1; // symbolic slot feeding params[0], as in Instruction
+
+    bool remote() const { return isTwoQubit(op) && a.module != b.module; }
+};
+
+// Records a program over several modules.
+class DistributedCircuit {
+private:
+    std::vector<GlobalInstruction> instrs;
+
+public:
+    void append(const GlobalInstruction &in) {
+        if(isTwoQubit(in.op) && in.a.module == in.b.module && in.a.qubit == in.b.qubit) throw std::invalid_argument("DistributedCircuit: two-qubit gate on one qubit");
+        instrs.push_back(in);
+    }
+    void gate(GateOp op, int module, int q) {
+        if(isTwoQubit(op)) throw std::invalid_argument("DistributedCircuit: two-qubit op needs two operands");
+        append({op, {module, q}, {-1, -1}, {}});
+    }
+    void gate(GateOp op, int module1, int q1, int module2, int q2) {
+        if(!isTwoQubit(op)) throw std::invalid_argument("DistributedCircuit: single-qubit op given two operands");
+        append({op, {module1, q1}, {module2, q2}, {}});
+    }
+
+    const std::vector<GlobalInstruction> &instructions() const { return instrs; }
+    size_t size() const { return instrs.size(); }
+};
+
+struct LinkOptions {
+    size_t window = 8; // max remote gates carried by one link window
+};
+
+// Remote gates of one module pair, module1 < module2, in one stage.
+struct LinkBatch {
+    int module1, module2;
+    std::vector<GlobalInstruction> gates;
+};
+
+struct DistributedStage {
+    std::vector<std::pair<int, std::vector<Instruction>>> local; // (module, gates on disjoint qubits)
+    std::vector<LinkBatch> links;
+};
+
+struct DistributedSchedule {
+    std::vector<DistributedStage> stages;
+    size_t local_gates = 0;
+    size_t remote_gates = 0;
+    size_t link_windows = 0;
+    size_t window = 8;
+
+    // Patch symbolic angles in place, as CompiledCircuit::bind does.
+    void bind(const std::vector<double> &values) {
+        auto patch = [&](int32_t slot, double &angle) {
+            if(slot < 0) return;
+            if(slot >= (int32_t)values.size()) throw std::invalid_argument("DistributedSchedule::bind: no value for parameter " + std::to_string(slot));
+            angle = values[slot];
+        };
+        for(DistributedStage &st: stages){
+            for(auto &l: st.local) for(Instruction &in: l.second) patch(in.param, in.params[0]);
+            for(LinkBatch &b: st.links) for(GlobalInstruction &g: b.gates) patch(g.param, g.params[0]);
+        }
+    }
+};
+
+inline DistributedSchedule scheduleDistributed(const DistributedCircuit &circuit, const std::vector<int> &module_width, const LinkOptions &opts = {}) {
+    if(opts.window == 0) throw std::invalid_argument("scheduleDistributed: link window must carry at least one gate");
+    std::vector<size_t> base(module_width.size()+1, 0);
+    for(size_t m=0;m<module_width.size();m++) base[m+1] = base[m] + module_width[m];
+    auto slot = [&](QubitRef r) {
+        if(r.module < 0 || r.module >= (int)module_width.size() || r.qubit < 0 || r.qubit >= module_width[r.module])
+            throw std::out_of_range("scheduleDistributed: qubit " + std::to_string(r.qubit) + " of module " + std::to_string(r.module) + " out of range");
+        return base[r.module] + r.qubit;
+    };
+
+    const std::vector<GlobalInstruction> &instrs = circuit.instructions();
+    std::vector<uint32_t> frontier(base.back(), 0), level(instrs.size());
+    uint32_t depth = 0;
+    for(size_t i=0;i<instrs.size();i++){
+        const GlobalInstruction &in = instrs[i];
+        size_t a = slot(in.a);
+        uint32_t l = frontier[a];
+        if(isTwoQubit(in.op)) {
+            size_t b = slot(in.b);
+            l = std::max(l, frontier[b]);
+            frontier[b] = l+1;
+        }
+        frontier[a] = l+1;
+        level[i] = l;
+        depth = std::max(depth, l+1);
+    }
+
+    DistributedSchedule sched;
+    sched.window = opts.window;
+    sched.stages.resize(depth);
+    std::vector<std::map<int, std::vector<Instruction>>> local(depth);
+    std::vector<std::map<std::pair<int,int>, std::vector<GlobalInstruction>>> remote(depth);
+    for(size_t i=0;i<instrs.size();i++){
+        const GlobalInstruction &in = instrs[i];
+        if(in.remote()) {
+            remote[level[i]][{std::min(in.a.module, in.b.module), std::max(in.a.module, in.b.module)}].push_back(in);
+            sched.remote_gates++;
+        } else {
+            local[level[i]][in.a.module].push_back(Instruction{in.op, in.a.qubit, isTwoQubit(in.op) ? in.b.qubit : -1, {in.params[0], in.params[1], in.params[2]}, in.param});
+            sched.local_gates++;
+        }
+    }
+    for(uint32_t l=0;l<depth;l++){
+        DistributedStage &stage = sched.stages[l];
+        for(auto &[m, gates]: local[l]) stage.local.emplace_back(m, std::move(gates));
+        for(auto &[link, gates]: remote[l]){
+            sched.link_windows += (gates.size() + opts.window - 1) / opts.window;
+            stage.links.push_back({link.first, link.second, std::move(gates)});
+        }
+    }
+    return sched;
+}
@@ -0,0 +1,258 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <cstdint>
+#include <charconv>
+
+// --------------------------
+// Asynchronous JSON-lines Logger
+// --------------------------
+// Producers push fixed-size events into a bounded lock-free MPSC ring; one
+// writer thread keeps the log file open, encodes events straight to JSON text
+// and writes them out in batches. Nothing on the gate path touches the file or
+// builds a json tree.
+
+struct LogEvent {
+    enum Kind : uint8_t { Calibrate, Gate, TwoQubitGate, Raw, Blob };
+    Kind kind;
+    char gate[15];
+    int32_t qubits[2];
+    std::string *raw; // preformatted line (Raw) or bytes (Blob), owned by the event
+};
+
+struct LoggerOptions {
+    // What a producer does when the ring is full.
+    enum Overflow { Block, DropNewest };
+
+    size_t capacity = 1 << 14;                   // events, rounded up to a power of two
+    size_t batch_bytes = 64 * 1024;              // write once this much text is pending
+    std::chrono::milliseconds flush_interval{50}; // ...or once this much time has passed
+    Overflow overflow = Block;
+};
+
+class AsyncLogger {
+private:
+    struct alignas(64) Slot {
+        std::atomic<size_t> seq;
+        LogEvent ev;
+    };
+
+    LoggerOptions opts;
+    std::unique_ptr<Slot[]> ring;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head{0}; // next ticket handed to a producer
+    alignas(64) size_t tail = 0;             // next slot the writer consumes
+    std::atomic<uint64_t> consumed{0};
+    std::atomic<uint64_t> dropped_events{0};
+
+    std::ofstream file;
+    std::thread writer;
+    std::mutex mtx;
+    std::condition_variable wake;      // writer sleeps here between batches
+    std::condition_variable drained;   // flush() waits here
+    uint64_t flushed_upto = 0;         // guarded by mtx
+    bool flush_requested = false;      // guarded by mtx
+    bool stopping = false;             // guarded by mtx
+
+    static size_t roundUp(size_t n) {
+        size_t c = 2;
+        while(c < n) c <<= 1;
+        return c;
+    }
+
+    static void appendInt(std::string &out, long long v) {
+        char buf[24];
+        auto r = std::to_chars(buf, buf+sizeof(buf), v);
+        out.append(buf, r.ptr);
+    }
+
+    static void appendString(std::string &out, const char *s) {
+        out += '"';
+        for(; *s; s++){
+            char c = *s;
+            if(c == '"' || c == '\\') { out += '\\'; out += c; }
+            else if((unsigned char)c < 0x20) { out += "\\u00"; out += "0123456789abcdef"[(c>>4)&0xf]; out += "0123456789abcdef"[c&0xf]; }
+            else out += c;
+        }
+        out += '"';
+    }
+
+    // Matches the key order json::dump() produced for the same entries.
+    static void encode(std::string &out, const LogEvent &ev) {
+        switch(ev.kind){
+        case LogEvent::Calibrate:
+            out += "{\"action\":\"calibrate\",\"qubit\":";
+            appendInt(out, ev.qubits[0]);
+            out += "}\n";
+            break;
+        case LogEvent::Gate:
+            out += "{\"action\":\"gate\",\"gate\":";
+            appendString(out, ev.gate);
+            out += ",\"qubits\":[";
+            appendInt(out, ev.qubits[0]);
+            out += "]}\n";
+            break;
+        case LogEvent::TwoQubitGate:
+            out += "{\"action\":\"two_qubit_gate\",\"gate\":";
+            appendString(out, ev.gate);
+            out += ",\"qubits\":[";
+            appendInt(out, ev.qubits[0]);
+            out += ',';
+            appendInt(out, ev.qubits[1]);
+            out += "]}\n";
+            break;
+        case LogEvent::Raw:
+            out += *ev.raw;
+            out += '\n';
+            delete ev.raw;
+            break;
+        case LogEvent::Blob:
+            out += *ev.raw;
+            delete ev.raw;
+            break;
+        }
+    }
+
+    bool tryPush(const LogEvent &ev) {
+        size_t pos = head.load(std::memory_order_relaxed);
+        for(;;){
+            Slot &slot = ring[pos & mask];
+            size_t seq = slot.seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if(diff == 0){
+                if(head.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed)){
+                    slot.ev = ev;
+                    slot.seq.store(pos+1, std::memory_order_release);
+                    return true;
+                }
+            } else if(diff < 0) {
+                return false; // full
+            } else {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void push(const LogEvent &ev) {
+        if(tryPush(ev)) return;
+        if(opts.overflow == LoggerOptions::DropNewest){
+            if(ev.raw) delete ev.raw;
+            dropped_events++;
+            return;
+        }
+        wake.notify_one();
+        while(!tryPush(ev)) std::this_thread::yield();
+    }
+
+    bool pop(LogEvent &ev) {
+        Slot &slot = ring[tail & mask];
+        if(slot.seq.load(std::memory_order_acquire) != tail+1) return false;
+        ev = slot.ev;
+        slot.seq.store(tail+mask+1, std::memory_order_release);
+        tail++;
+        return true;
+    }
+
+    void run() {
+        std::string batch;
+        batch.reserve(opts.batch_bytes * 2);
+        auto last_write = std::chrono::steady_clock::now();
+        LogEvent ev;
+        for(;;){
+            uint64_t n = 0;
+            while(batch.size() < opts.batch_bytes && pop(ev)) { encode(batch, ev); n++; }
+
+            bool stop, want_flush;
+            {
+                std::lock_guard<std::mutex> guard(mtx);
+                stop = stopping;
+                want_flush = flush_requested;
+            }
+            auto now = std::chrono::steady_clock::now();
+            bool due = batch.size() >= opts.batch_bytes || now - last_write >= opts.flush_interval;
+            if((due || want_flush || stop) && !batch.empty()){
+                file.write(batch.data(), batch.size());
+                file.flush();
+                batch.clear();
+                last_write = now;
+            }
+            consumed += n;
+            if(n > 0) continue;
+
+            std::unique_lock<std::mutex> lock(mtx);
+            if(batch.empty()) { flushed_upto = consumed; flush_requested = false; drained.notify_all(); }
+            if(stopping && batch.empty()) return;
+            wake.wait_for(lock, opts.flush_interval);
+        }
+    }
+
+public:
+    explicit AsyncLogger(const std::string &path, LoggerOptions o = {})
+        : opts(o), mask(roundUp(o.capacity)-1), file(path, std::ios::app | std::ios::binary) {
+        ring.reset(new Slot[mask+1]);
+        for(size_t i=0;i<=mask;i++) ring[i].seq.store(i, std::memory_order_relaxed);
+        writer = std::thread([this]() { run(); });
+    }
+
+    // Drains everything queued so far and closes the file.
+    ~AsyncLogger() {
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            stopping = true;
+        }
+        wake.notify_one();
+        writer.join();
+    }
+
+    AsyncLogger(const AsyncLogger&) = delete;
+    AsyncLogger &operator=(const AsyncLogger&) = delete;
+
+    void calibrate(int q) {
+        LogEvent ev{LogEvent::Calibrate, {}, {q, 0}, nullptr};
+        push(ev);
+    }
+
+    void gate(std::string_view name, int q) {
+        LogEvent ev{LogEvent::Gate, {}, {q, 0}, nullptr};
+        name.copy(ev.gate, sizeof(ev.gate)-1);
+        push(ev);
+    }
+
+    void twoQubitGate(std::string_view name, int q1, int q2) {
+        LogEvent ev{LogEvent::TwoQubitGate, {}, {q1, q2}, nullptr};
+        name.copy(ev.gate, sizeof(ev.gate)-1);
+        push(ev);
+    }
+
+    // Cold-path entries (measurement summaries) arrive already serialized.
+    void raw(std::string line) {
+        LogEvent ev{LogEvent::Raw, {}, {0, 0}, new std::string(std::move(line))};
+        push(ev);
+    }
+
+    // Opaque bytes written as-is, e.g. binary result records. A blob is never
+    // split, so a dropped one (DropNewest) leaves the file well-formed.
+    void blob(std::string bytes) {
+        LogEvent ev{LogEvent::Blob, {}, {0, 0}, new std::string(std::move(bytes))};
+        push(ev);
+    }
+
+    // Block until everything logged before this call is on disk.
+    void flush() {
+        uint64_t target = head.load();
+        std::unique_lock<std::mutex> lock(mtx);
+        flush_requested = true;
+        wake.notify_one();
+        drained.wait(lock, [&]{ return flushed_upto >= target; });
+    }
+
+    uint64_t dropped() const { return dropped_events.load(); }
+};
@@ -0,0 +1,355 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <cstdlib>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+// --------------------------
+// Hardware Metrics
+// --------------------------
+// Latency histograms and counters for every hardware call. Each thread writes
+// to its own shard (plain relaxed stores, no read-modify-write, no locks), and
+// exporters sum the shards on demand. Shards of finished threads go back on a
+// free list and are handed to the next thread, so short-lived calibration
+// lines don't grow the registry and nothing recorded is lost.
+//
+// Histograms are kept per (operation, module); counts and total time are also
+// kept per qubit. Buckets are fixed powers of two from 1 us to ~8 s.
+// Feedback is not a call but the gap from a mid-circuit readout to the
+// conditional gate that depends on it (see feedback.hpp); Decode the gap from
+// a syndrome round's readout to the QEC decoder having taken it (qec.hpp).
+// PulseProgram is one upload and play of a batched pulse program (pulse.hpp).
+enum class HwOp : uint8_t { Calibrate, HealthCheck, Pulse, TwoQubitPulse, ReadState, LinkWindow, QueueWait, Feedback, Decode, PulseProgram, Count };
+
+inline const char *hwOpName(HwOp op) {
+    static const char *names[] = {"calibrate", "health_check", "pulse", "two_qubit_pulse", "read_state", "link_window", "queue_wait", "feedback", "decode", "pulse_program"};
+    return names[(int)op];
+}
+
+namespace metrics_detail {
+    constexpr int kOps = (int)HwOp::Count;
+    constexpr int kQubitOps = (int)HwOp::ReadState + 1; // ops that act on a qubit
+    constexpr int kBuckets = 24;                          // le = 2^i us, plus +Inf
+    constexpr int kMaxModules = 32;
+    constexpr int kBlockQubits = 128;
+    constexpr int kBlocks = 8;                            // up to 1024 qubits per module
+
+    inline int bucketOf(uint64_t ns) {
+        uint64_t us = ns / 1000;
+        int b = 0;
+        while(us && b < kBuckets) { us >>= 1; b++; }
+        return b; // kBuckets == overflow
+    }
+
+    // Single writer: a load + store is enough and avoids a locked add.
+    inline void bump(std::atomic<uint64_t> &a, uint64_t v) { a.store(a.load(std::memory_order_relaxed) + v, std::memory_order_relaxed); }
+
+    struct Histogram {
+        std::atomic<uint64_t> buckets[kBuckets+1] = {};
+        std::atomic<uint64_t> count{0}, sum_ns{0};
+    };
+
+    struct QubitBlock {
+        std::atomic<uint64_t> count[kQubitOps][kBlockQubits] = {};
+        std::atomic<uint64_t> sum_ns[kQubitOps][kBlockQubits] = {};
+    };
+
+    struct Shard {
+        Histogram hist[kOps][kMaxModules];
+        std::atomic<QubitBlock*> blocks[kMaxModules][kBlocks] = {}; // allocated by the owner on first use
+        std::atomic<uint64_t> dropped{0};                            // module/qubit out of range
+
+        ~Shard() { for(auto &m: blocks) for(auto &b: m) delete b.load(); }
+
+        void recordQubit(int op, int module, int q, uint64_t ns) {
+            if(op >= kQubitOps || q < 0) return;
+            if(q >= kBlockQubits*kBlocks) { bump(dropped, 1); return; }
+            std::atomic<QubitBlock*> &slot = blocks[module][q / kBlockQubits];
+            QubitBlock *b = slot.load(std::memory_order_acquire);
+            if(!b) { b = new QubitBlock(); slot.store(b, std::memory_order_release); }
+            bump(b->count[op][q % kBlockQubits], 1);
+            bump(b->sum_ns[op][q % kBlockQubits], ns);
+        }
+    };
+}
+
+struct LatencyHistogram {
+    uint64_t buckets[metrics_detail::kBuckets+1] = {};
+    uint64_t count = 0, sum_ns = 0;
+
+    static double upperBoundSeconds(int b) { return (double)(1ull << b) * 1e-6; }
+    double meanMs() const { return count ? sum_ns / 1e6 / count : 0.0; }
+    // Upper bound of the bucket holding quantile q, in milliseconds.
+    double quantileMs(double q) const {
+        uint64_t rank = (uint64_t)(q * count + 0.5), seen = 0;
+        for(int b=0;b<=metrics_detail::kBuckets;b++){
+            seen += buckets[b];
+            if(seen >= rank && seen) return upperBoundSeconds(b < metrics_detail::kBuckets ? b : b-1) * 1e3; // overflow: its lower edge
+        }
+        return 0.0;
+    }
+};
+
+struct QubitMetric {
+    HwOp op;
+    int module, qubit;
+    uint64_t count, sum_ns;
+};
+
+struct MetricsSnapshot {
+    LatencyHistogram hist[metrics_detail::kOps][metrics_detail::kMaxModules];
+    std::vector<QubitMetric> qubits; // non-zero entries only
+    uint64_t dropped = 0;
+
+    // All modules folded together.
+    LatencyHistogram total(HwOp op) const {
+        LatencyHistogram t;
+        for(const LatencyHistogram &h: hist[(int)op]){
+            for(int b=0;b<=metrics_detail::kBuckets;b++) t.buckets[b] += h.buckets[b];
+            t.count += h.count;
+            t.sum_ns += h.sum_ns;
+        }
+        return t;
+    }
+
+    // Prometheus text exposition format.
+    std::string prometheus() const {
+        std::ostringstream out;
+        out << "# HELP qc_hw_latency_seconds Latency of hardware calls.\n# TYPE qc_hw_latency_seconds histogram\n";
+        for(int op=0;op<metrics_detail::kOps;op++)
+            for(int m=0;m<metrics_detail::kMaxModules;m++){
+                const LatencyHistogram &h = hist[op][m];
+                if(!h.count) continue;
+                std::string labels = std::string("op=\"") + hwOpName((HwOp)op) + "\",module=\"" + std::to_string(m) + "\"";
+                uint64_t cum = 0;
+                for(int b=0;b<metrics_detail::kBuckets;b++){
+                    cum += h.buckets[b];
+                    out << "qc_hw_latency_seconds_bucket{" << labels << ",le=\"" << LatencyHistogram::upperBoundSeconds(b) << "\"} " << cum << "\n";
+                }
+                out << "qc_hw_latency_seconds_bucket{" << labels << ",le=\"+Inf\"} " << h.count << "\n";
+                out << "qc_hw_latency_seconds_sum{" << labels << "} " << h.sum_ns / 1e9 << "\n";
+                out << "qc_hw_latency_seconds_count{" << labels << "} " << h.count << "\n";
+            }
+        out << "# HELP qc_hw_qubit_calls_total Hardware calls per qubit.\n# TYPE qc_hw_qubit_calls_total counter\n";
+        for(const QubitMetric &q: qubits)
+            out << "qc_hw_qubit_calls_total{op=\"" << hwOpName(q.op) << "\",module=\"" << q.module << "\",qubit=\"" << q.qubit << "\"} " << q.count << "\n";
+        out << "# HELP qc_hw_qubit_seconds_total Time spent in hardware calls per qubit.\n# TYPE qc_hw_qubit_seconds_total counter\n";
+        for(const QubitMetric &q: qubits)
+            out << "qc_hw_qubit_seconds_total{op=\"" << hwOpName(q.op) << "\",module=\"" << q.module << "\",qubit=\"" << q.qubit << "\"} " << q.sum_ns / 1e9 << "\n";
+        out << "# TYPE qc_metrics_dropped_total counter\nqc_metrics_dropped_total " << dropped << "\n";
+        return out.str();
+    }
+
+    std::string json() const {
+        std::ostringstream out;
+        out << "{\"histograms\":[";
+        bool first = true;
+        for(int op=0;op<metrics_detail::kOps;op++)
+            for(int m=0;m<metrics_detail::kMaxModules;m++){
+                const LatencyHistogram &h = hist[op][m];
+                if(!h.count) continue;
+                out << (first ? "" : ",") << "{\"op\":\"" << hwOpName((HwOp)op) << "\",\"module\":" << m
+                    << ",\"count\":" << h.count << ",\"sum_ns\":" << h.sum_ns << ",\"buckets\":[";
+                for(int b=0;b<=metrics_detail::kBuckets;b++) out << (b ? "," : "") << h.buckets[b];
+                out << "]}";
+                first = false;
+            }
+        out << "],\"qubits\":[";
+        for(size_t i=0;i<qubits.size();i++)
+            out << (i ? "," : "") << "{\"op\":\"" << hwOpName(qubits[i].op) << "\",\"module\":" << qubits[i].module << ",\"qubit\":" << qubits[i].qubit
+                << ",\"count\":" << qubits[i].count << ",\"sum_ns\":" << qubits[i].sum_ns << "}";
+        out << "],\"dropped\":" << dropped << "}";
+        return out.str();
+    }
+};
+
+class Metrics {
+private:
+    std::mutex mtx;
+    std::vector<std::unique_ptr<metrics_detail::Shard>> shards;
+    std::vector<metrics_detail::Shard*> free_shards;
+    std::atomic<bool> enabled{true};
+
+    struct Handle {
+        Metrics *owner = nullptr;
+        metrics_detail::Shard *shard = nullptr;
+        ~Handle() { if(shard) owner->release(shard); }
+    };
+
+    metrics_detail::Shard *acquire() {
+        std::lock_guard<std::mutex> guard(mtx);
+        if(!free_shards.empty()) { metrics_detail::Shard *s = free_shards.back(); free_shards.pop_back(); return s; }
+        shards.push_back(std::make_unique<metrics_detail::Shard>());
+        return shards.back().get();
+    }
+
+    void release(metrics_detail::Shard *s) {
+        std::lock_guard<std::mutex> guard(mtx);
+        free_shards.push_back(s);
+    }
+
+    Metrics() = default;
+
+    metrics_detail::Shard &local() { // one registry per process, so one handle per thread
+        thread_local Handle h;
+        if(!h.shard) { h.owner = this; h.shard = acquire(); }
+        return *h.shard;
+    }
+
+public:
+    static Metrics &global() {
+        static Metrics *m = new Metrics(); // never destroyed: thread exits may still release shards
+        return *m;
+    }
+
+    void setEnabled(bool on) { enabled.store(on, std::memory_order_relaxed); }
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    // q2/module2 name the second qubit of a two-qubit call, which is counted
+    // on both qubits but enters the histogram once.
+    void record(HwOp op, int module, int q, uint64_t ns, int module2=-1, int q2=-1) {
+        using namespace metrics_detail;
+        Shard &s = local();
+        if(module < 0 || module >= kMaxModules) { bump(s.dropped, 1); return; }
+        Histogram &h = s.hist[(int)op][module];
+        bump(h.buckets[bucketOf(ns)], 1);
+        bump(h.count, 1);
+        bump(h.sum_ns, ns);
+        s.recordQubit((int)op, module, q, ns);
+        if(q2 >= 0) {
+            if(module2 < 0) module2 = module;
+            if(module2 >= kMaxModules) bump(s.dropped, 1);
+            else s.recordQubit((int)op, module2, q2, ns);
+        }
+    }
+
+    MetricsSnapshot snapshot() {
+        using namespace metrics_detail;
+        MetricsSnapshot snap;
+        std::lock_guard<std::mutex> guard(mtx);
+        for(const auto &s: shards){
+            for(int op=0;op<kOps;op++)
+                for(int m=0;m<kMaxModules;m++){
+                    const Histogram &src = s->hist[op][m];
+                    LatencyHistogram &dst = snap.hist[op][m];
+                    for(int b=0;b<=kBuckets;b++) dst.buckets[b] += src.buckets[b].load(std::memory_order_relaxed);
+                    dst.count += src.count.load(std::memory_order_relaxed);
+                    dst.sum_ns += src.sum_ns.load(std::memory_order_relaxed);
+                }
+            snap.dropped += s->dropped.load(std::memory_order_relaxed);
+        }
+        uint64_t count[kQubitOps][kBlockQubits], sum[kQubitOps][kBlockQubits];
+        for(int m=0;m<kMaxModules;m++)
+            for(int k=0;k<kBlocks;k++){
+                bool any = false;
+                for(const auto &s: shards){
+                    const QubitBlock *b = s->blocks[m][k].load(std::memory_order_acquire);
+                    if(!b) continue;
+                    if(!any) { std::memset(count, 0, sizeof(count)); std::memset(sum, 0, sizeof(sum)); any = true; }
+                    for(int op=0;op<kQubitOps;op++)
+                        for(int i=0;i<kBlockQubits;i++){
+                            count[op][i] += b->count[op][i].load(std::memory_order_relaxed);
+                            sum[op][i] += b->sum_ns[op][i].load(std::memory_order_relaxed);
+                        }
+                }
+                if(!any) continue;
+                for(int op=0;op<kQubitOps;op++)
+                    for(int i=0;i<kBlockQubits;i++)
+                        if(count[op][i]) snap.qubits.push_back({(HwOp)op, m, k*kBlockQubits + i, count[op][i], sum[op][i]});
+            }
+        return snap;
+    }
+};
+
+inline Metrics &metrics() { return Metrics::global(); }
+
+// Times the enclosing scope into metrics(); costs two clock reads.
+class ScopedHwTimer {
+private:
+    HwOp op;
+    int module, q, module2, q2;
+    std::chrono::steady_clock::time_point start;
+public:
+    ScopedHwTimer(HwOp o, int m, int qubit, int m2=-1, int qubit2=-1)
+        : op(o), module(m), q(qubit), module2(m2), q2(qubit2), start(std::chrono::steady_clock::now()) {}
+    ~ScopedHwTimer() {
+        if(!metrics().isEnabled()) return;
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        metrics().record(op, module, q, (uint64_t)ns, module2, q2);
+    }
+    ScopedHwTimer(const ScopedHwTimer&) = delete;
+    ScopedHwTimer &operator=(const ScopedHwTimer&) = delete;
+};
+
+// Writes metrics().snapshot().json() to `path` every `interval` (replacing the
+// file each time) until destroyed; the last snapshot is written on the way out.
+class MetricsReporter {
+private:
+    std::string path;
+    std::chrono::milliseconds interval;
+    bool stopping = false;
+    std::mutex mtx;
+    std::condition_variable wake;
+    std::thread worker;
+
+    void write() {
+        std::string tmp = path + ".tmp";
+        { std::ofstream f(tmp, std::ios::trunc); f << metrics().snapshot().json() << "\n"; }
+        std::rename(tmp.c_str(), path.c_str());
+    }
+
+public:
+    MetricsReporter(std::string file, std::chrono::milliseconds every = std::chrono::seconds(10)) : path(std::move(file)), interval(every) {
+        worker = std::thread([this]() {
+            std::unique_lock<std::mutex> lock(mtx);
+            while(!wake.wait_for(lock, interval, [this]() { return stopping; })) { lock.unlock(); write(); lock.lock(); }
+            lock.unlock();
+            write();
+        });
+    }
+    ~MetricsReporter() {
+        { std::lock_guard<std::mutex> guard(mtx); stopping = true; }
+        wake.notify_one();
+        worker.join();
+    }
+};
+
+// --------------------------
+// Console Sink
+// --------------------------
+// The per-call "[Hardware] Applying ..." trace. Off unless verbosity is
+// Trace (QC_VERBOSITY=2 or setConsoleVerbosity); lines are built off-lock and
+// written whole, without a flush per line.
+enum Verbosity : int { Quiet = 0, Summary = 1, Trace = 2 };
+
+inline std::atomic<int> &consoleVerbosity() {
+    static std::atomic<int> level{[]() { const char *v = std::getenv("QC_VERBOSITY"); return v ? std::atoi(v) : (int)Summary; }()};
+    return level;
+}
+inline void setConsoleVerbosity(Verbosity v) { consoleVerbosity().store(v, std::memory_order_relaxed); }
+inline bool consoleEnabled(Verbosity v) { return consoleVerbosity().load(std::memory_order_relaxed) >= v; }
+
+class ConsoleLine {
+private:
+    std::ostringstream line;
+    static std::mutex &lock() { static std::mutex m; return m; }
+public:
+    template<typename T> ConsoleLine &operator<<(const T &v) { line << v; return *this; }
+    ~ConsoleLine() {
+        line << '\n';
+        std::lock_guard<std::mutex> guard(lock());
+        std::cout << line.str();
+    }
+};
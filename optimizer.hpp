@@ -0,0 +1,187 @@
+#pragma once
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <cstdint>
+#include "circuit_ir.hpp"
+#include "scheduler.hpp"
+
+// --------------------------
+// Peephole Optimizer
+// --------------------------
+// Works on program order. Each qubit wire is a chain of gates; two gates are
+// "adjacent" when nothing else touches their qubits in between.
+//   * self-inverse pairs cancel: H.H, X.X, Y.Y, CNOT.CNOT (same operands),
+//     CZ.CZ and SWAP.SWAP (either operand order);
+//   * runs of Z-axis phases (Z, S, T, SDG, TDG) merge into at most two gates,
+//     counted in units of pi/4: T.T = S, S.S = Z, S.SDG = I, ...;
+//   * optionally, any remaining run of single-qubit gates on a wire fuses into
+//     one U3 pulse, for backends that accept arbitrary unitaries. Gates with a
+//     symbolic angle end a run, so bind() can still patch them.
+// Cancellation cascades: H X X H collapses to nothing. Measurements and
+// conditional gates are left alone and end every run on their qubits.
+struct OptimizeOptions {
+    bool fuse_single_qubit = false;
+};
+
+struct OptimizationReport {
+    size_t gates_before = 0, gates_after = 0;
+    size_t depth_before = 0, depth_after = 0;
+    size_t cancelled = 0;  // gates removed as inverse pairs or identity phases
+    size_t merged = 0;     // phase gates folded into a neighbour
+    size_t fused = 0;      // single-qubit gates folded into U3 pulses
+    size_t swaps_inserted = 0; // SWAPs added by routing (filled in by compile())
+};
+
+namespace detail {
+    // Phase in units of pi/4, or -1 for gates that are not Z-axis rotations.
+    inline int phaseUnits(GateOp op) {
+        switch(op){
+        case GateOp::Z: return 4;
+        case GateOp::S: return 2;
+        case GateOp::T: return 1;
+        case GateOp::SDG: return 6;
+        case GateOp::TDG: return 7;
+        default: return -1;
+        }
+    }
+
+    inline bool selfInverse(GateOp op) {
+        return op == GateOp::H || op == GateOp::X || op == GateOp::Y || op == GateOp::CNOT || op == GateOp::CZ || op == GateOp::SWAP;
+    }
+
+    inline bool sameOperands(const Instruction &a, const Instruction &b) {
+        if(a.q0 == b.q0 && a.q1 == b.q1) return true;
+        bool symmetric = a.op == GateOp::CZ || a.op == GateOp::SWAP;
+        return symmetric && a.q0 == b.q1 && a.q1 == b.q0;
+    }
+
+    struct Node {
+        Instruction in;
+        int prev0, prev1;  // previous live node on q0 / q1
+        int phase;         // accumulated pi/4 units for phase nodes, -1 otherwise
+        bool dead;
+    };
+
+    // Matrix -> U3 angles, dropping the global phase.
+    inline void toU3(const Matrix2 &m, double &theta, double &phi, double &lambda) {
+        const double eps = 1e-12;
+        double a = std::abs(m[0]), b = std::abs(m[2]);
+        theta = 2*std::atan2(b, a);
+        if(b < eps) { phi = 0; lambda = std::arg(m[3]) - std::arg(m[0]); }
+        else if(a < eps) { lambda = 0; phi = std::arg(m[2]) - std::arg(-m[1]); }
+        else { phi = std::arg(m[2]) - std::arg(m[0]); lambda = std::arg(-m[1]) - std::arg(m[0]); }
+    }
+
+    inline void multiply(const Matrix2 &a, const Matrix2 &b, Matrix2 &out) { // out = a*b
+        std::complex<double> r[4] = {a[0]*b[0]+a[1]*b[2], a[0]*b[1]+a[1]*b[3], a[2]*b[0]+a[3]*b[2], a[2]*b[1]+a[3]*b[3]};
+        for(int i=0;i<4;i++) out[i] = r[i];
+    }
+
+    inline bool identityUpToPhase(const Matrix2 &m) {
+        return std::abs(m[1]) < 1e-9 && std::abs(m[2]) < 1e-9 && std::abs(m[3] - m[0]) < 1e-9;
+    }
+}
+
+inline std::vector<Instruction> optimizeCircuit(const std::vector<Instruction> &instrs, int width, const OptimizeOptions &opts = {}, OptimizationReport *report = nullptr) {
+    using detail::Node;
+    OptimizationReport r;
+    r.gates_before = instrs.size();
+    uint32_t depth;
+    assignMoments(instrs, width, SchedulePolicy::ASAP, depth);
+    r.depth_before = depth;
+
+    std::vector<Node> nodes;
+    nodes.reserve(instrs.size());
+    std::vector<int> last(width, -1);
+
+    auto kill = [&](int i) {
+        Node &n = nodes[i];
+        n.dead = true;
+        last[n.in.q0] = n.prev0;
+        if(isTwoQubit(n.in.op)) last[n.in.q1] = n.prev1;
+    };
+
+    for(const Instruction &in: instrs){
+        int j = last[in.q0];
+        if(isClassical(in) || (j >= 0 && isClassical(nodes[j].in))) j = -1; // readouts and conditional gates never merge
+        if(!isTwoQubit(in.op)){
+            int units = detail::phaseUnits(in.op);
+            if(j >= 0 && units >= 0 && nodes[j].phase >= 0){
+                nodes[j].phase = (nodes[j].phase + units) & 7;
+                r.merged++;
+                if(nodes[j].phase == 0) { kill(j); r.merged--; r.cancelled += 2; }
+                continue;
+            }
+            if(j >= 0 && detail::selfInverse(in.op) && nodes[j].in.op == in.op){
+                kill(j);
+                r.cancelled += 2;
+                continue;
+            }
+        } else if(j >= 0 && j == last[in.q1] && nodes[j].in.op == in.op && detail::selfInverse(in.op) && detail::sameOperands(nodes[j].in, in)){
+            kill(j);
+            r.cancelled += 2;
+            continue;
+        }
+        Node n{in, last[in.q0], isTwoQubit(in.op) ? last[in.q1] : -1, isClassical(in) ? -1 : detail::phaseUnits(in.op), false};
+        nodes.push_back(n);
+        last[in.q0] = (int)nodes.size()-1;
+        if(isTwoQubit(in.op)) last[in.q1] = (int)nodes.size()-1;
+    }
+
+    // Emit, expanding merged phases: 1 T, 2 S, 3 S.T, 4 Z, 5 Z.T, 6 SDG, 7 TDG.
+    std::vector<Instruction> out;
+    out.reserve(nodes.size());
+    for(const Node &n: nodes){
+        if(n.dead) continue;
+        if(n.phase < 0) { out.push_back(n.in); continue; }
+        auto emit = [&](GateOp op) { out.push_back(Instruction{op, n.in.q0, -1, {}}); };
+        switch(n.phase){
+        case 1: emit(GateOp::T); break;
+        case 2: emit(GateOp::S); break;
+        case 3: emit(GateOp::S); emit(GateOp::T); r.merged--; break;
+        case 4: emit(GateOp::Z); break;
+        case 5: emit(GateOp::Z); emit(GateOp::T); r.merged--; break;
+        case 6: emit(GateOp::SDG); break;
+        case 7: emit(GateOp::TDG); break;
+        }
+    }
+
+    if(opts.fuse_single_qubit){
+        // Runs of single-qubit gates between two-qubit gates; the fused pulse
+        // takes the slot of the run's last gate.
+        std::vector<std::vector<size_t>> run(width);
+        std::vector<uint8_t> drop(out.size(), 0);
+        auto flush = [&](int q) {
+            std::vector<size_t> &g = run[q];
+            if(g.size() >= 2){
+                Matrix2 acc = {1, 0, 0, 1}, m;
+                for(size_t i: g) { gateMatrix(out[i], m); detail::multiply(m, acc, acc); }
+                for(size_t k=0;k+1<g.size();k++) drop[g[k]] = 1;
+                if(detail::identityUpToPhase(acc)) { drop[g.back()] = 1; r.cancelled += g.size(); }
+                else {
+                    Instruction &u = out[g.back()];
+                    u = Instruction{GateOp::U, q, -1, {}};
+                    detail::toU3(acc, u.params[0], u.params[1], u.params[2]);
+                    r.fused += g.size() - 1;
+                }
+            }
+            g.clear();
+        };
+        for(size_t i=0;i<out.size();i++){
+            if(isTwoQubit(out[i].op)) { flush(out[i].q0); flush(out[i].q1); }
+            else if(out[i].param >= 0 || isClassical(out[i])) flush(out[i].q0); // angle unknown until bind(), or feedback
+            else run[out[i].q0].push_back(i);
+        }
+        for(int q=0;q<width;q++) flush(q);
+        size_t k = 0;
+        for(size_t i=0;i<out.size();i++) if(!drop[i]) out[k++] = out[i];
+        out.resize(k);
+    }
+
+    r.gates_after = out.size();
+    assignMoments(out, width, SchedulePolicy::ASAP, depth);
+    r.depth_after = depth;
+    if(report) *report = r;
+    return out;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include "backend.hpp"
+#include "shots.hpp"
+#include "thread_pool.hpp"
+#include "arena.hpp"
+
+// --------------------------
+// Parallel Shot Readout
+// --------------------------
+// Shots are cut into chunks of shot_chunk; each chunk reads into its own
+// disjoint rows of the result buffer and counts its own ones while the rows
+// are hot, then the per-chunk counts are merged pairwise. readRegister is
+// addressed by shot number, so neither the chunking nor the thread that reads
+// a chunk changes a bit: the result equals the serial loop for the same seed.
+// Chunks run on at most readoutChannels() threads at once, each as one
+// readRegisters call (one round trip to a remote module).
+
+constexpr size_t shot_chunk = 1024;
+
+// Pairwise merge of `parts` partial results, one tree level per pass:
+// merge(i, j) folds part j into part i, and part 0 ends up with the total.
+template<typename Merge>
+void treeReduce(ThreadPool &pool, size_t parts, Merge merge) {
+    for(size_t step=1;step<parts;step*=2){
+        size_t pairs = (parts - step + 2*step - 1) / (2*step);
+        pool.parallelFor(pairs, [&](size_t k) { merge(k*2*step, k*2*step + step); });
+    }
+}
+
+// fn(lo, n) for every shot_chunk of [0, shots), spread across the pool (or
+// inline without one). For samplers addressed by shot number, where the
+// thread that draws a chunk does not change its bits.
+template<typename Fn>
+void forShotChunks(ThreadPool *pool, size_t shots, Fn fn) {
+    size_t chunks = (shots + shot_chunk - 1) / shot_chunk;
+    auto chunk = [&](size_t c) { size_t lo = c*shot_chunk; fn(lo, std::min(shot_chunk, shots - lo)); };
+    if(pool && chunks > 1) pool->parallelFor(chunks, chunk);
+    else for(size_t c=0;c<chunks;c++) chunk(c);
+}
+
+// Shots [first, first+buf.shots()) of `qubits` into `buf` (zeroed, one row per
+// shot). When `ones` is given it receives the per-qubit ones counts; the
+// per-chunk counts live in `scratch`, so a reused buffer and arena make the
+// whole readout allocation-free.
+inline void readShots(ThreadPool *pool, Backend &backend, const std::vector<int> &qubits, uint64_t first, ShotBuffer &buf, Arena &scratch, uint64_t *ones) {
+    size_t shots = buf.shots(), width = qubits.size();
+    size_t chunks = (shots + shot_chunk - 1) / shot_chunk;
+    size_t lanes = pool ? std::min({chunks, (size_t)std::max(1, backend.readoutChannels()), pool->size() + 1}) : 1;
+    if(lanes <= 1){
+        for(size_t lo=0;lo<shots;lo+=shot_chunk) backend.readRegisters(qubits, first+lo, std::min(shot_chunk, shots - lo), buf.shot(lo));
+        if(ones) { std::fill(ones, ones + width, 0); buf.addOnes(0, shots, ones); }
+        return;
+    }
+    uint64_t *counts = ones ? scratch.array<uint64_t>(chunks * width) : nullptr;
+    pool->parallelFor(lanes, [&](size_t lane) {
+        for(size_t c=lane;c<chunks;c+=lanes){
+            size_t lo = c*shot_chunk, n = std::min(shot_chunk, shots - lo);
+            backend.readRegisters(qubits, first+lo, n, buf.shot(lo));
+            if(counts) buf.addOnes(lo, n, counts + c*width);
+        }
+    });
+    if(!ones) return;
+    treeReduce(*pool, chunks, [&](size_t a, size_t b) {
+        for(size_t i=0;i<width;i++) counts[a*width + i] += counts[b*width + i];
+    });
+    std::copy(counts, counts + width, ones);
+}
+
+// The same returning the counts, on scratch of its own.
+inline std::vector<uint64_t> readShots(ThreadPool *pool, Backend &backend, const std::vector<int> &qubits, uint64_t first, ShotBuffer &buf) {
+    Arena scratch;
+    std::vector<uint64_t> ones(qubits.size());
+    readShots(pool, backend, qubits, first, buf, scratch, ones.data());
+    return ones;
+}
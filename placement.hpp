@@ -0,0 +1,180 @@
+#pragma once
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+#include "circuit_ir.hpp"
+#include "link_scheduler.hpp"
+
+// --------------------------
+// Module Placement
+// --------------------------
+// Maps the logical qubits of a circuit onto modules so that as few two-qubit
+// gates as possible straddle a module boundary. The interaction graph has one
+// vertex per logical qubit and edge weight = number of two-qubit gates between
+// the pair; the cut weight is the number of inter-module gates.
+//   1. Greedy growth: each module in turn is seeded with the heaviest free
+//      vertex and grown by the vertex most connected to it until full.
+//   2. Kernighan-Lin refinement on every module pair: swap vertices (free
+//      slots take part as zero-weight dummies, so a qubit can also move into
+//      spare capacity) and keep the best prefix of each pass.
+struct PlacementOptions {
+    int max_passes = 8; // KL sweeps over all module pairs
+};
+
+struct Placement {
+    std::vector<QubitRef> map; // logical qubit -> (module, qubit)
+    size_t cut = 0;            // inter-module two-qubit gates after placement
+    size_t naive_cut = 0;      // same, with logical qubits laid out in module order
+};
+
+namespace detail {
+    using Adjacency = std::vector<std::vector<std::pair<int,int>>>; // (neighbour, weight)
+
+    inline Adjacency interactionGraph(const CircuitIR &ir) {
+        std::vector<std::pair<int,int>> edges;
+        for(const Instruction &in: ir.instructions())
+            if(isTwoQubit(in.op)) edges.emplace_back(std::min(in.q0, in.q1), std::max(in.q0, in.q1));
+        std::sort(edges.begin(), edges.end());
+        Adjacency adj(ir.numQubits());
+        for(size_t i=0;i<edges.size();){
+            size_t j = i;
+            while(j < edges.size() && edges[j] == edges[i]) j++;
+            int w = (int)(j-i);
+            adj[edges[i].first].emplace_back(edges[i].second, w);
+            adj[edges[i].second].emplace_back(edges[i].first, w);
+            i = j;
+        }
+        return adj;
+    }
+
+    inline size_t cutWeight(const Adjacency &adj, const std::vector<int> &part) {
+        size_t cut = 0;
+        for(size_t v=0;v<adj.size();v++) for(auto [u, w]: adj[v]) if((size_t)u > v && part[u] != part[v]) cut += w;
+        return cut;
+    }
+
+    // One KL pass between parts a and b; returns the gain applied (>= 0).
+    inline long klPass(const Adjacency &adj, std::vector<int> &part, int a, int b, int cap_a, int cap_b) {
+        std::vector<int> nodes, side; // local index -> vertex (-1 dummy), side 0 = a
+        for(size_t v=0;v<part.size();v++) if(part[v] == a) { nodes.push_back((int)v); side.push_back(0); }
+        for(int k=(int)nodes.size();k<cap_a;k++) { nodes.push_back(-1); side.push_back(0); }
+        size_t na = nodes.size();
+        for(size_t v=0;v<part.size();v++) if(part[v] == b) { nodes.push_back((int)v); side.push_back(1); }
+        for(int k=(int)(nodes.size()-na);k<cap_b;k++) { nodes.push_back(-1); side.push_back(1); }
+        size_t n = nodes.size();
+        if(na == 0 || na == n) return 0;
+
+        std::vector<int> local(part.size(), -1);
+        for(size_t i=0;i<n;i++) if(nodes[i] >= 0) local[nodes[i]] = (int)i;
+        std::vector<int> w(n*n, 0);
+        std::vector<long> D(n, 0);
+        for(size_t i=0;i<n;i++){
+            if(nodes[i] < 0) continue;
+            for(auto [u, wt]: adj[nodes[i]]){
+                int j = local[u];
+                if(j < 0) continue;
+                w[i*n+j] = wt;
+                D[i] += side[i] != side[j] ? wt : -wt;
+            }
+        }
+
+        std::vector<uint8_t> locked(n, 0);
+        std::vector<std::pair<int,int>> swaps;
+        long total = 0, best = 0;
+        size_t best_k = 0;
+        size_t steps = std::min(na, n-na);
+        for(size_t s=0;s<steps;s++){
+            long g = 0;
+            int bi = -1, bj = -1;
+            for(size_t i=0;i<na;i++){
+                if(locked[i]) continue;
+                for(size_t j=na;j<n;j++){
+                    if(locked[j] || (nodes[i] < 0 && nodes[j] < 0)) continue;
+                    long gain = D[i] + D[j] - 2*w[i*n+j];
+                    if(bi < 0 || gain > g) { g = gain; bi = (int)i; bj = (int)j; }
+                }
+            }
+            if(bi < 0) break;
+            locked[bi] = locked[bj] = 1;
+            for(size_t x=0;x<n;x++){
+                if(locked[x]) continue;
+                int toward = side[x] == 0 ? 1 : -1; // bi leaves side 0, bj joins it
+                D[x] += 2*toward*(w[x*n+bi] - w[x*n+bj]);
+            }
+            swaps.emplace_back(bi, bj);
+            total += g;
+            if(total > best) { best = total; best_k = swaps.size(); }
+        }
+        for(size_t k=0;k<best_k;k++){
+            auto [i, j] = swaps[k];
+            if(nodes[i] >= 0) part[nodes[i]] = b;
+            if(nodes[j] >= 0) part[nodes[j]] = a;
+        }
+        return best;
+    }
+}
+
+inline Placement placeQubits(const CircuitIR &ir, const std::vector<int> &capacity, const PlacementOptions &opts = {}) {
+    int N = ir.numQubits();
+    int modules = (int)capacity.size();
+    long total_cap = 0;
+    for(int c: capacity) total_cap += c;
+    if(total_cap < N) throw std::invalid_argument("placeQubits: circuit needs " + std::to_string(N) + " qubits, modules hold " + std::to_string(total_cap));
+
+    detail::Adjacency adj = detail::interactionGraph(ir);
+    std::vector<long> degree(N, 0);
+    for(int v=0;v<N;v++) for(auto [u, w]: adj[v]) degree[v] += w;
+
+    Placement p;
+    std::vector<int> part(N, -1);
+    {
+        std::vector<int> naive(N);
+        for(int v=0, m=0, used=0;v<N;v++){
+            while(used == capacity[m]) { m++; used = 0; }
+            naive[v] = m; used++;
+        }
+        p.naive_cut = detail::cutWeight(adj, naive);
+    }
+
+    // Greedy growth.
+    std::vector<long> conn(N, 0);
+    int left = N;
+    for(int m=0;m<modules && left>0;m++){
+        std::fill(conn.begin(), conn.end(), 0);
+        for(int filled=0;filled<capacity[m] && left>0;filled++){
+            int pick = -1;
+            for(int v=0;v<N;v++){
+                if(part[v] >= 0) continue;
+                if(pick < 0 || conn[v] > conn[pick] || (conn[v] == conn[pick] && degree[v] > degree[pick])) pick = v;
+            }
+            part[pick] = m;
+            left--;
+            for(auto [u, w]: adj[pick]) conn[u] += w;
+        }
+    }
+
+    // Kernighan-Lin refinement.
+    for(int pass=0;pass<opts.max_passes;pass++){
+        long gained = 0;
+        for(int a=0;a<modules;a++)
+            for(int b=a+1;b<modules;b++)
+                while(long g = detail::klPass(adj, part, a, b, capacity[a], capacity[b])) gained += g;
+        if(gained == 0) break;
+    }
+
+    p.cut = detail::cutWeight(adj, part);
+    p.map.resize(N);
+    std::vector<int> next(modules, 0);
+    for(int v=0;v<N;v++) p.map[v] = {part[v], next[part[v]]++};
+    return p;
+}
+
+// Rewrite a logical circuit onto the modules chosen by placeQubits.
+inline DistributedCircuit applyPlacement(const CircuitIR &ir, const Placement &p) {
+    DistributedCircuit out;
+    for(const Instruction &in: ir.instructions())
+        out.append({in.op, p.map[in.q0], isTwoQubit(in.op) ? p.map[in.q1] : QubitRef{-1, -1}, {in.params[0], in.params[1], in.params[2]}, in.param});
+    return out;
+}
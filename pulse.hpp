@@ -0,0 +1,368 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <stdexcept>
+#include <exception>
+#include <string>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include "circuit_ir.hpp"
+#include "calibration.hpp"
+
+// --------------------------
+// Pulse Programs
+// --------------------------
+// Gates lowered to what the control electronics actually play: envelopes in
+// waveform memory plus a sequence table of (start, channel, envelope, gain,
+// phase) entries. A whole run of gates goes to the hardware as one image in
+// one transfer and is triggered once, instead of a round trip per gate.
+//
+// Z-type gates (Z, S, T, SDG, TDG, RZ) are frame changes: they shift the phase
+// of later pulses on the qubit's line and take no time. Every other
+// single-qubit gate is one DRAG Gaussian on the line, the angle setting its
+// gain and the axis its phase (H is Z then RY(pi/2); U3 is RZ(lambda),
+// RY(theta), RZ(phi)). Two-qubit gates play their coupler pulse on the first
+// qubit's line while holding both. CZ and CPHASE commute with the frames; a
+// SWAP exchanges the two lines' frames, and CNOT is played as H CZ H on the
+// target, since a Z on the target does not commute with it. Each line is
+// scheduled as soon as it is free, so gates on disjoint qubits overlap just
+// as within a moment.
+
+// What an envelope is drawn from. Pulses of equal shape share one upload:
+// a qubit's drive envelope serves every rotation on it.
+struct PulseShape {
+    GateOp op;          // X for every drive pulse, the gate itself for couplers
+    int32_t q0, q1;     // q1 = -1 for drive pulses
+    uint32_t samples;   // one per ns
+    float amplitude;    // peak: the calibrated pi amplitude of a drive pulse
+
+    bool operator==(const PulseShape &o) const { return op == o.op && q0 == o.q0 && q1 == o.q1 && samples == o.samples && amplitude == o.amplitude; }
+};
+
+struct PulseShapeHash {
+    size_t operator()(const PulseShape &s) const {
+        uint32_t amp;
+        std::memcpy(&amp, &s.amplitude, sizeof(amp));
+        uint64_t h = ((uint64_t)(uint8_t)s.op << 56) ^ ((uint64_t)(uint32_t)s.q0 << 24) ^ (uint64_t)(uint32_t)s.q1 ^ ((uint64_t)amp << 20) ^ s.samples;
+        h ^= h >> 33; h *= 0xff51afd7ed558ccdull; h ^= h >> 33;
+        return (size_t)h;
+    }
+};
+
+// One sequence-table entry, as uploaded.
+struct PulseEvent {
+    uint32_t start_ns;  // from the program's trigger
+    uint32_t waveform;  // first sample in waveform memory
+    uint32_t samples;
+    uint16_t channel;   // qubit line
+    uint16_t partner;   // other qubit of a coupler pulse, 0xffff for none
+    float gain;         // envelope scale (rotation angle / pi), sign included
+    float phase;        // radians: drive axis plus the line's frame
+};
+static_assert(sizeof(PulseEvent) == 24, "sequence table layout");
+
+// I/Q samples of `s` appended to `iq`: a DRAG-corrected Gaussian for drive
+// pulses, a flat top with Gaussian edges for couplers.
+inline void synthesizeEnvelope(const PulseShape &s, std::vector<int16_t> &iq) {
+    const double full_scale = 32767, drag_beta = 0.5, edge = 10;
+    const double n = s.samples;
+    for(uint32_t t=0;t<s.samples;t++){
+        double i, q = 0;
+        if(s.q1 < 0){
+            double sigma = n/4, x = (t + 0.5 - n/2) / sigma;
+            i = s.amplitude * std::exp(-x*x/2);
+            q = -drag_beta * x / sigma * i;
+        } else {
+            double d = std::min(t + 0.5, n - t - 0.5);
+            i = d >= edge ? s.amplitude : s.amplitude * std::exp(-(edge - d)*(edge - d) * 4.5 / (edge*edge));
+        }
+        iq.push_back((int16_t)std::lround(std::clamp(i, -1.0, 1.0) * full_scale));
+        iq.push_back((int16_t)std::lround(std::clamp(q, -1.0, 1.0) * full_scale));
+    }
+}
+
+// Which envelopes are resident in waveform memory, and where. Memory is
+// filled front to back; when a new envelope no longer fits, the sequencer
+// plays what it holds and starts over from an empty cache.
+class WaveformCache {
+private:
+    std::unordered_map<PulseShape, uint32_t, PulseShapeHash> slots; // shape -> first sample
+    size_t used = 0, capacity;
+
+public:
+    explicit WaveformCache(size_t samples = 1 << 20) : capacity(samples) {}
+
+    bool find(const PulseShape &s, uint32_t &offset) const {
+        auto it = slots.find(s);
+        if(it == slots.end()) return false;
+        offset = it->second;
+        return true;
+    }
+
+    bool fits(const PulseShape &s) const { return used + s.samples <= capacity; }
+
+    uint32_t insert(const PulseShape &s) {
+        uint32_t offset = (uint32_t)used;
+        slots.emplace(s, offset);
+        used += s.samples;
+        return offset;
+    }
+
+    void clear() { slots.clear(); used = 0; }
+    size_t size() const { return slots.size(); }
+    size_t usedSamples() const { return used; }
+    size_t capacitySamples() const { return capacity; }
+};
+
+struct PulseStats {
+    uint64_t programs = 0;       // uploads (and triggers)
+    uint64_t pulses = 0;         // sequence-table entries
+    uint64_t frame_changes = 0;  // Z-type gates, free
+    uint64_t cache_hits = 0;     // pulses whose envelope was resident
+    uint64_t cache_misses = 0;   // envelopes synthesized and uploaded
+    uint64_t uploaded_bytes = 0;
+
+    double hitRate() const { return pulses ? (double)cache_hits / pulses : 0.0; }
+};
+
+// Collects gates into the open program and hands it to `upload` on flush().
+// Safe to call from several threads: flush() returns once everything sent
+// before it has played, and gates arriving while a program is in flight go
+// into the next one, so concurrent callers share uploads.
+class PulseSequencer {
+public:
+    // Moves one program image to the electronics and plays it; returns once
+    // it has played.
+    using Upload = std::function<void(const unsigned char *image, size_t bytes, uint32_t duration_ns)>;
+
+    static constexpr uint32_t drive_ns = 20;
+    static constexpr uint32_t coupler_ns = 200;
+    static constexpr float nominal_amplitude = 0.5f;  // drive amplitude of a qubit not calibrated here
+    static constexpr float coupler_amplitude = 0.8f;
+    static constexpr uint32_t image_magic = 0x534c5051; // "QPLS"
+
+private:
+    struct Fresh { uint32_t offset, samples; };
+
+    Upload upload;
+    WaveformCache cache;
+    std::mutex mtx;
+    std::condition_variable landed;
+    std::vector<float> amplitude;   // pi amplitude per qubit
+    std::vector<double> frame;      // accumulated virtual-Z phase per line
+
+    // The open program
+    std::vector<uint32_t> free_ns;  // when each line is next free
+    std::vector<PulseEvent> events;
+    std::vector<Fresh> fresh;       // envelopes it uploads...
+    std::vector<int16_t> samples;   // ...and their I/Q samples, in order
+    uint32_t duration = 0;
+
+    uint64_t sealed = 0, played = 0; // programs taken for upload / played
+    bool uploading = false;
+    std::vector<unsigned char> image; // the program in flight
+    PulseStats totals;
+
+    static constexpr double pi = 3.14159265358979323846;
+
+    template<typename T>
+    void append(const T &v) {
+        const unsigned char *p = reinterpret_cast<const unsigned char*>(&v);
+        image.insert(image.end(), p, p + sizeof(T));
+    }
+
+    // Image layout: header {magic, envelopes, events, duration_ns}; each new
+    // envelope as {offset, samples} then its I/Q pairs; the sequence table.
+    uint32_t seal() {
+        uint32_t ns = duration;
+        image.clear();
+        append(image_magic);
+        append((uint32_t)fresh.size());
+        append((uint32_t)events.size());
+        append(duration);
+        const int16_t *iq = samples.data();
+        for(const Fresh &f: fresh){
+            append(f);
+            const unsigned char *p = reinterpret_cast<const unsigned char*>(iq);
+            image.insert(image.end(), p, p + f.samples * 2 * sizeof(int16_t));
+            iq += f.samples * 2;
+        }
+        const unsigned char *p = reinterpret_cast<const unsigned char*>(events.data());
+        image.insert(image.end(), p, p + events.size() * sizeof(PulseEvent));
+        totals.programs++;
+        totals.uploaded_bytes += image.size();
+        events.clear();
+        fresh.clear();
+        samples.clear();
+        std::fill(free_ns.begin(), free_ns.end(), 0);
+        duration = 0;
+        sealed++;
+        return ns;
+    }
+
+    void flushLocked(std::unique_lock<std::mutex> &lock) {
+        uint64_t target = sealed + (events.empty() ? 0 : 1);
+        while(played < target){
+            if(uploading) { landed.wait(lock); continue; }
+            uint32_t ns = seal();
+            uploading = true;
+            lock.unlock();
+            std::exception_ptr error;
+            try { upload(image.data(), image.size(), ns); }
+            catch(...) { error = std::current_exception(); }
+            lock.lock();
+            played = sealed;
+            uploading = false;
+            landed.notify_all();
+            if(error) std::rethrow_exception(error);
+        }
+    }
+
+    // Where `s` sits in waveform memory, uploading it with this program if
+    // it isn't resident yet.
+    uint32_t envelope(std::unique_lock<std::mutex> &lock, const PulseShape &s) {
+        uint32_t offset;
+        if(cache.find(s, offset)) { totals.cache_hits++; return offset; }
+        if(!cache.fits(s)){
+            if(s.samples > cache.capacitySamples()) throw std::length_error("PulseSequencer: envelope larger than waveform memory");
+            do flushLocked(lock); while(!events.empty()); // what is queued refers to the old contents
+            cache.clear();
+        }
+        offset = cache.insert(s);
+        fresh.push_back({offset, s.samples});
+        synthesizeEnvelope(s, samples);
+        totals.cache_misses++;
+        return offset;
+    }
+
+    void check(int q) const {
+        if(q < 0 || q >= (int)amplitude.size()) throw std::out_of_range("PulseSequencer: qubit " + std::to_string(q) + " out of range");
+    }
+
+    void frameChange(int q, double angle) {
+        check(q);
+        frame[q] = std::remainder(frame[q] + angle, 2*pi);
+        totals.frame_changes++;
+    }
+
+    // Rotation by `theta` about the axis at `axis` radians from X.
+    void drive(std::unique_lock<std::mutex> &lock, int q, double theta, double axis) {
+        check(q);
+        uint32_t offset = envelope(lock, {GateOp::X, q, -1, drive_ns, amplitude[q]});
+        uint32_t start = free_ns[q];
+        events.push_back({start, offset, drive_ns, (uint16_t)q, 0xffff, (float)(theta / pi), (float)std::remainder(frame[q] + axis, 2*pi)});
+        free_ns[q] = start + drive_ns;
+        duration = std::max(duration, free_ns[q]);
+        totals.pulses++;
+    }
+
+    void hadamard(std::unique_lock<std::mutex> &lock, int q) {
+        frameChange(q, pi);
+        drive(lock, q, pi/2, pi/2);
+    }
+
+    void coupler(std::unique_lock<std::mutex> &lock, GateOp op, int q1, int q2, double gain) {
+        check(q1); check(q2);
+        uint32_t offset = envelope(lock, {op, q1, q2, coupler_ns, coupler_amplitude});
+        uint32_t start = std::max(free_ns[q1], free_ns[q2]);
+        events.push_back({start, offset, coupler_ns, (uint16_t)q1, (uint16_t)q2, (float)gain, (float)frame[q1]});
+        free_ns[q1] = free_ns[q2] = start + coupler_ns;
+        duration = std::max(duration, start + coupler_ns);
+        totals.pulses++;
+    }
+
+public:
+    PulseSequencer(int qubits, Upload up, size_t waveform_samples = 1 << 20)
+        : upload(std::move(up)), cache(waveform_samples), amplitude(qubits, nominal_amplitude), frame(qubits, 0.0), free_ns(qubits, 0) {}
+
+    // Drive pulses of `q` are drawn at this calibration's amplitude from now on.
+    void setCalibration(int q, const QubitCalibration &c) {
+        std::lock_guard<std::mutex> guard(mtx);
+        check(q);
+        if(c.status != Uncalibrated && c.pi_amplitude > 0) amplitude[q] = c.pi_amplitude;
+    }
+
+    void gate(GateOp op, int q) {
+        std::unique_lock<std::mutex> lock(mtx);
+        switch(op){
+            case GateOp::H:   hadamard(lock, q); break;
+            case GateOp::X:   drive(lock, q, pi, 0); break;
+            case GateOp::Y:   drive(lock, q, pi, pi/2); break;
+            case GateOp::Z:   frameChange(q, pi); break;
+            case GateOp::S:   frameChange(q, pi/2); break;
+            case GateOp::T:   frameChange(q, pi/4); break;
+            case GateOp::SDG: frameChange(q, -pi/2); break;
+            case GateOp::TDG: frameChange(q, -pi/4); break;
+            default: throw std::invalid_argument(std::string("PulseSequencer: ") + gateName(op) + " is not a fixed single-qubit gate");
+        }
+    }
+
+    void rotation(GateOp op, int q, double angle) {
+        std::unique_lock<std::mutex> lock(mtx);
+        if(op == GateOp::RX) drive(lock, q, angle, 0);
+        else if(op == GateOp::RY) drive(lock, q, angle, pi/2);
+        else if(op == GateOp::RZ) frameChange(q, angle);
+        else throw std::invalid_argument(std::string("PulseSequencer: ") + gateName(op) + " is not a single-qubit rotation");
+    }
+
+    void unitary(int q, const double params[3]) {
+        std::unique_lock<std::mutex> lock(mtx);
+        frameChange(q, params[2]);
+        drive(lock, q, params[0], pi/2);
+        frameChange(q, params[1]);
+    }
+
+    // SWAP, CNOT, CZ, or CPHASE by `angle`.
+    void twoQubit(GateOp op, int q1, int q2, double angle = pi) {
+        if(!isTwoQubit(op)) throw std::invalid_argument(std::string("PulseSequencer: ") + gateName(op) + " is not a two-qubit gate");
+        std::unique_lock<std::mutex> lock(mtx);
+        switch(op){
+            case GateOp::CNOT:
+                hadamard(lock, q2);
+                coupler(lock, GateOp::CZ, q1, q2, 1.0);
+                hadamard(lock, q2);
+                break;
+            case GateOp::SWAP:
+                coupler(lock, op, q1, q2, 1.0);
+                std::swap(frame[q1], frame[q2]);
+                break;
+            default: coupler(lock, op, q1, q2, op == GateOp::CPHASE ? angle / pi : 1.0);
+        }
+    }
+
+    // Upload and play the open program; returns once it (and any program
+    // already in flight) has played.
+    void flush() {
+        std::unique_lock<std::mutex> lock(mtx);
+        flushLocked(lock);
+    }
+
+    // Play what is queued, then forget the frames (active reset to |0>).
+    void reset() {
+        std::unique_lock<std::mutex> lock(mtx);
+        flushLocked(lock);
+        std::fill(frame.begin(), frame.end(), 0.0);
+    }
+
+    // Accumulated virtual-Z phase of line q, radians.
+    double framePhase(int q) {
+        std::lock_guard<std::mutex> guard(mtx);
+        check(q);
+        return frame[q];
+    }
+
+    PulseStats stats() {
+        std::lock_guard<std::mutex> guard(mtx);
+        return totals;
+    }
+
+    size_t residentEnvelopes() {
+        std::lock_guard<std::mutex> guard(mtx);
+        return cache.size();
+    }
+};
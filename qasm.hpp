@@ -0,0 +1,658 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <istream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <stdexcept>
+#include <charconv>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include "circuit_ir.hpp"
+#include "scheduler.hpp"
+
+// --------------------------
+// OpenQASM Parser
+// --------------------------
+// OpenQASM 2.0 and the matching subset of 3: qreg/creg and qubit/bit
+// declarations, the qelib1/stdgates gates the IR has (id, u1/p and u2 map
+// onto them), register broadcast, angle expressions, barrier and measurement
+// (mid-circuit too), and gates conditioned on classical bits with if(c==v),
+// if(c[i]==v) or if(c[i]). A measure that nothing later depends on stays a
+// terminal readout (see readout()); the others become MEASURE instructions.
+// Gate definitions, reset and loops are rejected with a QasmError naming the
+// line and column. Conditions span at most max_condition_bits bits.
+//
+// The parser is incremental: feed() takes whatever text is buffered, parses
+// every complete statement and returns how far it got, so the rest can be
+// completed by the next read. Tokens are string_views into the caller's
+// buffer; only register names are copied.
+
+class QasmError : public std::invalid_argument {
+public:
+    int line, column;
+    QasmError(int line_, int column_, const std::string &what)
+        : std::invalid_argument("qasm:" + std::to_string(line_) + ":" + std::to_string(column_) + ": " + what), line(line_), column(column_) {}
+};
+
+class QasmParser {
+private:
+    enum class Tok : uint8_t { End, Ident, Number, String, Punct };
+    struct Token {
+        Tok kind = Tok::End;
+        std::string_view text;
+        int line = 0, column = 0;
+        bool is(char c) const { return kind == Tok::Punct && text.size() == 1 && text[0] == c; }
+    };
+    struct Register { std::string name; int base, size; bool quantum; };
+    struct Operand { int base, size; bool whole; }; // whole: register broadcast
+
+    // How a QASM gate lands in the IR.
+    enum class Form : uint8_t { Plain, Identity, U2 };
+    struct GateSpec { std::string_view name; GateOp op; uint8_t params, qubits; Form form; };
+
+    static const GateSpec *findGate(std::string_view name) {
+        // most frequent first
+        static const GateSpec table[] = {
+            {"cx",GateOp::CNOT,0,2,Form::Plain}, {"h",GateOp::H,0,1,Form::Plain}, {"rz",GateOp::RZ,1,1,Form::Plain},
+            {"x",GateOp::X,0,1,Form::Plain}, {"CX",GateOp::CNOT,0,2,Form::Plain}, {"cz",GateOp::CZ,0,2,Form::Plain},
+            {"rx",GateOp::RX,1,1,Form::Plain}, {"ry",GateOp::RY,1,1,Form::Plain}, {"s",GateOp::S,0,1,Form::Plain},
+            {"sdg",GateOp::SDG,0,1,Form::Plain}, {"t",GateOp::T,0,1,Form::Plain}, {"tdg",GateOp::TDG,0,1,Form::Plain},
+            {"y",GateOp::Y,0,1,Form::Plain}, {"z",GateOp::Z,0,1,Form::Plain}, {"swap",GateOp::SWAP,0,2,Form::Plain},
+            {"cp",GateOp::CPHASE,1,2,Form::Plain}, {"cu1",GateOp::CPHASE,1,2,Form::Plain}, {"cphase",GateOp::CPHASE,1,2,Form::Plain},
+            {"cnot",GateOp::CNOT,0,2,Form::Plain}, {"U",GateOp::U,3,1,Form::Plain}, {"u",GateOp::U,3,1,Form::Plain},
+            {"u3",GateOp::U,3,1,Form::Plain}, {"u2",GateOp::U,2,1,Form::U2}, {"u1",GateOp::RZ,1,1,Form::Plain},
+            {"p",GateOp::RZ,1,1,Form::Plain}, {"phase",GateOp::RZ,1,1,Form::Plain}, {"id",GateOp::H,0,1,Form::Identity},
+        };
+        for(const GateSpec &g: table) if(g.name == name) return &g;
+        return nullptr;
+    }
+
+    // Statement being parsed: [pos, end) of src, end just past its ';'.
+    std::string_view src;
+    size_t pos = 0, end = 0;
+    Token tok;
+    int line = 1;
+    std::ptrdiff_t line_start = 0; // buffer offset of the current line; goes negative as the buffer shifts
+
+    std::vector<Register> regs;
+    int qubits = 0, bits = 0;
+    int version_ = 0;
+    size_t statements_ = 0;
+    // Measures are held back until something depends on them: a later gate
+    // on the qubit, a new measure of the qubit or into the bit, or a
+    // condition on the bit. Whatever is still held at the end is terminal.
+    std::vector<int> pending_bit;             // per qubit: bit of its held measure, -1 if none
+    std::vector<int> bit_source;              // per bit: qubit whose held measure writes it, -1 if none
+    std::vector<std::pair<int,int>> measures; // (qubit, bit) in program order
+    Instruction condition{GateOp::H, 0, -1, {}}; // of the gate being parsed (cwidth 0: none)
+    const GateSpec *last_gate = nullptr;
+
+    [[noreturn]] void fail(const Token &t, const std::string &what) const { throw QasmError(t.line, t.column, what); }
+
+    // Index of the ';' ending the statement that starts at p, or npos if the
+    // buffer ends first. Comments and strings may hold a ';'.
+    static size_t findEnd(std::string_view s, size_t p) {
+        while(p < s.size()){
+            char c = s[p];
+            if(c == ';') return p;
+            if(c == '/' && p+1 < s.size() && s[p+1] == '/'){
+                p = s.find('\n', p+2);
+                if(p == std::string_view::npos) return p;
+            } else if(c == '/' && p+1 < s.size() && s[p+1] == '*'){
+                p = s.find("*/", p+2);
+                if(p == std::string_view::npos) return p;
+                p += 2;
+                continue;
+            } else if(c == '"'){
+                p = s.find('"', p+1);
+                if(p == std::string_view::npos) return p;
+            }
+            p++;
+        }
+        return std::string_view::npos;
+    }
+
+    // ASCII classes, independent of the C locale; bytes >= 0x80 are UTF-8 (e.g. π)
+    static bool digit(unsigned char c) { return c >= '0' && c <= '9'; }
+    static bool identStart(unsigned char c) { return (c | 0x20) >= 'a' && (c | 0x20) <= 'z' ? true : c == '_' || c >= 0x80; }
+    static bool identChar(unsigned char c) { return identStart(c) || digit(c); }
+
+    void skipSpace() {
+        while(pos < end){
+            char c = src[pos];
+            if(c == '\n') { pos++; line++; line_start = (std::ptrdiff_t)pos; }
+            else if(c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v') pos++;
+            else if(c == '/' && pos+1 < end && src[pos+1] == '/') { while(pos < end && src[pos] != '\n') pos++; }
+            else if(c == '/' && pos+1 < end && src[pos+1] == '*'){
+                Token at{Tok::End, {}, line, column()};
+                size_t close = src.substr(0, end).find("*/", pos+2);
+                if(close == std::string_view::npos) fail(at, "unterminated comment");
+                for(;pos<close;pos++) if(src[pos] == '\n') { line++; line_start = (std::ptrdiff_t)pos+1; }
+                pos = close + 2;
+            }
+            else break;
+        }
+    }
+
+    int column() const { return (int)((std::ptrdiff_t)pos - line_start) + 1; }
+
+    void next() {
+        skipSpace();
+        tok.line = line;
+        tok.column = column();
+        size_t start = pos;
+        if(pos >= end) { tok.kind = Tok::End; tok.text = {}; return; }
+        unsigned char c = src[pos];
+        if(identStart(c)){
+            while(pos < end && identChar(src[pos])) pos++;
+            tok.kind = Tok::Ident;
+        } else if(digit(c) || (c == '.' && pos+1 < end && digit(src[pos+1]))){
+            while(pos < end && (digit(src[pos]) || src[pos] == '.')) pos++;
+            if(pos < end && (src[pos] == 'e' || src[pos] == 'E')){
+                size_t e = pos+1;
+                if(e < end && (src[e] == '+' || src[e] == '-')) e++;
+                if(e < end && digit(src[e])) { pos = e; while(pos < end && digit(src[pos])) pos++; }
+            }
+            tok.kind = Tok::Number;
+        } else if(c == '"'){
+            size_t close = src.find('"', pos+1);
+            if(close >= end) { tok.text = src.substr(start, 1); fail(tok, "unterminated string"); }
+            pos = close + 1;
+            tok.kind = Tok::String;
+        } else {
+            char d = pos+1 < end ? src[pos+1] : 0;
+            pos += (c == '-' && d == '>') || (c == '*' && d == '*') || (c == '=' && d == '=') ? 2 : 1;
+            tok.kind = Tok::Punct;
+        }
+        tok.text = src.substr(start, pos - start);
+    }
+
+    void expect(char c) {
+        if(!tok.is(c)) fail(tok, std::string("expected '") + c + "'" + (tok.kind == Tok::End ? "" : ", found \"" + std::string(tok.text) + "\""));
+        next();
+    }
+    void expectEnd() { expect(';'); if(tok.kind != Tok::End) fail(tok, "unexpected \"" + std::string(tok.text) + "\" after ';'"); }
+
+    std::string_view ident(const char *what) {
+        if(tok.kind != Tok::Ident) fail(tok, std::string("expected ") + what);
+        std::string_view name = tok.text;
+        next();
+        return name;
+    }
+
+    int integer() {
+        int v = 0;
+        auto [p, ec] = std::from_chars(tok.text.data(), tok.text.data() + tok.text.size(), v);
+        if(tok.kind != Tok::Number || ec != std::errc() || p != tok.text.data() + tok.text.size()) fail(tok, "expected a non-negative integer");
+        next();
+        return v;
+    }
+
+    // Angle expressions: + - * / ^ (or **), unary minus, parentheses, pi and
+    // the usual functions.
+    double expression() {
+        double v = term();
+        while(tok.is('+') || tok.is('-')){
+            bool add = tok.is('+');
+            next();
+            double r = term();
+            v = add ? v + r : v - r;
+        }
+        return v;
+    }
+    double term() {
+        double v = unary();
+        while(tok.is('*') || tok.is('/')){
+            bool mul = tok.is('*');
+            Token at = tok;
+            next();
+            double r = unary();
+            if(!mul && r == 0) fail(at, "division by zero");
+            v = mul ? v * r : v / r;
+        }
+        return v;
+    }
+    double unary() {
+        if(tok.is('-')) { next(); return -unary(); }
+        if(tok.is('+')) { next(); return unary(); }
+        double b = primary();
+        if(tok.is('^') || (tok.kind == Tok::Punct && tok.text == "**")) { next(); return std::pow(b, unary()); }
+        return b;
+    }
+    double primary() {
+        Token at = tok;
+        if(tok.kind == Tok::Number){
+            double v = 0;
+            auto [p, ec] = std::from_chars(tok.text.data(), tok.text.data() + tok.text.size(), v);
+            if(ec != std::errc() || p != tok.text.data() + tok.text.size()) fail(tok, "bad number \"" + std::string(tok.text) + "\"");
+            next();
+            return v;
+        }
+        if(tok.is('(')) { next(); double v = expression(); expect(')'); return v; }
+        if(tok.kind != Tok::Ident) fail(tok, tok.kind == Tok::End ? "expected an expression" : "unexpected \"" + std::string(tok.text) + "\" in expression");
+        std::string_view name = tok.text;
+        next();
+        const double pi = 3.14159265358979323846;
+        if(name == "pi" || name == "\xcf\x80") return pi;
+        if(name == "tau" || name == "\xcf\x84") return 2*pi;
+        if(name == "euler" || name == "\xe2\x84\x87") return 2.71828182845904523536;
+        static const struct { std::string_view name; double (*fn)(double); } functions[] = {
+            {"sin",std::sin}, {"cos",std::cos}, {"tan",std::tan}, {"exp",std::exp}, {"ln",std::log},
+            {"sqrt",std::sqrt}, {"asin",std::asin}, {"acos",std::acos}, {"atan",std::atan},
+        };
+        for(const auto &f: functions){
+            if(f.name != name) continue;
+            expect('(');
+            double v = expression();
+            expect(')');
+            return f.fn(v);
+        }
+        fail(at, "unknown identifier \"" + std::string(name) + "\" in expression");
+    }
+
+    const Register *findRegister(std::string_view name) const {
+        for(const Register &r: regs) if(r.name == name) return &r;
+        return nullptr;
+    }
+
+    void declare(const Token &at, std::string_view name, int size, bool quantum) {
+        if(findRegister(name)) fail(at, "register \"" + std::string(name) + "\" already declared");
+        if(size <= 0 || size > (1 << 20)) fail(at, "register size " + std::to_string(size) + " out of range");
+        int &count = quantum ? qubits : bits;
+        regs.push_back({std::string(name), count, size, quantum});
+        count += size;
+        if(quantum) pending_bit.resize(qubits, -1);
+        else bit_source.resize(bits, -1);
+    }
+
+    // name or name[index] of a declared register of the given kind; `name`
+    // may already have been read.
+    Operand operand(bool quantum) {
+        Token at = tok;
+        return operand(at, ident(quantum ? "a qubit operand" : "a classical bit operand"), quantum);
+    }
+    Operand operand(const Token &at, std::string_view name, bool quantum) {
+        const Register *r = findRegister(name);
+        if(!r) fail(at, "undeclared register \"" + std::string(name) + "\"");
+        if(r->quantum != quantum) fail(at, "\"" + std::string(name) + "\" is a " + (r->quantum ? "qubit" : "classical") + " register");
+        if(!tok.is('[')) return {r->base, r->size, true};
+        next();
+        Token index_at = tok;
+        int i = integer();
+        if(i >= r->size) fail(index_at, "index " + std::to_string(i) + " out of range for " + std::string(name) + "[" + std::to_string(r->size) + "]");
+        expect(']');
+        return {r->base + i, 1, false};
+    }
+
+    // Broadcast width of an operand list: whole registers must agree.
+    int broadcast(const Token &at, const Operand *ops, int n) const {
+        int width = 1;
+        bool seen = false;
+        for(int i=0;i<n;i++){
+            if(!ops[i].whole) continue;
+            if(seen && ops[i].size != width) fail(at, "registers of different sizes in one statement");
+            width = ops[i].size;
+            seen = true;
+        }
+        return width;
+    }
+
+    // Emit the held measure of qubit q, if any, as a mid-circuit MEASURE.
+    template<typename Emit>
+    void release(int q, Emit &emit) {
+        int b = pending_bit[q];
+        if(b < 0) return;
+        Instruction m{GateOp::MEASURE, q, -1, {}};
+        m.cbit = (int16_t)b;
+        emit(m);
+        pending_bit[q] = -1;
+        bit_source[b] = -1;
+    }
+
+    template<typename Emit>
+    void gate(const Token &at, std::string_view name, Emit &emit) {
+        const GateSpec *g = last_gate && last_gate->name == name ? last_gate : findGate(name);
+        if(!g) fail(at, "unknown gate \"" + std::string(name) + "\"");
+        last_gate = g;
+        double p[3] = {0, 0, 0};
+        int np = 0;
+        if(tok.is('(')){
+            next();
+            if(!tok.is(')')){
+                for(;;){
+                    Token pt = tok;
+                    double v = expression();
+                    if(np == 3) fail(pt, "too many parameters");
+                    p[np++] = v;
+                    if(!tok.is(',')) break;
+                    next();
+                }
+            }
+            expect(')');
+        }
+        if(np != g->params) fail(at, std::string(g->name) + " takes " + std::to_string(g->params) + " parameter(s), got " + std::to_string(np));
+        Operand ops[2];
+        for(int i=0;i<g->qubits;i++){
+            if(i) expect(',');
+            ops[i] = operand(true);
+        }
+        expectEnd();
+
+        Instruction in{g->op, -1, -1, {p[0], p[1], p[2]}};
+        in.cbit = condition.cbit; in.cwidth = condition.cwidth; in.cvalue = condition.cvalue;
+        if(g->form == Form::U2) { in.params[0] = 1.57079632679489661923; in.params[1] = p[0]; in.params[2] = p[1]; }
+        int width = broadcast(at, ops, g->qubits);
+        for(int k=0;k<width;k++){
+            in.q0 = ops[0].base + (ops[0].whole ? k : 0);
+            if(g->qubits == 2){
+                in.q1 = ops[1].base + (ops[1].whole ? k : 0);
+                if(in.q0 == in.q1) fail(at, std::string(g->name) + " on the same qubit twice");
+            }
+            if(g->form == Form::Identity) continue;
+            release(in.q0, emit);
+            if(in.q1 >= 0) release(in.q1, emit);
+            emit(in);
+        }
+    }
+
+    template<typename Emit>
+    void measure(const Token &at, Operand q, Operand c, Emit &emit) {
+        if(q.size != c.size) fail(at, "measure: " + std::to_string(q.size) + " qubit(s) into " + std::to_string(c.size) + " bit(s)");
+        if(c.base + c.size > INT16_MAX) fail(at, "measure: classical bit out of range");
+        for(int k=0;k<q.size;k++){
+            int qb = q.base + k, b = c.base + k;
+            release(qb, emit);
+            if(bit_source[b] >= 0) release(bit_source[b], emit);
+            pending_bit[qb] = b;
+            bit_source[b] = qb;
+            measures.push_back({qb, b});
+        }
+    }
+
+    // if(c==v) gate; if(c[i]==v) gate; if(c[i]) gate;
+    template<typename Emit>
+    void conditional(Emit &emit) {
+        expect('(');
+        Token ct = tok;
+        Operand c = operand(false);
+        unsigned value = 1;
+        if(tok.kind == Tok::Punct && tok.text == "=="){
+            next();
+            Token vt = tok;
+            value = (unsigned)integer();
+            if(c.size < 32 && value >> c.size) fail(vt, "value " + std::to_string(value) + " does not fit in " + std::to_string(c.size) + " bit(s)");
+        } else if(c.size != 1) fail(tok, "expected '==' after a classical register");
+        expect(')');
+        if(c.size > max_condition_bits) fail(ct, "condition on " + std::to_string(c.size) + " bits (at most " + std::to_string(max_condition_bits) + ")");
+        if(c.base + c.size > INT16_MAX) fail(ct, "condition: classical bit out of range");
+        for(int k=0;k<c.size;k++) if(bit_source[c.base + k] >= 0) release(bit_source[c.base + k], emit);
+        Token gt = tok;
+        std::string_view name = ident("a gate");
+        if(!findGate(name)) fail(gt, "only gates can be conditioned, not \"" + std::string(name) + "\"");
+        condition.cbit = (int16_t)c.base; condition.cwidth = (uint8_t)c.size; condition.cvalue = (uint8_t)value;
+        gate(gt, name, emit);
+        condition.cwidth = 0;
+    }
+
+    template<typename Emit>
+    void statement(Emit &emit) {
+        next();
+        Token at = tok;
+        if(at.is(';')) { expectEnd(); return; }
+        std::string_view kw = ident("a statement");
+        statements_++;
+        // gate calls are nearly every statement: try them before the keywords
+        if(!tok.is('[') && !tok.is('=') && (last_gate && last_gate->name == kw ? last_gate : findGate(kw))) { gate(at, kw, emit); return; }
+        if(kw == "OPENQASM"){
+            Token vt = tok;
+            if(tok.kind != Tok::Number) fail(tok, "expected a version number");
+            version_ = tok.text[0] - '0';
+            if((version_ != 2 && version_ != 3) || (tok.text.size() > 1 && tok.text[1] != '.')) fail(vt, "unsupported OpenQASM version " + std::string(tok.text));
+            next();
+            expectEnd();
+        } else if(kw == "include"){
+            if(tok.kind != Tok::String) fail(tok, "expected a file name");
+            std::string_view file = tok.text.substr(1, tok.text.size() - 2);
+            if(file != "qelib1.inc" && file != "stdgates.inc") fail(tok, "include \"" + std::string(file) + "\": only qelib1.inc and stdgates.inc are built in");
+            next();
+            expectEnd();
+        } else if(kw == "qreg" || kw == "creg"){
+            Token nt = tok;
+            std::string_view name = ident("a register name");
+            expect('[');
+            int size = integer();
+            expect(']');
+            expectEnd();
+            declare(nt, name, size, kw == "qreg");
+        } else if(kw == "qubit" || kw == "bit"){
+            int size = 1;
+            if(tok.is('[')) { next(); size = integer(); expect(']'); }
+            Token nt = tok;
+            std::string_view name = ident("a register name");
+            expectEnd();
+            declare(nt, name, size, kw == "qubit");
+        } else if(kw == "barrier"){
+            // gates on a qubit keep their order anyway; only the operands are checked
+            while(tok.kind == Tok::Ident) { operand(true); if(!tok.is(',')) break; next(); }
+            expectEnd();
+        } else if(kw == "measure"){
+            Operand q = operand(true);
+            if(!(tok.kind == Tok::Punct && tok.text == "->")) fail(tok, "expected '->'");
+            next();
+            Operand c = operand(false);
+            expectEnd();
+            measure(at, q, c, emit);
+        } else if(const Register *r = findRegister(kw); r && !r->quantum){
+            // OpenQASM 3: c[i] = measure q[i];
+            Operand c = operand(at, kw, false);
+            expect('=');
+            if(tok.kind != Tok::Ident || tok.text != "measure") fail(tok, "expected measure");
+            next();
+            Operand q = operand(true);
+            expectEnd();
+            measure(at, q, c, emit);
+        } else if(kw == "if"){
+            conditional(emit);
+        } else if(kw == "gate" || kw == "opaque" || kw == "def" || kw == "for" || kw == "while" || kw == "reset"
+                  || kw == "ctrl" || kw == "negctrl" || kw == "inv" || kw == "pow" || kw == "input" || kw == "output" || kw == "let" || kw == "const"){
+            fail(at, "\"" + std::string(kw) + "\" is not supported");
+        } else {
+            gate(at, kw, emit);
+        }
+    }
+
+public:
+    // Parse every complete statement at the front of `text`, handing each
+    // gate to emit(const Instruction&) in program order; returns the bytes
+    // consumed. The unconsumed tail must lead the next call's text. With
+    // `last`, text is the end of the input and it must all parse.
+    template<typename Emit>
+    size_t feed(std::string_view text, bool last, Emit &&emit) {
+        src = text;
+        size_t p = 0;
+        for(;;){
+            size_t semi = findEnd(text, p);
+            if(semi == std::string_view::npos){
+                if(last){
+                    pos = p; end = text.size();
+                    next();
+                    if(tok.kind != Tok::End) fail(tok, "expected ';' before the end of input");
+                    p = end;
+                }
+                break;
+            }
+            pos = p; end = semi + 1;
+            statement(emit);
+            p = end;
+        }
+        line_start -= (std::ptrdiff_t)p;
+        return p;
+    }
+
+    int version() const { return version_; }
+    int numQubits() const { return qubits; }
+    int numBits() const { return bits; }
+    size_t statements() const { return statements_; }
+    const std::vector<std::pair<int,int>> &measurements() const { return measures; }
+
+    // Qubits of the terminal measures in classical bit order, i.e. what to
+    // sample at the end; bits measured mid-circuit are in the classical
+    // register instead.
+    std::vector<int> readout() const {
+        std::vector<int> out;
+        for(int q: bit_source) if(q >= 0) out.push_back(q);
+        return out;
+    }
+};
+
+// Whole program in memory -> IR (for the optimizing/routing compile path).
+inline CircuitIR parseQasm(std::string_view text, std::vector<int> *readout = nullptr) {
+    CircuitIR ir;
+    QasmParser parser;
+    parser.feed(text, true, [&ir](const Instruction &in) { ir.append(in); });
+    if(readout) *readout = parser.readout();
+    return ir;
+}
+
+// --------------------------
+// Streaming Reader
+// --------------------------
+// Pulls an istream through the parser a chunk at a time. A statement cut by
+// the chunk edge stays in the buffer until the next read completes it, so
+// memory is about one chunk (or the longest statement) whatever the size of
+// the program.
+class QasmReader {
+private:
+    std::istream &in;
+    std::vector<char> buf;
+    size_t fill = 0, chunk;
+    bool done = false;
+    QasmParser qasm;
+
+public:
+    explicit QasmReader(std::istream &in_, size_t chunk_bytes = 1 << 16) : in(in_), buf(chunk_bytes), chunk(chunk_bytes) {}
+
+    // Read one chunk and emit the gates of its complete statements; false
+    // once the input is used up.
+    template<typename Emit>
+    bool next(Emit &&emit) {
+        if(done) return false;
+        if(buf.size() < fill + chunk) buf.resize(fill + chunk); // a statement longer than a chunk
+        in.read(buf.data() + fill, (std::streamsize)chunk);
+        fill += (size_t)in.gcount();
+        if(in.bad()) throw std::runtime_error("QasmReader: read error");
+        done = !in;
+        size_t used = qasm.feed(std::string_view(buf.data(), fill), done, emit);
+        std::memmove(buf.data(), buf.data() + used, fill - used);
+        fill -= used;
+        return true;
+    }
+
+    const QasmParser &parser() const { return qasm; }
+};
+
+// --------------------------
+// Streaming Execution
+// --------------------------
+// Parses on its own thread and hands out moment-scheduled segments (see
+// MomentStream) as they are sealed, so the caller runs the first layers while
+// the rest of the file is still being read. At most max_segments segments
+// wait unrun; with the reader's chunk that bounds memory independently of
+// program length. Streamed gates skip optimization and routing. A parse error
+// surfaces from next() after the segments before it.
+struct QasmStreamOptions {
+    size_t chunk_bytes = 1 << 16;  // read size
+    size_t segment_gates = 4096;   // seal once this many gates are waiting
+    size_t hold_moments = 2;       // newest moments left open at a cut
+    size_t max_segments = 4;       // sealed but unrun, before the parser waits
+};
+
+struct QasmRunReport {
+    size_t gates = 0, depth = 0, segments = 0;
+    double first_pulse_ms = 0;  // call -> first segment dispatched
+    double total_ms = 0;
+    std::vector<int> readout;   // terminally measured qubits in classical bit order
+};
+
+class QasmStream {
+private:
+    struct Cancelled {};
+
+    QasmStreamOptions opts;
+    std::mutex mtx;
+    std::condition_variable ready, space;
+    std::deque<CompiledCircuit> segments;
+    bool finished = false, cancelled = false;
+    std::exception_ptr error;
+    std::vector<int> readout_qubits;
+    int width = 0;
+    std::thread worker; // last: starts once everything above exists
+
+    void hand(CompiledCircuit &&segment) {
+        std::unique_lock<std::mutex> lock(mtx);
+        space.wait(lock, [this]() { return segments.size() < opts.max_segments || cancelled; });
+        if(cancelled) throw Cancelled{};
+        segments.push_back(std::move(segment));
+        ready.notify_one();
+    }
+
+    void parse(std::istream &in) {
+        std::exception_ptr failure;
+        try {
+            QasmReader reader(in, opts.chunk_bytes);
+            MomentStream moments(opts.hold_moments);
+            auto emit = [&](const Instruction &g) {
+                moments.push(g);
+                if(moments.pending() >= opts.segment_gates && moments.openMoments() > opts.hold_moments)
+                    hand(moments.seal(false, reader.parser().numQubits()));
+            };
+            while(reader.next(emit)) {}
+            if(moments.pending()) hand(moments.seal(true, reader.parser().numQubits()));
+            std::lock_guard<std::mutex> guard(mtx);
+            readout_qubits = reader.parser().readout();
+            width = reader.parser().numQubits();
+        } catch(Cancelled &) {
+        } catch(...) { failure = std::current_exception(); }
+        std::lock_guard<std::mutex> guard(mtx);
+        error = failure;
+        finished = true;
+        ready.notify_one();
+    }
+
+public:
+    explicit QasmStream(std::istream &in, QasmStreamOptions opts_ = {}) : opts(opts_) {
+        if(!opts.max_segments) opts.max_segments = 1;
+        worker = std::thread([this, &in]() { parse(in); });
+    }
+
+    ~QasmStream() {
+        { std::lock_guard<std::mutex> guard(mtx); cancelled = true; }
+        space.notify_one();
+        worker.join();
+    }
+
+    // Next segment in program order; false at the end of the program.
+    bool next(CompiledCircuit &segment) {
+        std::unique_lock<std::mutex> lock(mtx);
+        ready.wait(lock, [this]() { return !segments.empty() || finished; });
+        if(!segments.empty()){
+            segment = std::move(segments.front());
+            segments.pop_front();
+            space.notify_one();
+            return true;
+        }
+        if(error) { std::exception_ptr e = error; error = nullptr; std::rethrow_exception(e); }
+        return false;
+    }
+
+    // Valid once next() has returned false.
+    const std::vector<int> &readout() const { return readout_qubits; }
+    int numQubits() const { return width; }
+};
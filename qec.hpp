@@ -0,0 +1,513 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <cstdint>
+#include "circuit_ir.hpp"
+#include "compiler.hpp"
+#include "executor.hpp"
+#include "feedback.hpp"
+#include "metrics.hpp"
+
+// --------------------------
+// QEC Codes
+// --------------------------
+// A code as parity checks over its data qubits, one ancilla per check. Only
+// bit-flip (Z-type) checks are extracted, which is the whole repetition code
+// and the Z half of a surface code; `logical` is the data support of the
+// logical Z readout.
+struct QecCode {
+    int data = 0;
+    std::vector<std::vector<int>> checks; // data qubits of each check
+    std::vector<int> logical;
+    int distance = 0;
+
+    int numChecks() const { return (int)checks.size(); }
+
+    // Distance-d repetition code: check k compares data k and k+1.
+    static QecCode repetition(int d) {
+        if(d < 2) throw std::invalid_argument("QecCode::repetition: distance must be at least 2");
+        QecCode code;
+        code.data = d;
+        code.distance = d;
+        for(int k=0;k+1<d;k++) code.checks.push_back({k, k+1});
+        code.logical = {0};
+        return code;
+    }
+};
+
+// Where a code sits on the device: data qubit i on data[i], check k read out
+// through ancilla[k].
+struct QecLayout {
+    std::vector<int> data, ancilla;
+
+    // Data qubits from `first`, ancillas right after them.
+    static QecLayout contiguous(const QecCode &code, int first = 0) {
+        QecLayout l;
+        for(int i=0;i<code.data;i++) l.data.push_back(first + i);
+        for(int k=0;k<code.numChecks();k++) l.ancilla.push_back(first + code.data + k);
+        return l;
+    }
+};
+
+// --------------------------
+// Streaming Syndrome Decoders
+// --------------------------
+// Fed one round of check outcomes at a time, in order. Corrections are not
+// pulsed back onto the device: they go into a Pauli frame (one flip bit per
+// data qubit) that is applied to the final data readout, so decoding never
+// sits between two rounds. A round marked `perfect` is computed from that
+// readout and has no measurement errors; it ends the run.
+class SyndromeDecoder {
+public:
+    virtual ~SyndromeDecoder() = default;
+    virtual const char *name() const = 0;
+    // New run from a clean code state; clears the frame.
+    virtual void reset() = 0;
+    virtual void push(const uint8_t *syndrome, bool perfect) = 0;
+    // Decode every round still buffered.
+    virtual void flush() {}
+    const std::vector<uint8_t> &frame() const { return flips; }
+
+protected:
+    std::vector<uint8_t> flips;
+};
+
+// Table from syndrome to its lowest-weight data correction, for small codes
+// (d = 3 needs four entries). Each round is decoded on its own against the
+// frame: a measurement error costs a wrong flip that the next round undoes.
+class LookupDecoder : public SyndromeDecoder {
+private:
+    QecCode code;
+    std::vector<uint32_t> table;         // syndrome -> data flip mask
+    std::vector<uint32_t> check_of_data; // data qubit -> mask of its checks
+    uint32_t frame_syndrome = 0;         // syndrome the frame accounts for
+
+public:
+    explicit LookupDecoder(QecCode c) : code(std::move(c)) {
+        int n = code.data, m = code.numChecks();
+        if(n > 20 || m > 16) throw std::invalid_argument("LookupDecoder: code too large for a table (" + std::to_string(n) + " data qubits)");
+        check_of_data.assign(n, 0);
+        for(int k=0;k<m;k++) for(int q: code.checks[k]) check_of_data[q] |= 1u << k;
+        table.assign(size_t(1) << m, 0);
+        std::vector<int> weight(table.size(), n + 1);
+        for(uint32_t e=0;e<(1u << n);e++){
+            uint32_t s = 0;
+            int w = 0;
+            for(int q=0;q<n;q++) if(e >> q & 1) { s ^= check_of_data[q]; w++; }
+            if(w < weight[s]) { weight[s] = w; table[s] = e; }
+        }
+        reset();
+    }
+
+    const char *name() const override { return "lookup"; }
+    void reset() override { flips.assign(code.data, 0); frame_syndrome = 0; }
+
+    void push(const uint8_t *syndrome, bool) override {
+        uint32_t s = 0;
+        for(int k=0;k<code.numChecks();k++) s |= (uint32_t)(syndrome[k] & 1) << k;
+        uint32_t e = table[s ^ frame_syndrome];
+        for(int q=0;q<code.data;q++) if(e >> q & 1) { flips[q] ^= 1; frame_syndrome ^= check_of_data[q]; }
+    }
+};
+
+// Union-find decoder (Delfosse-Nickerson) over the space-time graph of a
+// sliding window of rounds. Nodes are (round, check) detection events, i.e.
+// changes of a check against the round before; a space edge is a data qubit
+// flipping (to the boundary if it is in one check only), a time edge a
+// measurement error. Clusters grow from odd defects by half an edge per step
+// until every cluster is even or touches the boundary, then a spanning
+// forest is peeled into a correction.
+//
+// Once `window` rounds are buffered the window is decoded and the oldest
+// `commit` rounds are final; the rest are decoded again with the next rounds
+// in view, so an error near the window's top is not matched in the dark.
+// Needs every data qubit in at most two checks.
+class UnionFindDecoder : public SyndromeDecoder {
+private:
+    struct Edge { int a, b; int data; }; // data < 0: time edge on check -data-1
+
+    QecCode code;
+    int m, window, commit;
+    std::vector<std::vector<int>> checks_of; // data qubit -> its checks
+    std::vector<uint8_t> rounds;             // buffered syndromes, m per round
+    bool last_perfect = false;
+    std::vector<uint8_t> baseline;           // round before the buffer, frame and measurement errors removed
+    std::vector<uint8_t> frame_syndrome;     // per check: parity of the frame's flips
+
+    // Scratch reused across windows.
+    std::vector<Edge> edges;
+    std::vector<int> adj_start, adj;
+    std::vector<int> parent;
+    std::vector<uint8_t> odd, boundary, defect, support, seen;
+    std::vector<int> fused, order, via;
+    std::vector<uint8_t> meas_flip;
+    int graph_rounds = -1;                   // rounds the edge lists were built for
+
+    int find(int x) {
+        while(parent[x] != x) { parent[x] = parent[parent[x]]; x = parent[x]; }
+        return x;
+    }
+    void unite(int a, int b) {
+        a = find(a); b = find(b);
+        if(a == b) return;
+        parent[b] = a;
+        odd[a] ^= odd[b];
+        boundary[a] |= boundary[b];
+    }
+
+    void buildGraph(int R) {
+        if(R == graph_rounds) return;
+        graph_rounds = R;
+        int B = R*m;
+        edges.clear();
+        for(int t=0;t<R;t++){
+            for(int q=0;q<code.data;q++){
+                const std::vector<int> &c = checks_of[q];
+                if(c.empty()) continue;
+                edges.push_back({t*m + c[0], c.size() == 2 ? t*m + c[1] : B, q});
+            }
+            if(t+1 < R) for(int k=0;k<m;k++) edges.push_back({t*m + k, (t+1)*m + k, -k-1});
+        }
+        adj_start.assign(B + 2, 0);
+        for(const Edge &e: edges) { adj_start[e.a+1]++; adj_start[e.b+1]++; }
+        for(int v=0;v<=B;v++) adj_start[v+1] += adj_start[v];
+        adj.resize(2*edges.size());
+        std::vector<int> &fill = order; // free until peeling
+        fill.assign(adj_start.begin(), adj_start.end() - 1);
+        for(int i=0;i<(int)edges.size();i++) { adj[fill[edges[i].a]++] = i; adj[fill[edges[i].b]++] = i; }
+    }
+
+    // Decode the first R buffered rounds; commit the corrections of the
+    // oldest C and drop them from the buffer.
+    void decodeWindow(int R, int C) {
+        int B = R*m, N = B + 1;
+        buildGraph(R);
+        defect.assign(N, 0);
+        for(int t=0;t<R;t++)
+            for(int k=0;k<m;k++){
+                uint8_t now = rounds[t*m + k] ^ frame_syndrome[k];
+                uint8_t before = t ? rounds[(t-1)*m + k] ^ frame_syndrome[k] : baseline[k];
+                defect[t*m + k] = now ^ before;
+            }
+
+        // Grow
+        parent.resize(N);
+        for(int v=0;v<N;v++) parent[v] = v;
+        odd.assign(defect.begin(), defect.end());
+        boundary.assign(N, 0);
+        boundary[B] = 1;
+        support.assign(edges.size(), 0);
+        for(;;){
+            fused.clear();
+            bool grew = false;
+            for(int i=0;i<(int)edges.size();i++){
+                if(support[i] == 2) continue;
+                int ra = find(edges[i].a), rb = find(edges[i].b);
+                int g = (odd[ra] && !boundary[ra]) + (odd[rb] && !boundary[rb]);
+                if(!g) continue;
+                grew = true;
+                support[i] = (uint8_t)std::min(2, support[i] + g);
+                if(support[i] == 2) fused.push_back(i);
+            }
+            if(!grew) break;
+            for(int i: fused) unite(edges[i].a, edges[i].b);
+        }
+
+        // Peel a spanning forest of the grown edges, boundary trees first
+        seen.assign(N, 0);
+        via.assign(N, -1);
+        order.clear();
+        auto tree = [&](int root) {
+            size_t head = order.size();
+            order.push_back(root);
+            seen[root] = 1;
+            while(head < order.size()){
+                int v = order[head++];
+                for(int j=adj_start[v];j<adj_start[v+1];j++){
+                    int i = adj[j];
+                    if(support[i] != 2) continue;
+                    int u = edges[i].a == v ? edges[i].b : edges[i].a;
+                    if(seen[u]) continue;
+                    seen[u] = 1;
+                    via[u] = i;
+                    order.push_back(u);
+                }
+            }
+        };
+        tree(B);
+        for(int v=0;v<B;v++) if(!seen[v] && defect[v]) tree(v);
+        meas_flip.assign(m, 0);
+        for(size_t n=order.size();n-- > 0;){
+            int v = order[n];
+            if(via[v] < 0 || !defect[v]) continue;
+            const Edge &e = edges[via[v]];
+            int u = e.a == v ? e.b : e.a;
+            defect[v] = 0;
+            defect[u] ^= 1;
+            int t = std::min(e.a, e.b) / m;
+            if(t >= C) continue; // decided again in the next window
+            if(e.data >= 0) { flips[e.data] ^= 1; for(int k: checks_of[e.data]) frame_syndrome[k] ^= 1; }
+            else if(t == C-1) meas_flip[-e.data-1] ^= 1;
+        }
+
+        for(int k=0;k<m;k++) baseline[k] = rounds[(C-1)*m + k] ^ frame_syndrome[k] ^ meas_flip[k];
+        rounds.erase(rounds.begin(), rounds.begin() + (size_t)C*m);
+    }
+
+public:
+    // window/commit of 0: 2d and d rounds.
+    explicit UnionFindDecoder(QecCode c, int window_ = 0, int commit_ = 0) : code(std::move(c)), m(code.numChecks()) {
+        window = window_ ? window_ : std::max(2, 2*code.distance);
+        commit = commit_ ? commit_ : std::max(1, window/2);
+        if(commit > window) throw std::invalid_argument("UnionFindDecoder: commit larger than the window");
+        checks_of.assign(code.data, {});
+        for(int k=0;k<m;k++) for(int q: code.checks[k]) checks_of[q].push_back(k);
+        for(int q=0;q<code.data;q++)
+            if(checks_of[q].size() > 2) throw std::invalid_argument("UnionFindDecoder: data qubit " + std::to_string(q) + " is in more than two checks");
+        reset();
+    }
+
+    const char *name() const override { return "union_find"; }
+
+    void reset() override {
+        flips.assign(code.data, 0);
+        rounds.clear();
+        baseline.assign(m, 0);
+        frame_syndrome.assign(m, 0);
+        last_perfect = false;
+    }
+
+    void push(const uint8_t *syndrome, bool perfect) override {
+        if(last_perfect) throw std::logic_error("UnionFindDecoder: round after the final readout");
+        rounds.insert(rounds.end(), syndrome, syndrome + m);
+        last_perfect = perfect;
+        if(perfect) flush();
+        else if((int)(rounds.size() / m) >= window) decodeWindow(window, commit);
+    }
+
+    void flush() override {
+        int R = (int)(rounds.size() / m);
+        if(R) decodeWindow(R, R);
+    }
+
+    int windowRounds() const { return window; }
+    int commitRounds() const { return commit; }
+};
+
+// Lookup table up to d = 3, union-find beyond.
+inline std::unique_ptr<SyndromeDecoder> makeDecoder(const QecCode &code) {
+    if(code.distance <= 3 && code.data <= 20) return std::make_unique<LookupDecoder>(code);
+    return std::make_unique<UnionFindDecoder>(code);
+}
+
+// --------------------------
+// QEC Cycle Engine
+// --------------------------
+// Keeps a logical qubit alive by repeated syndrome extraction. One round
+// entangles every check's ancilla with its data qubits, reads the ancillas
+// mid-circuit and resets them by feedback (measure + conditional X, see
+// feedback.hpp), so the data qubits are never measured until readout().
+//
+// Rounds run on the caller's thread; their syndromes go through an SPSC ring
+// to a decoder thread, so extraction never waits for decoding unless the
+// ring fills. The time from a round's readout to the decoder having taken it
+// is recorded as HwOp::Decode; stats() has the backlog (rounds extracted but
+// not decoded yet), which stays near zero while the decoder keeps up. With a
+// single core the thread could only run while extraction waits, so rounds
+// are then decoded inline instead.
+struct QecEngineOptions {
+    int module = 0;               // metrics label
+    size_t queue_rounds = 1024;   // syndrome ring capacity
+    bool decode_inline = std::thread::hardware_concurrency() <= 1;
+};
+
+struct QecStats {
+    uint64_t rounds = 0;       // syndrome rounds extracted
+    uint64_t decoded = 0;
+    uint64_t backlog = 0, max_backlog = 0;
+    double mean_cycle_us = 0;  // one extraction round on the device
+};
+
+class QecCycleEngine {
+public:
+    // Run a circuit on the device from its current state and return its
+    // classical register, e.g. qc.run(c) then qc.classicalBits().
+    using Runner = std::function<const ClassicalRegister &(const CompiledCircuit &circuit)>;
+
+    static constexpr int max_checks = 256;
+
+private:
+    struct Round {
+        int64_t measured_ns = 0;
+        bool perfect = false;
+        uint8_t syndrome[max_checks];
+    };
+
+    QecCode code;
+    QecLayout layout;
+    Runner run;
+    std::unique_ptr<SyndromeDecoder> decoder;
+    QecEngineOptions opts;
+    CompiledCircuit round_circuit, readout_circuit;
+
+    uint64_t pushed = 0;                  // producer only
+    QecStats counters;                    // producer only
+    double cycle_us_sum = 0;
+    SpscQueue<Round> queue;
+    alignas(64) std::atomic<uint64_t> decoded{0};
+    std::atomic<bool> sleeping{false}, waiting{false}, stopping{false};
+    std::exception_ptr error;             // decoder failure, read once idle
+    std::mutex mtx;
+    std::condition_variable wake, done;
+    std::thread worker;                   // last: uses everything above
+
+    static int64_t now() { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+    void decodeLoop() {
+        Round r;
+        for(;;){
+            int idle = 0;
+            while(!queue.tryPop(r)){
+                if(stopping.load(std::memory_order_acquire) && queue.empty()) return;
+                if(++idle < 64) { std::this_thread::yield(); continue; }
+                std::unique_lock<std::mutex> lock(mtx);
+                sleeping.store(true);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                wake.wait(lock, [this]() { return !queue.empty() || stopping.load(); });
+                sleeping.store(false);
+                idle = 0;
+            }
+            if(!error){
+                try { decode(r); }
+                catch(...) { error = std::current_exception(); }
+            }
+            decoded.fetch_add(1, std::memory_order_seq_cst);
+            if(waiting.load()) { std::lock_guard<std::mutex> guard(mtx); done.notify_one(); }
+        }
+    }
+
+    void decode(const Round &r) {
+        decoder->push(r.syndrome, r.perfect);
+        if(metrics().isEnabled()) metrics().record(HwOp::Decode, opts.module, -1, (uint64_t)(now() - r.measured_ns));
+    }
+
+    void hand(const Round &r) {
+        if(opts.decode_inline) { decode(r); pushed++; decoded.store(pushed, std::memory_order_relaxed); return; }
+        while(!queue.tryPush(r)) std::this_thread::yield();
+        pushed++;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(sleeping.load()) { std::lock_guard<std::mutex> guard(mtx); wake.notify_one(); }
+        uint64_t backlog = pushed - decoded.load(std::memory_order_acquire);
+        counters.max_backlog = std::max(counters.max_backlog, backlog);
+    }
+
+    // Block until the decoder has taken every round; rethrows its failure.
+    void drain() {
+        for(int spin=0;decoded.load(std::memory_order_acquire) != pushed && spin<64;spin++) std::this_thread::yield();
+        if(decoded.load(std::memory_order_acquire) != pushed){
+            std::unique_lock<std::mutex> lock(mtx);
+            waiting.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            done.wait(lock, [this]() { return decoded.load() == pushed; });
+            waiting.store(false);
+        }
+        if(error) { std::exception_ptr e = error; error = nullptr; std::rethrow_exception(e); }
+    }
+
+public:
+    // A null decoder picks one by distance (makeDecoder).
+    QecCycleEngine(QecCode code_, QecLayout layout_, Runner run_, std::unique_ptr<SyndromeDecoder> decoder_ = nullptr, QecEngineOptions opts_ = {})
+        : code(std::move(code_)), layout(std::move(layout_)), run(std::move(run_)), decoder(std::move(decoder_)), opts(opts_), queue(opts.decode_inline ? 2 : opts.queue_rounds) {
+        if(code.numChecks() > max_checks) throw std::invalid_argument("QecCycleEngine: more than " + std::to_string(max_checks) + " checks");
+        if((int)layout.data.size() != code.data || (int)layout.ancilla.size() != code.numChecks())
+            throw std::invalid_argument("QecCycleEngine: layout does not match the code");
+        if(!decoder) decoder = makeDecoder(code);
+        CircuitIR round, readout;
+        for(int k=0;k<code.numChecks();k++){
+            int a = layout.ancilla[k];
+            for(int q: code.checks[k]) round.cnot(layout.data[q], a);
+            round.measure(a, k);
+            round.when(k).x(a);
+        }
+        for(int q=0;q<code.data;q++) readout.measure(layout.data[q], q);
+        CompileOptions exact;
+        exact.optimize = false; // the round is exactly what was asked for
+        round_circuit = compile(round, exact);
+        readout_circuit = compile(readout, exact);
+        if(!opts.decode_inline) worker = std::thread([this]() { decodeLoop(); });
+    }
+
+    ~QecCycleEngine() {
+        { std::lock_guard<std::mutex> guard(mtx); stopping = true; }
+        wake.notify_one();
+        if(worker.joinable()) worker.join();
+    }
+
+    QecCycleEngine(const QecCycleEngine&) = delete;
+    QecCycleEngine &operator=(const QecCycleEngine&) = delete;
+
+    // Start a logical run: the data qubits must be in a code state (all
+    // |0> after reset encodes |0>_L).
+    void start() {
+        drain();
+        decoder->reset();
+    }
+
+    // Extract `rounds` syndrome rounds.
+    void cycle(int rounds = 1) {
+        Round r;
+        for(int i=0;i<rounds;i++){
+            auto t0 = std::chrono::steady_clock::now();
+            const ClassicalRegister &bits = run(round_circuit);
+            r.measured_ns = now();
+            cycle_us_sum += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+            for(int k=0;k<code.numChecks();k++) r.syndrome[k] = (uint8_t)bits.get(k);
+            counters.rounds++;
+            hand(r);
+        }
+    }
+
+    // Measure the data qubits and return the decoded logical bit. The final
+    // check values come from the data readout itself, as a perfect round.
+    int readout() {
+        const ClassicalRegister &bits = run(readout_circuit);
+        std::vector<uint8_t> data(code.data);
+        for(int q=0;q<code.data;q++) data[q] = (uint8_t)bits.get(q);
+        Round r;
+        r.measured_ns = now();
+        r.perfect = true;
+        for(int k=0;k<code.numChecks();k++){
+            uint8_t s = 0;
+            for(int q: code.checks[k]) s ^= data[q];
+            r.syndrome[k] = s;
+        }
+        hand(r);
+        drain();
+        int logical = 0;
+        for(int q: code.logical) logical ^= data[q] ^ decoder->frame()[q];
+        return logical;
+    }
+
+    QecStats stats() const {
+        QecStats s = counters;
+        s.decoded = decoded.load(std::memory_order_acquire);
+        s.backlog = pushed - s.decoded;
+        s.mean_cycle_us = s.rounds ? cycle_us_sum / s.rounds : 0.0;
+        return s;
+    }
+
+    const QecCode &qecCode() const { return code; }
+    const QecLayout &qecLayout() const { return layout; }
+    const SyndromeDecoder &syndromeDecoder() const { return *decoder; }
+    const CompiledCircuit &roundCircuit() const { return round_circuit; }
+};
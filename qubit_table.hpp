@@ -0,0 +1,119 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <limits>
+#include <cstdint>
+#include <stdexcept>
+#include "calibration.hpp"
+#include "link_scheduler.hpp"
+
+// --------------------------
+// Global Qubit Table
+// --------------------------
+// Every qubit of the machine under one index: module 0's qubits first, then
+// module 1's, and so on, which is also the order placement lays logical
+// qubits out in. Index <-> (module, qubit) is O(1) both ways.
+//
+// Per-qubit state is a structure of arrays, one contiguous column per field,
+// so a scan over one field (calibrated flags at dispatch, ages and error
+// rates in a health sweep) streams through that column only. Modules keep no
+// state of their own and address their rows from base(module). Calibration
+// lines and module executors each write their own elements, so concurrent
+// writers never share one; readers outside them go through a sync() first.
+class QubitTable {
+private:
+    std::vector<int32_t> module_base; // first global index of each module, plus the end
+    std::vector<uint16_t> owner;      // global index -> module
+
+    void check(int g) const {
+        if(g < 0 || g >= (int)owner.size()) throw std::out_of_range("QubitTable: qubit " + std::to_string(g) + " out of range");
+    }
+
+public:
+    static constexpr float unknown = std::numeric_limits<float>::quiet_NaN();
+
+    std::vector<uint8_t> calibrated;
+    std::vector<uint8_t> status;         // CalibrationStatus
+    std::vector<uint64_t> epoch;         // calibration pass that last set the row
+    std::vector<int64_t> calibrated_ms;  // wall clock of the last calibration
+    std::vector<int64_t> last_used_ms;   // wall clock of the last pulse
+    std::vector<float> frequency_ghz;
+    std::vector<float> pi_amplitude;
+    std::vector<float> t1_us, t2_us;     // unknown until characterized
+    std::vector<float> gate_error, readout_error;
+
+    QubitTable() : module_base{0} {}
+
+    // Rows for a new module of `qubits` qubits; returns the module's base index.
+    int addModule(int qubits) {
+        if(modules() >= std::numeric_limits<uint16_t>::max()) throw std::length_error("QubitTable: too many modules");
+        int base = (int)owner.size(), n = base + qubits;
+        owner.resize(n, (uint16_t)modules());
+        module_base.push_back(n);
+        calibrated.resize(n, 0);
+        status.resize(n, Uncalibrated);
+        epoch.resize(n, 0);
+        calibrated_ms.resize(n, 0);
+        last_used_ms.resize(n, 0);
+        frequency_ghz.resize(n, 0);
+        pi_amplitude.resize(n, 0);
+        t1_us.resize(n, unknown);
+        t2_us.resize(n, unknown);
+        gate_error.resize(n, unknown);
+        readout_error.resize(n, unknown);
+        return base;
+    }
+
+    int size() const { return (int)owner.size(); }
+    int modules() const { return (int)module_base.size() - 1; }
+    int base(int module) const { return module_base[module]; }
+    int width(int module) const { return module_base[module+1] - module_base[module]; }
+
+    QubitRef locate(int g) const {
+        check(g);
+        int m = owner[g];
+        return {m, g - module_base[m]};
+    }
+    int global(int module, int q) const {
+        if(module < 0 || module >= modules() || q < 0 || q >= width(module))
+            throw std::out_of_range("QubitTable: no qubit " + std::to_string(q) + " on module " + std::to_string(module));
+        return module_base[module] + q;
+    }
+    int global(QubitRef r) const { return global(r.module, r.qubit); }
+
+    // Row <-> snapshot record.
+    void setCalibration(int g, const QubitCalibration &c, uint64_t pass) {
+        frequency_ghz[g] = c.frequency_ghz;
+        pi_amplitude[g] = c.pi_amplitude;
+        calibrated_ms[g] = c.timestamp_ms;
+        status[g] = c.status;
+        epoch[g] = pass;
+        calibrated[g] = c.status == Calibrated;
+    }
+    QubitCalibration calibration(int g) const {
+        QubitCalibration c;
+        c.timestamp_ms = calibrated_ms[g];
+        c.frequency_ghz = frequency_ghz[g];
+        c.pi_amplitude = pi_amplitude[g];
+        c.status = status[g];
+        return c;
+    }
+
+    void setCharacterization(int g, float t1, float t2, float gate_err, float readout_err) {
+        check(g);
+        t1_us[g] = t1; t2_us[g] = t2;
+        gate_error[g] = gate_err; readout_error[g] = readout_err;
+    }
+
+    // Qubits due for recalibration at `now`: uncalibrated, calibrated more
+    // than `max_age_ms` ago, or with a known gate/readout error above
+    // `max_error`. Only those four columns are read.
+    std::vector<int> needsRecalibration(int64_t now, int64_t max_age_ms, float max_error) const {
+        std::vector<int> due;
+        for(int g=0;g<size();g++){
+            bool stale = !calibrated[g] || now - calibrated_ms[g] > max_age_ms;
+            if(stale || gate_error[g] > max_error || readout_error[g] > max_error) due.push_back(g);
+        }
+        return due;
+    }
+};
@@ -0,0 +1,402 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+#include "shots.hpp"
+#include "logger.hpp"
+#if defined(QC_HAVE_ZSTD)
+#include <zstd.h>
+#endif
+#if defined(QC_HAVE_LZ4)
+#include <lz4.h>
+#endif
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// --------------------------
+// Binary Result Store
+// --------------------------
+// Shot data as packed bit columns instead of JSON maps. A file is a sequence
+// of self-contained records, one per measurement:
+//
+//   RecordHeader | int32 qubit map (padded to 8) | chunk...
+//   chunk = ChunkHeader | payload (padded to 8)
+//
+// A chunk holds up to chunk_shots shots. Its raw payload is one column per
+// measured qubit, ceil(shots/64) words each, bit s of the column is shot s.
+// Everything stays 8-byte aligned, so an uncompressed chunk is read straight
+// out of the mapping as uint64_t words. Chunks may be compressed with zstd or
+// LZ4 when the build provides them (QC_HAVE_ZSTD / QC_HAVE_LZ4); uncompressed
+// chunks are always readable. Integers are little-endian, as written by the host.
+namespace result_store {
+
+enum Codec : uint8_t { None = 0, Zstd = 1, LZ4 = 2 };
+
+struct RecordHeader {
+    char magic[4];            // "QCR1"
+    uint32_t header_bytes;    // sizeof(RecordHeader), for forward compatibility
+    uint64_t record_bytes;    // whole record including this header
+    uint64_t circuit_hash;    // structuralHash of the last circuit run, 0 if none
+    uint64_t calibration_epoch;
+    uint64_t timestamp_ms;
+    uint64_t shots;
+    uint64_t sequence;        // per-writer record number, referenced from the JSON log
+    uint32_t num_qubits;
+    uint32_t chunk_shots;
+    uint32_t num_chunks;
+    uint32_t reserved;
+};
+
+struct ChunkHeader {
+    uint32_t shots;
+    uint8_t codec;
+    uint8_t pad[3];
+    uint64_t raw_bytes;
+    uint64_t stored_bytes;    // payload size before padding
+};
+
+inline size_t pad8(size_t n) { return (n + 7) & ~(size_t)7; }
+
+inline bool codecAvailable(Codec c) {
+    if(c == None) return true;
+#if defined(QC_HAVE_ZSTD)
+    if(c == Zstd) return true;
+#endif
+#if defined(QC_HAVE_LZ4)
+    if(c == LZ4) return true;
+#endif
+    return false;
+}
+
+// Columns for shots [first, first+n) of a shot-major buffer.
+inline void toColumns(const ShotBuffer &buf, size_t first, size_t n, std::vector<uint64_t> &cols) {
+    size_t col_words = (n+63)/64;
+    cols.assign(buf.width()*col_words, 0);
+    uint64_t tile[64];
+    for(size_t b=0;b<col_words;b++){
+        size_t rows = std::min<size_t>(64, n - b*64);
+        for(size_t w=0;w<buf.wordsPerShot();w++){
+            for(size_t r=0;r<64;r++) tile[r] = r < rows ? buf.shot(first + b*64 + r)[w] : 0;
+            transpose64(tile);
+            for(size_t c=0;c<64 && w*64+c<buf.width();c++) cols[(w*64+c)*col_words + b] = tile[c];
+        }
+    }
+}
+
+// Compress `raw` into `out` with `codec`; returns false (and leaves out as
+// is) if the codec is unavailable or the data did not shrink.
+inline bool compress(Codec codec, const char *raw, size_t n, std::string &out, int level) {
+#if defined(QC_HAVE_ZSTD)
+    if(codec == Zstd) {
+        std::string tmp(ZSTD_compressBound(n), '\0');
+        size_t got = ZSTD_compress(&tmp[0], tmp.size(), raw, n, level);
+        if(ZSTD_isError(got) || got >= n) return false;
+        out.append(tmp.data(), got);
+        return true;
+    }
+#endif
+#if defined(QC_HAVE_LZ4)
+    if(codec == LZ4) {
+        std::string tmp(LZ4_compressBound((int)n), '\0');
+        int got = LZ4_compress_default(raw, &tmp[0], (int)n, (int)tmp.size());
+        if(got <= 0 || (size_t)got >= n) return false;
+        out.append(tmp.data(), got);
+        return true;
+    }
+#endif
+    (void)codec; (void)raw; (void)n; (void)out; (void)level;
+    return false;
+}
+
+inline void decompress(Codec codec, const char *src, size_t n, char *dst, size_t raw_bytes) {
+#if defined(QC_HAVE_ZSTD)
+    if(codec == Zstd) {
+        size_t got = ZSTD_decompress(dst, raw_bytes, src, n);
+        if(ZSTD_isError(got) || got != raw_bytes) throw std::runtime_error("results: corrupt zstd chunk");
+        return;
+    }
+#endif
+#if defined(QC_HAVE_LZ4)
+    if(codec == LZ4) {
+        int got = LZ4_decompress_safe(src, dst, (int)n, (int)raw_bytes);
+        if(got < 0 || (size_t)got != raw_bytes) throw std::runtime_error("results: corrupt LZ4 chunk");
+        return;
+    }
+#endif
+    (void)src; (void)n; (void)dst; (void)raw_bytes;
+    throw std::runtime_error("results: chunk codec " + std::to_string((int)codec) + " not built in");
+}
+
+struct RecordInfo {
+    uint64_t circuit_hash = 0;
+    uint64_t calibration_epoch = 0;
+    uint64_t timestamp_ms = 0;
+    uint64_t sequence = 0;
+};
+
+struct WriterOptions {
+    uint32_t chunk_shots = 4096; // rounded up to a multiple of 64
+    Codec codec = None;          // falls back to None per chunk if unavailable or not smaller
+    int level = 3;               // zstd level
+};
+
+inline std::string encodeRecord(const ShotBuffer &buf, const RecordInfo &info, const WriterOptions &opts = {}) {
+    uint32_t chunk = std::max<uint32_t>(64, (opts.chunk_shots + 63) / 64 * 64);
+    RecordHeader h{};
+    std::memcpy(h.magic, "QCR1", 4);
+    h.header_bytes = sizeof(RecordHeader);
+    h.circuit_hash = info.circuit_hash;
+    h.calibration_epoch = info.calibration_epoch;
+    h.timestamp_ms = info.timestamp_ms;
+    h.shots = buf.shots();
+    h.sequence = info.sequence;
+    h.num_qubits = (uint32_t)buf.width();
+    h.chunk_shots = chunk;
+    h.num_chunks = (uint32_t)((buf.shots() + chunk - 1) / chunk);
+
+    std::string out(sizeof(RecordHeader), '\0');
+    out.append(reinterpret_cast<const char*>(buf.qubits().data()), buf.width()*sizeof(int32_t));
+    out.resize(pad8(out.size()), '\0');
+    std::vector<uint64_t> cols;
+    for(size_t first=0;first<buf.shots();first+=chunk){
+        size_t n = std::min<size_t>(chunk, buf.shots() - first);
+        toColumns(buf, first, n, cols);
+        const char *raw = reinterpret_cast<const char*>(cols.data());
+        ChunkHeader c{};
+        c.shots = (uint32_t)n;
+        c.raw_bytes = cols.size()*8;
+        size_t at = out.size();
+        out.resize(at + sizeof(ChunkHeader));
+        if(opts.codec != None && compress(opts.codec, raw, c.raw_bytes, out, opts.level)) c.codec = opts.codec;
+        else { c.codec = None; out.append(raw, c.raw_bytes); }
+        c.stored_bytes = out.size() - at - sizeof(ChunkHeader);
+        std::memcpy(&out[at], &c, sizeof(c));
+        out.resize(pad8(out.size()), '\0');
+    }
+    h.record_bytes = out.size();
+    std::memcpy(&out[0], &h, sizeof(h));
+    return out;
+}
+
+// One chunk's columns. Points into the mapping for uncompressed chunks, into
+// the reader's scratch buffer otherwise (valid until the next chunk() call).
+struct ColumnChunk {
+    const uint64_t *words = nullptr;
+    size_t shots = 0;
+    size_t num_qubits = 0;
+    size_t words_per_column = 0;
+
+    const uint64_t *column(size_t i) const { return words + i*words_per_column; }
+    int get(size_t shot, size_t i) const { return (column(i)[shot>>6] >> (shot & 63)) & 1; }
+};
+
+class ResultRecord {
+private:
+    const RecordHeader *h;
+    const int32_t *map;
+    std::vector<const ChunkHeader*> chunks;
+    friend class ResultFile;
+
+public:
+    uint64_t circuitHash() const { return h->circuit_hash; }
+    uint64_t calibrationEpoch() const { return h->calibration_epoch; }
+    uint64_t timestampMs() const { return h->timestamp_ms; }
+    uint64_t shots() const { return h->shots; }
+    uint64_t sequence() const { return h->sequence; }
+    size_t width() const { return h->num_qubits; }
+    int qubit(size_t i) const { return map[i]; }
+    std::vector<int> qubits() const { return std::vector<int>(map, map + h->num_qubits); }
+    size_t numChunks() const { return chunks.size(); }
+    bool compressed(size_t c) const { return chunks[c]->codec != None; }
+
+    ColumnChunk chunk(size_t c, std::vector<uint64_t> &scratch) const {
+        const ChunkHeader *ch = chunks[c];
+        const char *payload = reinterpret_cast<const char*>(ch + 1);
+        ColumnChunk out;
+        out.shots = ch->shots;
+        out.num_qubits = h->num_qubits;
+        out.words_per_column = (ch->shots + 63) / 64;
+        if(ch->raw_bytes != out.num_qubits * out.words_per_column * 8) throw std::runtime_error("results: chunk size mismatch");
+        if(ch->codec == None) { out.words = reinterpret_cast<const uint64_t*>(payload); return out; }
+        scratch.resize(ch->raw_bytes / 8);
+        decompress((Codec)ch->codec, payload, ch->stored_bytes, reinterpret_cast<char*>(scratch.data()), ch->raw_bytes);
+        out.words = scratch.data();
+        return out;
+    }
+
+    // Number of shots per qubit that read 1, straight from the columns.
+    std::vector<uint64_t> ones() const {
+        std::vector<uint64_t> count(width(), 0), scratch;
+        for(size_t c=0;c<numChunks();c++){
+            ColumnChunk ch = chunk(c, scratch);
+            for(size_t i=0;i<ch.num_qubits;i++)
+                for(size_t w=0;w<ch.words_per_column;w++) count[i] += popcount64(ch.column(i)[w]);
+        }
+        return count;
+    }
+
+    // Back to the in-memory shot-major form.
+    ShotBuffer toShotBuffer() const {
+        ShotBuffer buf(qubits(), h->shots);
+        std::vector<uint64_t> scratch;
+        uint64_t tile[64];
+        size_t base = 0;
+        for(size_t c=0;c<numChunks();c++){
+            ColumnChunk ch = chunk(c, scratch);
+            for(size_t b=0;b<ch.words_per_column;b++){
+                size_t n = std::min<size_t>(64, ch.shots - b*64);
+                for(size_t w=0;w<buf.wordsPerShot();w++){
+                    for(size_t q=0;q<64;q++) tile[q] = w*64+q < buf.width() ? ch.column(w*64+q)[b] : 0;
+                    transpose64(tile);
+                    for(size_t r=0;r<n;r++) buf.shot(base + b*64 + r)[w] = tile[r];
+                }
+            }
+            base += ch.shots;
+        }
+        return buf;
+    }
+};
+
+// Read-only memory map of a result file, indexed on open (headers only).
+class ResultFile {
+private:
+    const char *base = nullptr;
+    size_t length = 0;
+    std::vector<ResultRecord> recs;
+#if defined(_WIN32)
+    HANDLE file = INVALID_HANDLE_VALUE, mapping = nullptr;
+#endif
+
+    void unmap() {
+#if defined(_WIN32)
+        if(base) UnmapViewOfFile(base);
+        if(mapping) CloseHandle(mapping);
+        if(file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if(base) munmap(const_cast<char*>(base), length);
+#endif
+        base = nullptr;
+    }
+
+    void index() {
+        size_t at = 0;
+        while(at < length){
+            if(length - at < sizeof(RecordHeader)) throw std::runtime_error("results: truncated record header");
+            const RecordHeader *h = reinterpret_cast<const RecordHeader*>(base + at);
+            if(std::memcmp(h->magic, "QCR1", 4) != 0) throw std::runtime_error("results: bad magic at offset " + std::to_string(at));
+            if(h->record_bytes > length - at) throw std::runtime_error("results: truncated record");
+            // Every size is checked against the record before it is followed,
+            // so a corrupt header can neither stall the scan nor point outside it.
+            if(h->header_bytes < sizeof(RecordHeader) || h->header_bytes > h->record_bytes) throw std::runtime_error("results: truncated record at offset " + std::to_string(at));
+            size_t data = pad8(h->header_bytes + (uint64_t)h->num_qubits*sizeof(int32_t));
+            if(h->record_bytes < data || h->record_bytes % 8) throw std::runtime_error("results: truncated record at offset " + std::to_string(at));
+            size_t end = at + h->record_bytes;
+            ResultRecord r;
+            r.h = h;
+            r.map = reinterpret_cast<const int32_t*>(base + at + h->header_bytes);
+            if(h->chunk_shots == 0 || h->num_chunks != (h->shots + h->chunk_shots - 1) / h->chunk_shots)
+                throw std::runtime_error("results: chunk count does not match the shot count at offset " + std::to_string(at));
+            size_t c = at + data;
+            uint64_t shots = 0;
+            for(uint32_t k=0;k<h->num_chunks;k++){
+                if(end - c < sizeof(ChunkHeader)) throw std::runtime_error("results: chunk runs past its record");
+                const ChunkHeader *ch = reinterpret_cast<const ChunkHeader*>(base + c);
+                if(ch->stored_bytes > end - c - sizeof(ChunkHeader)) throw std::runtime_error("results: chunk runs past its record");
+                if(ch->codec == None && ch->stored_bytes != ch->raw_bytes) throw std::runtime_error("results: chunk size mismatch");
+                if(ch->shots > h->chunk_shots) throw std::runtime_error("results: chunk larger than the record's chunk size");
+                shots += ch->shots;
+                r.chunks.push_back(ch);
+                c += pad8(sizeof(ChunkHeader) + ch->stored_bytes);
+            }
+            if(shots != h->shots) throw std::runtime_error("results: chunk shots do not add up to the record's at offset " + std::to_string(at));
+            recs.push_back(std::move(r));
+            at += h->record_bytes;
+        }
+    }
+
+public:
+    explicit ResultFile(const std::string &path) {
+#if defined(_WIN32)
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if(file == INVALID_HANDLE_VALUE) throw std::runtime_error("results: cannot open " + path);
+        LARGE_INTEGER size;
+        GetFileSizeEx(file, &size);
+        length = (size_t)size.QuadPart;
+        if(length) {
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            base = mapping ? static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+            if(!base) { unmap(); throw std::runtime_error("results: cannot map " + path); }
+        }
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0) throw std::runtime_error("results: cannot open " + path);
+        struct stat st;
+        if(fstat(fd, &st) != 0) { ::close(fd); throw std::runtime_error("results: cannot stat " + path); }
+        length = (size_t)st.st_size;
+        if(length) {
+            void *p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(p == MAP_FAILED) { ::close(fd); throw std::runtime_error("results: cannot map " + path); }
+            base = static_cast<const char*>(p);
+            madvise(p, length, MADV_SEQUENTIAL);
+        }
+        ::close(fd);
+#endif
+        try { index(); } catch(...) { unmap(); throw; }
+    }
+    ~ResultFile() { unmap(); }
+    ResultFile(const ResultFile&) = delete;
+    ResultFile &operator=(const ResultFile&) = delete;
+
+    size_t size() const { return recs.size(); }
+    const ResultRecord &operator[](size_t i) const { return recs[i]; }
+    std::vector<ResultRecord>::const_iterator begin() const { return recs.begin(); }
+    std::vector<ResultRecord>::const_iterator end() const { return recs.end(); }
+};
+
+// Sequence number for the next record appended to `path`: one past the
+// highest already in it, 0 for a new or empty file.
+inline uint64_t nextSequence(const std::string &path) {
+    if(!std::ifstream(path, std::ios::binary)) return 0;
+    ResultFile existing(path);
+    uint64_t next = 0;
+    for(const ResultRecord &r: existing) next = std::max(next, r.sequence() + 1);
+    return next;
+}
+
+// Appends records through an AsyncLogger, so encoding happens on the caller
+// and the file write on the logger's thread. The file is appended to, so
+// sequence numbers carry on from the records already in it and each one the
+// JSON log references stays unique within the file.
+class ResultWriter {
+private:
+    AsyncLogger sink;
+    WriterOptions opts;
+    std::atomic<uint64_t> next;
+public:
+    explicit ResultWriter(const std::string &path, WriterOptions o = {}, LoggerOptions lo = {}) : sink(path, lo), opts(o), next(nextSequence(path)) {}
+
+    // Returns the sequence number stamped into the record.
+    uint64_t write(const ShotBuffer &buf, RecordInfo info) {
+        info.sequence = next++;
+        sink.blob(encodeRecord(buf, info, opts));
+        return info.sequence;
+    }
+    void flush() { sink.flush(); }
+};
+
+}
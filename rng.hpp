@@ -0,0 +1,136 @@
+#pragma once
+#include <atomic>
+#include <random>
+#include <cstdlib>
+#include <cstdint>
+
+// --------------------------
+// Random Streams
+// --------------------------
+// Two generators, both lock-free and safe to use from any thread:
+//   CounterRng  Philox4x32-10. Output is a pure function of (key, counter), so
+//               a stream keyed by (seed, job/module) and indexed by (shot,
+//               word) gives the same bits no matter which thread draws them or
+//               in what order: shot ranges can be sampled in parallel and
+//               replayed exactly.
+//   threadRng() xoshiro256**, one per thread, for draws that have no natural
+//               counter. Seeded from the process seed and the thread's ordinal.
+// The process seed comes from QC_SEED if set, otherwise from random_device;
+// setRngSeed() pins it for reproducible runs.
+
+inline uint64_t splitmix64(uint64_t &state) {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+inline std::atomic<uint64_t> &rngSeedStore() {
+    static std::atomic<uint64_t> seed{[]() {
+        if(const char *s = std::getenv("QC_SEED")) return (uint64_t)std::strtoull(s, nullptr, 0);
+        std::random_device rd;
+        return (uint64_t)rd() << 32 | rd();
+    }()};
+    return seed;
+}
+inline uint64_t rngSeed() { return rngSeedStore().load(std::memory_order_relaxed); }
+inline void setRngSeed(uint64_t seed) { rngSeedStore().store(seed, std::memory_order_relaxed); }
+
+// Seed for the next simulator or generator that has no stream of its own;
+// distinct per call, and reproducible when objects are created in the same order.
+inline uint64_t nextStreamSeed() {
+    static std::atomic<uint64_t> ordinal{0};
+    uint64_t s = rngSeed() ^ (ordinal.fetch_add(1, std::memory_order_relaxed) * 0xd1b54a32d192ed03ull);
+    return splitmix64(s);
+}
+
+// Stream id for (job, module); job 0 is "no job".
+inline uint64_t rngStream(uint64_t job, int module) {
+    uint64_t s = job * 0x9e3779b97f4a7c15ull ^ (uint64_t)(uint32_t)module;
+    return splitmix64(s);
+}
+
+class CounterRng {
+private:
+    uint32_t k0, k1;
+
+    static inline void mulhilo(uint32_t a, uint32_t b, uint32_t &hi, uint32_t &lo) {
+        uint64_t p = (uint64_t)a * b;
+        hi = (uint32_t)(p >> 32);
+        lo = (uint32_t)p;
+    }
+
+public:
+    CounterRng(uint64_t seed, uint64_t stream) {
+        uint64_t s = seed ^ (stream * 0xd6e8feb86659fd93ull);
+        uint64_t key = splitmix64(s);
+        k0 = (uint32_t)key;
+        k1 = (uint32_t)(key >> 32);
+    }
+
+    // 128 random bits for counter (hi, lo).
+    void block(uint64_t hi, uint64_t lo, uint64_t out[2]) const {
+        uint32_t c0 = (uint32_t)lo, c1 = (uint32_t)(lo >> 32), c2 = (uint32_t)hi, c3 = (uint32_t)(hi >> 32);
+        uint32_t a = k0, b = k1;
+        for(int r=0;r<10;r++){
+            uint32_t h0, l0, h1, l1;
+            mulhilo(0xD2511F53u, c0, h0, l0);
+            mulhilo(0xCD9E8D57u, c2, h1, l1);
+            c0 = h1 ^ c1 ^ a; c1 = l1;
+            c2 = h0 ^ c3 ^ b; c3 = l0;
+            a += 0x9E3779B9u; b += 0xBB67AE85u;
+        }
+        out[0] = (uint64_t)c1 << 32 | c0;
+        out[1] = (uint64_t)c3 << 32 | c2;
+    }
+
+    uint64_t word(uint64_t hi, uint64_t lo) const { uint64_t o[2]; block(hi, lo >> 1, o); return o[lo & 1]; }
+
+    // Bit `idx[i]` of row `hi` (bit b lives in word b/64) packed into bit i of
+    // `out`, which starts zeroed. So a qubit reads the same whichever subset
+    // of the register is read; aligned 64-qubit runs move a word at a time.
+    void gather(uint64_t hi, const int *idx, size_t n, uint64_t *out) const {
+        uint64_t blk[2] = {0, 0}, cached = ~0ull;
+        auto bitsAt = [&](uint64_t w) { if((w >> 1) != cached) { cached = w >> 1; block(hi, cached, blk); } return blk[w & 1]; };
+        for(size_t i=0;i<n;){
+            if((i & 63) == 0 && i+64 <= n && idx[i+63] - idx[i] == 63){
+                bool run = true;
+                for(size_t j=1;j<64 && run;j++) run = idx[i+j] == idx[i]+(int)j;
+                if(run){
+                    uint64_t b = (uint64_t)idx[i], off = b & 63;
+                    uint64_t lo = bitsAt(b >> 6);
+                    out[i>>6] = off ? (lo >> off) | (bitsAt((b >> 6) + 1) << (64 - off)) : lo;
+                    i += 64;
+                    continue;
+                }
+            }
+            uint64_t b = (uint64_t)idx[i];
+            out[i>>6] |= ((bitsAt(b >> 6) >> (b & 63)) & 1) << (i & 63);
+            i++;
+        }
+    }
+};
+
+class Xoshiro256 {
+private:
+    uint64_t s[4];
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+public:
+    explicit Xoshiro256(uint64_t seed) { for(uint64_t &w: s) w = splitmix64(seed); }
+    uint64_t operator()() {
+        uint64_t result = rotl(s[1] * 5, 7) * 9;
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0]; s[3] ^= s[1]; s[1] ^= s[2]; s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+    using result_type = uint64_t;
+    static constexpr uint64_t min() { return 0; }
+    static constexpr uint64_t max() { return ~0ull; }
+};
+
+inline Xoshiro256 &threadRng() {
+    thread_local Xoshiro256 rng(nextStreamSeed());
+    return rng;
+}
@@ -0,0 +1,348 @@
+#pragma once
+#include <vector>
+#include <utility>
+#include <string>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+#include "circuit_ir.hpp"
+
+// --------------------------
+// Coupling Map
+// --------------------------
+// Which physical qubit pairs of one chip share a coupler, i.e. can take a
+// two-qubit gate directly. Neighbours are kept in CSR form and all-pairs hop
+// distances are precomputed by BFS (n^2 16-bit entries, 20 kB at 100 qubits),
+// so routing asks for a distance with a single load.
+class CouplingMap {
+private:
+    static constexpr uint16_t unreachable = 0xFFFF;
+    int n;
+    std::vector<std::pair<int,int>> edge_list;
+    std::vector<int> offsets; // neighbours of p are nbr[offsets[p] .. offsets[p+1])
+    std::vector<int> nbr;
+    std::vector<int> nbr_edge; // edge index of each neighbour entry
+    std::vector<uint16_t> dist;
+
+public:
+    CouplingMap(int qubits, std::vector<std::pair<int,int>> edges) : n(qubits), edge_list(std::move(edges)), offsets(qubits+1, 0), dist((size_t)qubits*qubits, unreachable) {
+        if(qubits < 1 || qubits >= unreachable) throw std::invalid_argument("CouplingMap: bad qubit count");
+        for(auto &e: edge_list){
+            if(e.first < 0 || e.second < 0 || e.first >= n || e.second >= n || e.first == e.second)
+                throw std::invalid_argument("CouplingMap: bad edge " + std::to_string(e.first) + "-" + std::to_string(e.second));
+            if(e.first > e.second) std::swap(e.first, e.second);
+        }
+        std::sort(edge_list.begin(), edge_list.end());
+        edge_list.erase(std::unique(edge_list.begin(), edge_list.end()), edge_list.end());
+        for(auto &e: edge_list) { offsets[e.first+1]++; offsets[e.second+1]++; }
+        for(int p=0;p<n;p++) offsets[p+1] += offsets[p];
+        nbr.resize(offsets[n]);
+        nbr_edge.resize(offsets[n]);
+        std::vector<int> fill(offsets.begin(), offsets.end()-1);
+        for(size_t i=0;i<edge_list.size();i++){
+            auto [a, b] = edge_list[i];
+            nbr[fill[a]] = b; nbr_edge[fill[a]++] = (int)i;
+            nbr[fill[b]] = a; nbr_edge[fill[b]++] = (int)i;
+        }
+        std::vector<int> queue(n);
+        for(int s=0;s<n;s++){
+            uint16_t *d = &dist[(size_t)s*n];
+            size_t head = 0, tail = 0;
+            d[s] = 0;
+            queue[tail++] = s;
+            while(head < tail){
+                int p = queue[head++];
+                for(int i=offsets[p];i<offsets[p+1];i++) if(d[nbr[i]] == unreachable) { d[nbr[i]] = d[p] + 1; queue[tail++] = nbr[i]; }
+            }
+        }
+    }
+
+    // Common chip layouts.
+    static CouplingMap line(int qubits) {
+        std::vector<std::pair<int,int>> e;
+        for(int q=0;q+1<qubits;q++) e.emplace_back(q, q+1);
+        return CouplingMap(qubits, std::move(e));
+    }
+    static CouplingMap ring(int qubits) {
+        std::vector<std::pair<int,int>> e;
+        for(int q=0;q<qubits;q++) e.emplace_back(q, (q+1) % qubits);
+        return CouplingMap(qubits, std::move(e));
+    }
+    static CouplingMap grid(int rows, int cols) {
+        std::vector<std::pair<int,int>> e;
+        for(int r=0;r<rows;r++) for(int c=0;c<cols;c++){
+            int q = r*cols + c;
+            if(c+1 < cols) e.emplace_back(q, q+1);
+            if(r+1 < rows) e.emplace_back(q, q+cols);
+        }
+        return CouplingMap(rows*cols, std::move(e));
+    }
+
+    int numQubits() const { return n; }
+    const std::vector<std::pair<int,int>> &edges() const { return edge_list; }
+    const int *neighboursBegin(int p) const { return nbr.data() + offsets[p]; }
+    const int *neighboursEnd(int p) const { return nbr.data() + offsets[p+1]; }
+    const int *neighbourEdges(int p) const { return nbr_edge.data() + offsets[p]; }
+
+    int distance(int a, int b) const { return dist[(size_t)a*n + b]; }
+    bool reachable(int a, int b) const { return dist[(size_t)a*n + b] != unreachable; }
+    bool connected(int a, int b) const { return a >= 0 && b >= 0 && a < n && b < n && dist[(size_t)a*n + b] == 1; }
+
+    // Cache-key component: same qubit count and couplers, same hash.
+    uint64_t hash() const {
+        uint64_t h = 0xcbf29ce484222325ull ^ (uint64_t)n;
+        for(auto &e: edge_list) { h ^= (uint64_t)e.first << 32 | (uint32_t)e.second; h *= 0x100000001b3ull; h ^= h >> 29; }
+        return h;
+    }
+
+    // Throws unless every two-qubit gate acts on a coupled pair.
+    void check(const Instruction *begin, const Instruction *end) const {
+        for(const Instruction *in=begin;in!=end;in++){
+            if(in->q0 >= n || (isTwoQubit(in->op) && !connected(in->q0, in->q1)))
+                throw std::invalid_argument(std::string("CouplingMap: ") + gateName(in->op) + " on " + std::to_string(in->q0) + "," + std::to_string(in->q1) + " is not on a coupler");
+        }
+    }
+};
+
+// --------------------------
+// SWAP Routing (SABRE)
+// --------------------------
+// Makes a circuit executable on a coupling map by inserting SWAPs, following
+// SABRE (Li, Ding, Xie, ASPLOS 2019). Gates whose dependencies are done form
+// the front layer; executable ones go out at once. When none is, every SWAP
+// on a coupler next to a front-layer qubit is scored by the summed distance
+// of the front layer plus a weighted lookahead window of the next two-qubit
+// gates, scaled by a decay on recently swapped qubits so routes spread out,
+// and the best one is applied. A SWAP only moves the distances of gates on
+// its two qubits, so candidates are scored by that delta, not from scratch.
+// If no gate becomes executable for a while, the first front gate is walked
+// together along a shortest path, which guarantees progress.
+//
+// The initial layout comes from SABRE's reverse traversal: route forward,
+// route the reversed circuit from where that ended, and start from the
+// layout the reverse pass finishes in. Both passes only track the layout.
+struct RoutingOptions {
+    int lookahead = 20;         // two-qubit gates in the lookahead window
+    double lookahead_weight = 0.5;
+    double decay_step = 0.001;  // added to a qubit's decay per SWAP on it
+    int decay_reset = 5;        // SWAPs between decay resets
+    int layout_passes = 1;      // forward/reverse rounds choosing the initial layout; 0 keeps it trivial
+};
+
+struct RoutingReport {
+    size_t swaps = 0;
+    std::vector<int> initial_layout; // logical qubit -> physical qubit at the start
+    std::vector<int> final_layout;   // ... and at the end (where to read each logical qubit)
+};
+
+namespace detail {
+    class SabreRouter {
+    private:
+        const CouplingMap &map;
+        const RoutingOptions &opts;
+        int n;
+
+        // Per-decision scratch, sized once.
+        struct Touch { int other; double w; };
+        std::vector<std::vector<Touch>> touch; // physical qubit -> front/lookahead gates on it
+        std::vector<int> touched;
+        std::vector<uint32_t> edge_stamp;
+        uint32_t stamp = 0;
+        std::vector<double> decay;
+
+    public:
+        SabreRouter(const CouplingMap &m, const RoutingOptions &o) : map(m), opts(o), n(m.numQubits()), touch(n), edge_stamp(m.edges().size(), 0), decay(n, 1.0) {}
+
+        // Route `gates` (logical operands) from layout l2p, updated in place.
+        // Emits physical instructions into `out` when given; returns the SWAP count.
+        size_t route(const std::vector<Instruction> &gates, std::vector<int> &l2p, std::vector<Instruction> *out) {
+            size_t g_count = gates.size();
+            std::vector<int> p2l(n, -1);
+            for(int l=0;l<(int)l2p.size();l++) p2l[l2p[l]] = l;
+
+            // Dependencies: next gate on each operand, and unresolved
+            // predecessor counts. Slot 2 chains measurements and conditional
+            // gates in program order, so feedback stays behind its readout.
+            std::vector<int> succ(3*g_count, -1);
+            std::vector<uint8_t> pending(g_count, 0);
+            std::vector<int> last(l2p.size(), -1);
+            int last_classical = -1;
+            for(size_t g=0;g<g_count;g++){
+                const Instruction &in = gates[g];
+                int qs[2] = {in.q0, isTwoQubit(in.op) ? in.q1 : -1};
+                for(int k=0;k<2;k++){
+                    int q = qs[k];
+                    if(q < 0) continue;
+                    if(last[q] >= 0) { const Instruction &p = gates[last[q]]; succ[3*last[q] + (p.q0 == q ? 0 : 1)] = (int)g; pending[g]++; }
+                    last[q] = (int)g;
+                }
+                if(isClassical(in)){
+                    if(last_classical >= 0) { succ[3*last_classical + 2] = (int)g; pending[g]++; }
+                    last_classical = (int)g;
+                }
+            }
+
+            std::vector<uint8_t> done(g_count, 0), in_front(g_count, 0);
+            std::vector<int> ready, front, lookahead, bfs;
+            std::vector<uint32_t> visited(g_count, 0);
+            uint32_t visit_stamp = 0;
+            for(size_t g=0;g<g_count;g++) if(!pending[g]) ready.push_back((int)g);
+            size_t swaps = 0;
+            int since_reset = 0, stall = 0;
+            bool progressed = true;
+            std::fill(decay.begin(), decay.end(), 1.0);
+
+            auto execute = [&](int g) {
+                done[g] = 1;
+                if(out){
+                    Instruction in = gates[g];
+                    in.q0 = l2p[in.q0];
+                    if(isTwoQubit(in.op)) in.q1 = l2p[in.q1];
+                    out->push_back(in);
+                }
+                for(int k=0;k<3;k++){ int s = succ[3*g+k]; if(s >= 0 && --pending[s] == 0) ready.push_back(s); }
+            };
+            auto executable = [&](int g) { const Instruction &in = gates[g]; return !isTwoQubit(in.op) || map.connected(l2p[in.q0], l2p[in.q1]); };
+            auto swapPhysical = [&](int a, int b) {
+                int la = p2l[a], lb = p2l[b];
+                p2l[a] = lb; p2l[b] = la;
+                if(la >= 0) l2p[la] = b;
+                if(lb >= 0) l2p[lb] = a;
+                if(out) out->push_back(Instruction{GateOp::SWAP, a, b, {}});
+                swaps++;
+            };
+
+            for(;;){
+                while(!ready.empty()){
+                    int g = ready.back(); ready.pop_back();
+                    if(executable(g)) execute(g);
+                    else { front.push_back(g); in_front[g] = 1; }
+                }
+                if(front.empty()) break;
+
+                if(stall > 2*n){
+                    // Walk the first front gate's operands together.
+                    const Instruction &in = gates[front[0]];
+                    int a = l2p[in.q0], b = l2p[in.q1];
+                    while(map.distance(a, b) > 1){
+                        int step = a;
+                        for(const int *p=map.neighboursBegin(a);p!=map.neighboursEnd(a);p++) if(map.distance(*p, b) < map.distance(step, b)) step = *p;
+                        swapPhysical(a, step);
+                        a = step;
+                    }
+                } else {
+                    // Lookahead window: the first two-qubit gates reached
+                    // breadth-first from the front. It only changes when a
+                    // gate went out, not across consecutive SWAPs.
+                    if(progressed){
+                        lookahead.clear();
+                        visit_stamp++;
+                        bfs.assign(front.begin(), front.end());
+                        for(size_t i=0;i<bfs.size() && (int)lookahead.size()<opts.lookahead;i++){
+                            for(int k=0;k<3;k++){
+                                int s = succ[3*bfs[i]+k];
+                                if(s < 0 || visited[s] == visit_stamp || in_front[s]) continue;
+                                visited[s] = visit_stamp;
+                                bfs.push_back(s);
+                                if(isTwoQubit(gates[s].op) && (int)lookahead.size() < opts.lookahead) lookahead.push_back(s);
+                            }
+                        }
+                        progressed = false;
+                    }
+
+                    // Score = mean front distance + weight * mean lookahead
+                    // distance; each gate is listed under both of its qubits
+                    // with the other end and its weight in the score.
+                    double base = 0;
+                    auto listGates = [&](const std::vector<int> &set, double w) {
+                        for(int g: set){
+                            int a = l2p[gates[g].q0], b = l2p[gates[g].q1];
+                            base += w * map.distance(a, b);
+                            if(touch[a].empty()) touched.push_back(a);
+                            if(touch[b].empty()) touched.push_back(b);
+                            touch[a].push_back({b, w});
+                            touch[b].push_back({a, w});
+                        }
+                    };
+                    listGates(front, 1.0 / front.size());
+                    if(!lookahead.empty()) listGates(lookahead, opts.lookahead_weight / lookahead.size());
+
+                    double best = 1e300;
+                    int best_a = -1, best_b = -1;
+                    stamp++;
+                    for(int f: front){
+                        for(int q: {gates[f].q0, gates[f].q1}){
+                            int a = l2p[q];
+                            const int *eid = map.neighbourEdges(a);
+                            for(const int *p=map.neighboursBegin(a);p!=map.neighboursEnd(a);p++, eid++){
+                                if(edge_stamp[*eid] == stamp) continue;
+                                edge_stamp[*eid] = stamp;
+                                int b = *p;
+                                double delta = 0; // a gate on exactly (a, b) keeps its distance
+                                for(const Touch &t: touch[a]) if(t.other != b) delta += t.w * (map.distance(b, t.other) - map.distance(a, t.other));
+                                for(const Touch &t: touch[b]) if(t.other != a) delta += t.w * (map.distance(a, t.other) - map.distance(b, t.other));
+                                double score = (base + delta) * std::max(decay[a], decay[b]);
+                                if(score < best) { best = score; best_a = a; best_b = b; }
+                            }
+                        }
+                    }
+                    for(int p: touched) touch[p].clear();
+                    touched.clear();
+                    swapPhysical(best_a, best_b);
+                    decay[best_a] += opts.decay_step;
+                    decay[best_b] += opts.decay_step;
+                    if(++since_reset >= opts.decay_reset) { std::fill(decay.begin(), decay.end(), 1.0); since_reset = 0; }
+                }
+
+                // Front gates the SWAP made executable go out next.
+                size_t kept = 0;
+                for(int g: front){
+                    if(executable(g)) { in_front[g] = 0; ready.push_back(g); }
+                    else front[kept++] = g;
+                }
+                front.resize(kept);
+                if(ready.empty()) stall++;
+                else { stall = 0; since_reset = 0; progressed = true; std::fill(decay.begin(), decay.end(), 1.0); }
+            }
+            return swaps;
+        }
+    };
+}
+
+// Route `instrs` (on logical qubits 0..width-1) onto `map`. The result is on
+// physical qubits and every two-qubit gate sits on a coupler.
+inline std::vector<Instruction> routeCircuit(const std::vector<Instruction> &instrs, int width, const CouplingMap &map,
+                                             const RoutingOptions &opts = {}, RoutingReport *report = nullptr) {
+    int n = map.numQubits();
+    if(width > n) throw std::invalid_argument("routeCircuit: " + std::to_string(width) + " qubits on a " + std::to_string(n) + "-qubit coupling map");
+    for(const Instruction &in: instrs)
+        if(in.q0 >= width || (isTwoQubit(in.op) && in.q1 >= width)) throw std::invalid_argument("routeCircuit: operand past the circuit width");
+
+    // Every logical qubit, spare physical qubits included, gets a place so
+    // SWAPs can move through unused qubits.
+    std::vector<int> layout(n);
+    for(int p=0;p<n;p++) layout[p] = p;
+    std::vector<int> used(width, 0);
+    for(const Instruction &in: instrs) if(isTwoQubit(in.op)) { used[in.q0] = 1; used[in.q1] = 1; }
+    for(int a=0;a<width;a++) for(int b=a+1;b<width;b++)
+        if(used[a] && used[b] && !map.reachable(a, b)) throw std::invalid_argument("routeCircuit: coupling map is not connected");
+
+    detail::SabreRouter router(map, opts);
+    if(opts.layout_passes > 0){
+        std::vector<Instruction> reversed(instrs.rbegin(), instrs.rend());
+        for(int pass=0;pass<opts.layout_passes;pass++){
+            router.route(instrs, layout, nullptr);
+            router.route(reversed, layout, nullptr);
+        }
+    }
+    std::vector<int> initial(layout.begin(), layout.begin() + width);
+    std::vector<Instruction> out;
+    out.reserve(instrs.size() + instrs.size()/4);
+    size_t swaps = router.route(instrs, layout, &out);
+    if(report){
+        report->swaps = swaps;
+        report->initial_layout = std::move(initial);
+        report->final_layout.assign(layout.begin(), layout.begin() + width);
+    }
+    return out;
+}
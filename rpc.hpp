@@ -0,0 +1,859 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include <cstring>
+#include <cstdint>
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+#include "backend.hpp"
+#include "link_scheduler.hpp"
+#include "thread_pool.hpp"
+#include "metrics.hpp"
+
+// --------------------------
+// Module RPC
+// --------------------------
+// Modules on other hosts. A ModuleAgent runs next to a module's electronics
+// and serves its Backend over TCP; RemoteBackend is that Backend on the
+// supercomputer's side, so a remote module is an ordinary QuantumModule
+// whose calls cross the network.
+//
+// Frames are a 12-byte header and a payload of fixed-layout records,
+// little-endian as written by the host (like the snapshot and result files).
+// Pulses get no reply: they are appended to an open Ops frame that goes out
+// when it fills, when the module's executor runs dry (flush), or ahead of the
+// next request, and the agent runs them in order. Requests (readout,
+// calibration, barriers) are numbered and their replies routed back by
+// number, so several can be in flight from different threads. A pulse that
+// fails on the agent fails the next reply instead, and the pulses after it
+// are skipped, as on a local executor.
+namespace rpc {
+
+enum class Msg : uint8_t { Hello, Ops, LinkWindow, Calibrate, HealthCheck, ReadState, ReadRegisters, SampleShots, Barrier, Ping, Reply, Error };
+
+struct FrameHeader {
+    uint32_t length; // payload bytes
+    uint32_t seq;    // request number, echoed by its reply; 0 on Ops and LinkWindow
+    uint8_t type;    // Msg
+    uint8_t reserved[3];
+};
+static_assert(sizeof(FrameHeader) == 12, "frame header layout");
+
+enum class OpKind : uint8_t { Pulse, TwoQubitPulse, Rotation, ControlledPhase, Unitary, Reset, RngStream };
+
+// One pipelined backend call.
+struct WireOp {
+    uint8_t kind; // OpKind
+    uint8_t op;   // GateOp
+    uint8_t reserved[2];
+    int32_t q1, q2;
+    uint32_t reserved2;
+    double params[3]; // RngStream: the stream id's bits in params[0]
+};
+static_assert(sizeof(WireOp) == 40 && std::is_trivially_copyable<WireOp>::value, "op record layout");
+
+// One gate of a link window, both ends in the supercomputer's numbering.
+struct WireLinkGate {
+    uint8_t op;
+    uint8_t reserved[3];
+    int32_t a_module, a_qubit, b_module, b_qubit;
+    uint32_t reserved2;
+    double params[3];
+};
+static_assert(sizeof(WireLinkGate) == 48 && std::is_trivially_copyable<WireLinkGate>::value, "link gate record layout");
+
+constexpr uint32_t protocol_magic = 0x50524351; // "QCRP"
+constexpr uint32_t protocol_version = 2;
+constexpr uint32_t max_frame_bytes = 64u << 20;
+
+inline int64_t steadyNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Sleep to just short of `t` (steady clock), then spin the rest, so both ends
+// of a link window start within a few microseconds of the agreed time.
+inline void sleepUntil(int64_t t) {
+    for(int64_t left=t-steadyNs();left>0;left=t-steadyNs()){
+        if(left > 200000) std::this_thread::sleep_for(std::chrono::nanoseconds(left - 100000));
+        else std::this_thread::yield();
+    }
+}
+
+template<typename T>
+inline void put(std::vector<char> &buf, const T &v) {
+    static_assert(std::is_trivially_copyable<T>::value, "wire records are copied as bytes");
+    size_t at = buf.size();
+    buf.resize(at + sizeof(T));
+    std::memcpy(&buf[at], &v, sizeof(T));
+}
+
+inline void putBytes(std::vector<char> &buf, const void *p, size_t n) {
+    buf.insert(buf.end(), (const char*)p, (const char*)p + n);
+}
+
+inline void putFrame(std::vector<char> &buf, Msg type, uint32_t seq, const std::vector<char> &payload) {
+    put(buf, FrameHeader{(uint32_t)payload.size(), seq, (uint8_t)type, {}});
+    putBytes(buf, payload.data(), payload.size());
+}
+
+class PayloadReader {
+private:
+    const char *p, *end;
+public:
+    explicit PayloadReader(const std::vector<char> &buf) : p(buf.data()), end(buf.data() + buf.size()) {}
+
+    void bytes(void *out, size_t n) {
+        if((size_t)(end - p) < n) throw std::runtime_error("rpc: truncated frame");
+        std::memcpy(out, p, n);
+        p += n;
+    }
+    template<typename T> T get() { T v; bytes(&v, sizeof(T)); return v; }
+    size_t left() const { return end - p; }
+};
+
+inline std::vector<char> textPayload(const std::string &s) { return std::vector<char>(s.begin(), s.end()); }
+
+// --------------------------
+// TCP Sockets
+// --------------------------
+#ifndef _WIN32
+inline std::runtime_error socketError(const std::string &what, int err) {
+    return std::runtime_error("rpc: " + what + ": " + std::strerror(err));
+}
+
+inline void noDelay(int fd) {
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+inline int connectTcp(const std::string &host, int port) {
+    addrinfo hints{}, *found = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    int rc = ::getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &found);
+    if(rc) throw std::runtime_error("rpc: cannot resolve " + host + ": " + ::gai_strerror(rc));
+    int fd = -1, err = 0;
+    for(addrinfo *a=found;a && fd<0;a=a->ai_next){
+        fd = ::socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if(fd >= 0 && ::connect(fd, a->ai_addr, a->ai_addrlen) != 0) { err = errno; ::close(fd); fd = -1; }
+        else if(fd < 0) err = errno;
+    }
+    ::freeaddrinfo(found);
+    if(fd < 0) throw socketError("cannot connect to " + host + ":" + std::to_string(port), err);
+    noDelay(fd);
+    return fd;
+}
+
+// Listening socket on every interface; `bound` gets the port (for port 0, the
+// one the system picked).
+inline int listenTcp(int port, int &bound) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if(fd < 0) throw socketError("socket", errno);
+    int one = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons((uint16_t)port);
+    if(::bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || ::listen(fd, 4) != 0){
+        int err = errno;
+        ::close(fd);
+        throw socketError("cannot listen on port " + std::to_string(port), err);
+    }
+    socklen_t len = sizeof(addr);
+    ::getsockname(fd, (sockaddr*)&addr, &len);
+    bound = ntohs(addr.sin_port);
+    return fd;
+}
+
+// -1 once the listening socket is shut down.
+inline int acceptTcp(int fd) {
+    int c = ::accept(fd, nullptr, nullptr);
+    if(c >= 0) noDelay(c);
+    return c;
+}
+
+inline void sendAll(int fd, const void *data, size_t n) {
+#ifdef MSG_NOSIGNAL
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif
+    const char *p = (const char*)data;
+    while(n){
+        ssize_t k = ::send(fd, p, n, flags);
+        if(k < 0 && errno == EINTR) continue;
+        if(k <= 0) throw socketError("send", errno);
+        p += k;
+        n -= (size_t)k;
+    }
+}
+
+// False on end of stream or error.
+inline bool recvAll(int fd, void *data, size_t n) {
+    char *p = (char*)data;
+    while(n){
+        ssize_t k = ::recv(fd, p, n, 0);
+        if(k < 0 && errno == EINTR) continue;
+        if(k <= 0) return false;
+        p += k;
+        n -= (size_t)k;
+    }
+    return true;
+}
+
+inline void shutdownSocket(int fd) { ::shutdown(fd, SHUT_RDWR); }
+inline void closeSocket(int fd) { ::close(fd); }
+#else
+inline int connectTcp(const std::string&, int) { throw std::runtime_error("rpc: remote modules need POSIX sockets"); }
+inline int listenTcp(int, int&) { throw std::runtime_error("rpc: remote modules need POSIX sockets"); }
+inline int acceptTcp(int) { return -1; }
+inline void sendAll(int, const void*, size_t) { throw std::runtime_error("rpc: remote modules need POSIX sockets"); }
+inline bool recvAll(int, void*, size_t) { return false; }
+inline void shutdownSocket(int) {}
+inline void closeSocket(int) {}
+#endif
+
+// False on end of stream; throws on a frame no agent or host would send.
+inline bool recvFrame(int fd, FrameHeader &h, std::vector<char> &payload) {
+    if(!recvAll(fd, &h, sizeof(h))) return false;
+    if(h.length > max_frame_bytes) throw std::runtime_error("rpc: oversized frame (" + std::to_string(h.length) + " bytes)");
+    payload.resize(h.length);
+    return recvAll(fd, payload.data(), h.length);
+}
+
+// --------------------------
+// Clock Sync
+// --------------------------
+// Offset of the agent's steady clock from ours, from request/reply pairs the
+// agent stamps with its time: offset = remote - (sent + received)/2, good to
+// half the round trip. Of the last `window` samples the one with the shortest
+// round trip wins, which drops those delayed by queueing on either side.
+class ClockSync {
+private:
+    struct Sample { int64_t offset, rtt; };
+    std::vector<Sample> samples;
+    size_t next = 0, window;
+
+    const Sample &best() const {
+        return *std::min_element(samples.begin(), samples.end(), [](const Sample &a, const Sample &b) { return a.rtt < b.rtt; });
+    }
+
+public:
+    explicit ClockSync(size_t window_=16) : window(window_) {}
+
+    void add(int64_t sent, int64_t remote, int64_t received) {
+        Sample s{remote - sent/2 - received/2, received - sent};
+        if(samples.size() < window) samples.push_back(s);
+        else samples[next++ % window] = s;
+    }
+
+    bool valid() const { return !samples.empty(); }
+    int64_t offsetNs() const { return valid() ? best().offset : 0; }
+    int64_t rttNs() const { return valid() ? best().rtt : 0; }
+    int64_t toRemote(int64_t local) const { return local + offsetNs(); }
+    int64_t toLocal(int64_t remote) const { return remote - offsetNs(); }
+};
+
+// --------------------------
+// Remote Backend (host side)
+// --------------------------
+struct RemoteOptions {
+    size_t batch_bytes = 64 << 10;  // an Ops frame goes out at this size at the latest
+    int clock_pings = 8;            // round trips at connect for the first clock offset
+    int64_t link_guard_ns = 500000; // lead, on top of the round trip, when a link window is scheduled
+};
+
+class RemoteBackend : public Backend {
+public:
+    struct Call {
+        std::vector<char> reply;
+        std::string error;
+        int64_t sent_ns = 0, received_ns = 0;
+        bool done = false;
+    };
+    using Pending = std::shared_ptr<Call>;
+
+private:
+    static constexpr size_t npos = (size_t)-1;
+
+    RemoteOptions opts;
+    std::string endpoint, label;
+    int fd = -1;
+    int n = 0, channels = 1;
+    bool unitary = false, concurrent = true;
+
+    std::mutex send_mtx;       // out, ops_at, next_seq and the socket's write side
+    std::vector<char> out;
+    size_t ops_at = npos;      // header of the open Ops frame in `out`
+    uint32_t next_seq = 0;
+
+    std::mutex call_mtx;       // calls, broken, clock, last_link_start
+    std::condition_variable replied;
+    std::map<uint32_t, Pending> calls;
+    std::string broken;        // why the connection is gone; empty while it is up
+    std::atomic<bool> down{false};
+    ClockSync clock;
+    int64_t last_link_start = 0; // agent clock, from the last barrier
+    std::thread reader;
+
+    void fail(const std::string &why) {
+        std::lock_guard<std::mutex> guard(call_mtx);
+        if(broken.empty()) broken = why;
+        down = true;
+        for(auto &c: calls) { c.second->error = broken; c.second->done = true; }
+        calls.clear();
+        replied.notify_all();
+    }
+
+    void readReplies() {
+        FrameHeader h;
+        std::vector<char> payload;
+        try {
+            while(recvFrame(fd, h, payload)){
+                int64_t now = steadyNs();
+                std::lock_guard<std::mutex> guard(call_mtx);
+                auto it = calls.find(h.seq);
+                if(it == calls.end()) continue;
+                Call &c = *it->second;
+                if((Msg)h.type == Msg::Error) c.error.assign(payload.begin(), payload.end());
+                else c.reply.swap(payload);
+                c.received_ns = now;
+                c.done = true;
+                calls.erase(it);
+                replied.notify_all();
+            }
+            fail("connection to " + endpoint + " lost");
+        } catch(const std::exception &e) { fail(e.what()); }
+    }
+
+    void sendLocked() {
+        if(out.empty()) return;
+        ops_at = npos;
+        try { sendAll(fd, out.data(), out.size()); }
+        catch(const std::exception &e) { out.clear(); fail(e.what()); throw; }
+        out.clear();
+    }
+
+    void throwIfDown() {
+        if(!down) return;
+        std::lock_guard<std::mutex> guard(call_mtx);
+        throw std::runtime_error("rpc " + endpoint + ": " + broken);
+    }
+
+    void pushOp(const WireOp &w) {
+        throwIfDown();
+        std::lock_guard<std::mutex> guard(send_mtx);
+        if(ops_at == npos) { ops_at = out.size(); put(out, FrameHeader{0, 0, (uint8_t)Msg::Ops, {}}); }
+        put(out, w);
+        uint32_t length = (uint32_t)(out.size() - ops_at - sizeof(FrameHeader));
+        std::memcpy(&out[ops_at], &length, sizeof(length));
+        if(out.size() >= opts.batch_bytes) sendLocked();
+    }
+
+    static WireOp wireOp(OpKind kind, GateOp op, int q1, int q2=-1) {
+        WireOp w{};
+        w.kind = (uint8_t)kind;
+        w.op = (uint8_t)op;
+        w.q1 = q1;
+        w.q2 = q2;
+        return w;
+    }
+
+    Pending post(Msg type, const std::vector<char> &payload) {
+        Pending call = std::make_shared<Call>();
+        std::lock_guard<std::mutex> guard(send_mtx);
+        uint32_t seq = ++next_seq;
+        if(!seq) seq = ++next_seq;
+        {
+            std::lock_guard<std::mutex> g(call_mtx);
+            if(!broken.empty()) throw std::runtime_error("rpc " + endpoint + ": " + broken);
+            calls[seq] = call;
+        }
+        putFrame(out, type, seq, payload); // behind any pulses still buffered
+        call->sent_ns = steadyNs();
+        sendLocked();
+        return call;
+    }
+
+    std::vector<char> await(const Pending &call) {
+        std::unique_lock<std::mutex> lock(call_mtx);
+        replied.wait(lock, [&]() { return call->done; });
+        if(!call->error.empty()) throw std::runtime_error("rpc " + endpoint + ": " + call->error);
+        return std::move(call->reply);
+    }
+
+    std::vector<char> request(Msg type, const std::vector<char> &payload = {}) { return await(post(type, payload)); }
+
+    void ping() {
+        Pending call = post(Msg::Ping, {});
+        std::vector<char> reply = await(call);
+        int64_t remote = PayloadReader(reply).get<int64_t>();
+        std::lock_guard<std::mutex> guard(call_mtx);
+        clock.add(call->sent_ns, remote, call->received_ns);
+    }
+
+    void shutdown() {
+        shutdownSocket(fd);
+        if(reader.joinable()) reader.join();
+        closeSocket(fd);
+    }
+
+public:
+    RemoteBackend(const std::string &host, int port, RemoteOptions o = {})
+        : opts(o), endpoint(host + ":" + std::to_string(port)) {
+        fd = connectTcp(host, port);
+        reader = std::thread([this]() { readReplies(); });
+        try {
+            std::vector<char> hello;
+            put(hello, protocol_magic);
+            put(hello, protocol_version);
+            std::vector<char> reply = request(Msg::Hello, hello);
+            PayloadReader r(reply);
+            r.get<uint32_t>(); // the agent's version; it refuses one it can't speak
+            n = r.get<int32_t>();
+            channels = r.get<int32_t>();
+            unitary = r.get<uint8_t>();
+            concurrent = r.get<uint8_t>();
+            std::string agent(r.get<uint32_t>(), '\0');
+            r.bytes(&agent[0], agent.size());
+            label = "remote " + agent;
+            for(int i=0;i<opts.clock_pings;i++) ping();
+        } catch(...) { shutdown(); throw; }
+    }
+
+    ~RemoteBackend() override {
+        try { flush(); } catch(...) {}
+        shutdown();
+    }
+
+    RemoteBackend(const RemoteBackend&) = delete;
+    RemoteBackend &operator=(const RemoteBackend&) = delete;
+
+    const char *name() const override { return label.c_str(); }
+    int numQubits() const override { return n; }
+    const std::string &address() const { return endpoint; }
+    const RemoteOptions &options() const { return opts; }
+
+    // Send whatever pulses are buffered.
+    void flush() override {
+        std::lock_guard<std::mutex> guard(send_mtx);
+        sendLocked();
+    }
+
+    QubitCalibration calibrate(int q) override {
+        std::vector<char> p;
+        put(p, (int32_t)q);
+        std::vector<char> reply = request(Msg::Calibrate, p);
+        return PayloadReader(reply).get<QubitCalibration>();
+    }
+
+    bool healthCheck(int q) override {
+        std::vector<char> p;
+        put(p, (int32_t)q);
+        std::vector<char> reply = request(Msg::HealthCheck, p);
+        return PayloadReader(reply).get<uint8_t>() != 0;
+    }
+
+    void sendPulse(int q, GateOp op) override { pushOp(wireOp(OpKind::Pulse, op, q)); }
+    void sendTwoQubitPulse(int q1, int q2, GateOp op) override { pushOp(wireOp(OpKind::TwoQubitPulse, op, q1, q2)); }
+
+    void sendRotation(int q, GateOp op, double angle) override {
+        WireOp w = wireOp(OpKind::Rotation, op, q);
+        w.params[0] = angle;
+        pushOp(w);
+    }
+
+    void sendControlledPhase(int q1, int q2, double angle) override {
+        WireOp w = wireOp(OpKind::ControlledPhase, GateOp::CPHASE, q1, q2);
+        w.params[0] = angle;
+        pushOp(w);
+    }
+
+    bool supportsUnitary() const override { return unitary; }
+    void sendUnitary(int q, const double params[3]) override {
+        if(!unitary) Backend::sendUnitary(q, params);
+        WireOp w = wireOp(OpKind::Unitary, GateOp::U, q);
+        std::copy(params, params+3, w.params);
+        pushOp(w);
+    }
+
+    void setRngStream(uint64_t stream) override {
+        WireOp w = wireOp(OpKind::RngStream, GateOp::H, -1);
+        std::memcpy(w.params, &stream, sizeof(stream));
+        pushOp(w);
+    }
+
+    void reset() override { pushOp(wireOp(OpKind::Reset, GateOp::H, -1)); }
+
+    int readState(int q) override {
+        std::vector<char> p;
+        put(p, (int32_t)q);
+        std::vector<char> reply = request(Msg::ReadState, p);
+        return PayloadReader(reply).get<int32_t>();
+    }
+
+    void readRegister(const std::vector<int> &qubits, uint64_t shot, uint64_t *row) override { readRegisters(qubits, shot, 1, row); }
+
+    // A whole chunk of shots per round trip.
+    void readRegisters(const std::vector<int> &qubits, uint64_t first, size_t count, uint64_t *rows) override {
+        std::vector<char> p;
+        put(p, first);
+        put(p, (uint32_t)count);
+        put(p, (uint32_t)qubits.size());
+        for(int q: qubits) put(p, (int32_t)q);
+        std::vector<char> reply = request(Msg::ReadRegisters, p);
+        size_t bytes = count * ((qubits.size() + 63) / 64) * sizeof(uint64_t);
+        if(reply.size() != bytes) throw std::runtime_error("rpc " + endpoint + ": short readout reply");
+        std::memcpy(rows, reply.data(), bytes);
+    }
+
+    bool sampleShots(const std::vector<int> &qubits, uint64_t first, int shots, ShotBuffer &result, ThreadPool *pool) override {
+        std::vector<char> p;
+        put(p, first);
+        put(p, (uint32_t)shots);
+        put(p, (uint32_t)qubits.size());
+        for(int q: qubits) put(p, (int32_t)q);
+        std::vector<char> reply = request(Msg::SampleShots, p);
+        PayloadReader r(reply);
+        if(!r.get<uint8_t>()) return false;
+        result = ShotBuffer(qubits, shots);
+        r.bytes(result.shot(0), result.data().size() * sizeof(uint64_t));
+        return true;
+    }
+
+    bool concurrentPulses() const override { return concurrent; }
+    int readoutChannels() const override { return channels; }
+
+    // Checkpoint: returns once the agent has run everything sent before it,
+    // and refreshes the clock offset from the reply. post/await split it so
+    // several agents can be waited on at once. awaitBarrier returns when the
+    // agent's last link window started, on our clock (0 if none yet).
+    Pending postBarrier() { return post(Msg::Barrier, {}); }
+    int64_t awaitBarrier(const Pending &call) {
+        std::vector<char> reply = await(call);
+        PayloadReader r(reply);
+        int64_t remote_now = r.get<int64_t>(), link_start = r.get<int64_t>();
+        std::lock_guard<std::mutex> guard(call_mtx);
+        clock.add(call->sent_ns, remote_now, call->received_ns);
+        last_link_start = link_start;
+        return link_start ? clock.toLocal(link_start) : 0;
+    }
+    int64_t barrier() { return awaitBarrier(postBarrier()); }
+
+    // This module's half of a link window to module `peer`, started by the
+    // agent at `start_ns` on our steady clock (converted to the agent's).
+    void scheduleLinkWindow(int64_t start_ns, int peer, const GlobalInstruction *gates, size_t count) {
+        throwIfDown();
+        std::vector<char> p;
+        {
+            std::lock_guard<std::mutex> guard(call_mtx);
+            put(p, clock.toRemote(start_ns));
+        }
+        put(p, (int32_t)peer);
+        put(p, (uint32_t)count);
+        for(size_t i=0;i<count;i++){
+            const GlobalInstruction &g = gates[i];
+            WireLinkGate w{};
+            w.op = (uint8_t)g.op;
+            w.a_module = g.a.module; w.a_qubit = g.a.qubit;
+            w.b_module = g.b.module; w.b_qubit = g.b.qubit;
+            std::copy(g.params, g.params+3, w.params);
+            put(p, w);
+        }
+        std::lock_guard<std::mutex> guard(send_mtx);
+        putFrame(out, Msg::LinkWindow, 0, p);
+        sendLocked();
+    }
+
+    int64_t clockOffsetNs() { std::lock_guard<std::mutex> guard(call_mtx); return clock.offsetNs(); }
+    int64_t roundTripNs() { std::lock_guard<std::mutex> guard(call_mtx); return clock.rttNs(); }
+};
+
+// --------------------------
+// Module Agent
+// --------------------------
+// Serves one Backend to one supercomputer connection at a time (another
+// waits in the listen queue until it closes). Frames are
+// handled in arrival order on the connection's thread, except calibrations,
+// health checks and shot readouts: those go to the agent's lines and may
+// overlap one another, and anything else waits for them first.
+struct AgentOptions {
+    unsigned lines = 8;          // calibrations, health checks and readouts in flight at once
+    int64_t clock_offset_ns = 0; // added to the agent's clock, so one host can stand in for another
+};
+
+class ModuleAgent {
+private:
+    std::unique_ptr<Backend> backend;
+    AgentOptions opts;
+    int listen_fd = -1, bound_port = 0;
+    std::atomic<bool> stopping{false};
+    std::mutex conn_mtx;          // conn_fd, against stop()
+    int conn_fd = -1;
+    std::mutex write_mtx;         // replies come from the connection thread and the lines
+    std::mutex flight_mtx;
+    std::condition_variable landed;
+    int in_flight = 0;
+    std::string failure;          // first failed op since the last reply (connection thread)
+    int64_t last_link_start = 0;  // agent clock
+    ThreadPool lines;
+    std::thread server;
+
+    int64_t now() const { return steadyNs() + opts.clock_offset_ns; }
+
+    void send(int fd, Msg type, uint32_t seq, const std::vector<char> &payload) {
+        std::vector<char> frame;
+        putFrame(frame, type, seq, payload);
+        std::lock_guard<std::mutex> guard(write_mtx);
+        sendAll(fd, frame.data(), frame.size());
+    }
+
+    // A reply, unless an op failed since the last one: then the failure.
+    void reply(int fd, uint32_t seq, const std::vector<char> &payload) {
+        if(failure.empty()) { send(fd, Msg::Reply, seq, payload); return; }
+        std::string f;
+        f.swap(failure);
+        send(fd, Msg::Error, seq, textPayload(f));
+    }
+
+    void waitLines() {
+        std::unique_lock<std::mutex> lock(flight_mtx);
+        landed.wait(lock, [this]() { return in_flight == 0; });
+    }
+
+    template<typename F>
+    void onLine(int fd, uint32_t seq, F &&fn) {
+        if(!failure.empty()) { reply(fd, seq, {}); return; }
+        { std::lock_guard<std::mutex> guard(flight_mtx); in_flight++; }
+        lines.submit([this, fd, seq, fn]() {
+            try {
+                std::vector<char> payload = fn();
+                send(fd, Msg::Reply, seq, payload);
+            } catch(const std::exception &e) {
+                try { send(fd, Msg::Error, seq, textPayload(e.what())); } catch(...) {}
+            }
+            std::lock_guard<std::mutex> guard(flight_mtx);
+            if(--in_flight == 0) landed.notify_all();
+        });
+    }
+
+    void applyOp(const WireOp &w) {
+        GateOp op = (GateOp)w.op;
+        switch((OpKind)w.kind){
+            case OpKind::Pulse: backend->sendPulse(w.q1, op); break;
+            case OpKind::TwoQubitPulse: backend->sendTwoQubitPulse(w.q1, w.q2, op); break;
+            case OpKind::Rotation: backend->sendRotation(w.q1, op, w.params[0]); break;
+            case OpKind::ControlledPhase: backend->sendControlledPhase(w.q1, w.q2, w.params[0]); break;
+            case OpKind::Unitary: backend->sendUnitary(w.q1, w.params); break;
+            case OpKind::Reset: backend->reset(); break;
+            case OpKind::RngStream: { uint64_t s; std::memcpy(&s, w.params, sizeof(s)); backend->setRngStream(s); break; }
+            default: throw std::runtime_error("rpc: unknown op kind " + std::to_string(w.kind));
+        }
+    }
+
+    void runOps(const std::vector<char> &payload) {
+        for(size_t at=0;at+sizeof(WireOp)<=payload.size() && failure.empty();at+=sizeof(WireOp)){
+            WireOp w;
+            std::memcpy(&w, payload.data() + at, sizeof(w));
+            try { applyOp(w); }
+            catch(const std::exception &e) { failure = e.what(); }
+        }
+        // A frame is one burst from the client: play it as one (pulse program
+        // on hardware, see pulse.hpp)
+        if(failure.empty()){
+            try { backend->flush(); }
+            catch(const std::exception &e) { failure = e.what(); }
+        }
+    }
+
+    void runLinkWindow(const std::vector<char> &payload) {
+        PayloadReader r(payload);
+        int64_t start = r.get<int64_t>();
+        int peer = r.get<int32_t>();
+        std::vector<GlobalInstruction> gates(r.get<uint32_t>());
+        for(GlobalInstruction &g: gates){
+            WireLinkGate w = r.get<WireLinkGate>();
+            g.op = (GateOp)w.op;
+            g.a = {w.a_module, w.a_qubit};
+            g.b = {w.b_module, w.b_qubit};
+            std::copy(w.params, w.params+3, g.params);
+        }
+        if(!failure.empty()) return;
+        sleepUntil(start - opts.clock_offset_ns);
+        last_link_start = now();
+        try { backend->sendLinkWindow(peer, gates.data(), gates.size()); }
+        catch(const std::exception &e) { failure = e.what(); }
+    }
+
+    static std::vector<int> readQubits(PayloadReader &r) {
+        std::vector<int> qubits(r.get<uint32_t>());
+        for(int &q: qubits) q = r.get<int32_t>();
+        return qubits;
+    }
+
+    void handle(int fd, const FrameHeader &h, const std::vector<char> &payload) {
+        PayloadReader r(payload);
+        std::vector<char> out;
+        switch((Msg)h.type){
+            case Msg::Hello: {
+                if(r.get<uint32_t>() != protocol_magic || r.get<uint32_t>() != protocol_version) { send(fd, Msg::Error, h.seq, textPayload("protocol version mismatch")); return; }
+                std::string name = backend->name();
+                put(out, protocol_version);
+                put(out, (int32_t)backend->numQubits());
+                put(out, (int32_t)backend->readoutChannels());
+                put(out, (uint8_t)backend->supportsUnitary());
+                put(out, (uint8_t)backend->concurrentPulses());
+                put(out, (uint32_t)name.size());
+                putBytes(out, name.data(), name.size());
+                reply(fd, h.seq, out);
+                return;
+            }
+            case Msg::Ping:
+                put(out, now());
+                send(fd, Msg::Reply, h.seq, out);
+                return;
+            case Msg::Calibrate: {
+                int q = r.get<int32_t>();
+                onLine(fd, h.seq, [this, q]() { std::vector<char> p; put(p, backend->calibrate(q)); return p; });
+                return;
+            }
+            case Msg::HealthCheck: {
+                int q = r.get<int32_t>();
+                onLine(fd, h.seq, [this, q]() { std::vector<char> p; put(p, (uint8_t)backend->healthCheck(q)); return p; });
+                return;
+            }
+            case Msg::ReadRegisters: {
+                uint64_t first = r.get<uint64_t>();
+                size_t count = r.get<uint32_t>();
+                std::vector<int> qubits = readQubits(r);
+                onLine(fd, h.seq, [this, first, count, qubits]() {
+                    std::vector<uint64_t> rows(count * ((qubits.size() + 63) / 64), 0);
+                    backend->readRegisters(qubits, first, count, rows.data());
+                    std::vector<char> p;
+                    putBytes(p, rows.data(), rows.size() * sizeof(uint64_t));
+                    return p;
+                });
+                return;
+            }
+            default: break;
+        }
+        // Everything else is ordered after the lines.
+        waitLines();
+        try {
+            switch((Msg)h.type){
+                case Msg::Ops: runOps(payload); return;
+                case Msg::LinkWindow: runLinkWindow(payload); return;
+                case Msg::ReadState: {
+                    int q = r.get<int32_t>();
+                    if(failure.empty()) put(out, (int32_t)backend->readState(q));
+                    break;
+                }
+                case Msg::SampleShots: {
+                    uint64_t first = r.get<uint64_t>();
+                    int shots = (int)r.get<uint32_t>();
+                    std::vector<int> qubits = readQubits(r);
+                    ShotBuffer buf;
+                    bool sampled = failure.empty() && backend->sampleShots(qubits, first, shots, buf, &lines);
+                    put(out, (uint8_t)sampled);
+                    if(sampled) putBytes(out, buf.data().data(), buf.data().size() * sizeof(uint64_t));
+                    break;
+                }
+                case Msg::Barrier:
+                    put(out, now());
+                    put(out, last_link_start);
+                    break;
+                default:
+                    send(fd, Msg::Error, h.seq, textPayload("unknown message " + std::to_string(h.type)));
+                    return;
+            }
+        } catch(const std::exception &e) {
+            if(h.seq) send(fd, Msg::Error, h.seq, textPayload(e.what()));
+            else if(failure.empty()) failure = e.what();
+            return;
+        }
+        reply(fd, h.seq, out);
+    }
+
+    void serveConnection(int fd) {
+        FrameHeader h;
+        std::vector<char> payload;
+        try {
+            while(recvFrame(fd, h, payload)) handle(fd, h, payload);
+        } catch(const std::exception &e) {
+            if(consoleEnabled(Summary)) ConsoleLine() << "[Agent " << bound_port << "] Connection dropped: " << e.what();
+        }
+        waitLines();
+        failure.clear();
+    }
+
+public:
+    // Listens on `port` (0: any free port, see port()); serve() or start() to
+    // take connections.
+    explicit ModuleAgent(std::unique_ptr<Backend> b, int port=0, AgentOptions o={})
+        : backend(std::move(b)), opts(o), lines(std::max(1u, o.lines)) {
+        listen_fd = listenTcp(port, bound_port);
+    }
+
+    ~ModuleAgent() {
+        stop();
+        closeSocket(listen_fd);
+    }
+
+    ModuleAgent(const ModuleAgent&) = delete;
+    ModuleAgent &operator=(const ModuleAgent&) = delete;
+
+    int port() const { return bound_port; }
+
+    // Serve connections one after another until stop().
+    void serve() {
+        while(!stopping){
+            int fd = acceptTcp(listen_fd);
+            if(fd < 0) { if(stopping) break; std::this_thread::sleep_for(std::chrono::milliseconds(10)); continue; }
+            {
+                std::lock_guard<std::mutex> guard(conn_mtx);
+                conn_fd = fd;
+                if(stopping) shutdownSocket(fd);
+            }
+            serveConnection(fd);
+            {
+                std::lock_guard<std::mutex> guard(conn_mtx);
+                conn_fd = -1;
+            }
+            closeSocket(fd);
+        }
+    }
+
+    // serve() on a background thread.
+    void start() { server = std::thread([this]() { serve(); }); }
+
+    void stop() {
+        if(stopping.exchange(true)) return;
+        shutdownSocket(listen_fd);
+        {
+            std::lock_guard<std::mutex> guard(conn_mtx);
+            if(conn_fd >= 0) shutdownSocket(conn_fd);
+        }
+        if(server.joinable()) server.join();
+    }
+};
+
+}
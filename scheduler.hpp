@@ -0,0 +1,159 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "circuit_ir.hpp"
+
+// --------------------------
+// Moment Scheduler
+// --------------------------
+// Each qubit's gates form a dependency chain; a gate depends on the previous
+// gate on each of its operands. Levelling that DAG packs gates on disjoint
+// qubits (one- and two-qubit alike) into moments, so execution time follows
+// circuit depth rather than gate count. Classical bits are wires too: a
+// MEASURE is a gate on its bit, a conditional gate also sits on the bits it
+// tests, so feedback comes after the readout it depends on.
+//   ASAP: every gate runs in the earliest moment its operands allow.
+//   ALAP: every gate runs in the latest moment that still meets the depth,
+//         which keeps qubits idle (and coherent) until they are needed.
+enum class SchedulePolicy { ASAP, ALAP };
+
+// Moment index per instruction; depth is the number of moments.
+namespace detail {
+    // Level of `in` given the next free level of every wire (qubits, then
+    // classical bits from `width` on), which it then occupies.
+    inline uint32_t occupy(const Instruction &in, int width, uint32_t *frontier) {
+        uint32_t l = frontier[in.q0];
+        if(isTwoQubit(in.op)) l = std::max(l, frontier[in.q1]);
+        if(isClassical(in)){
+            int lo = in.cbit, hi = classicalEnd(in);
+            for(int b=lo;b<hi;b++) l = std::max(l, frontier[width + b]);
+            for(int b=lo;b<hi;b++) frontier[width + b] = l+1;
+        }
+        frontier[in.q0] = l+1;
+        if(isTwoQubit(in.op)) frontier[in.q1] = l+1;
+        return l;
+    }
+
+    inline int classicalWires(const std::vector<Instruction> &instrs) {
+        int bits = 0;
+        for(const Instruction &in: instrs) bits = std::max(bits, classicalEnd(in));
+        return bits;
+    }
+}
+
+inline std::vector<uint32_t> assignMoments(const std::vector<Instruction> &instrs, int width, SchedulePolicy policy, uint32_t &depth) {
+    std::vector<uint32_t> level(instrs.size());
+    std::vector<uint32_t> frontier(width + detail::classicalWires(instrs), 0);
+    depth = 0;
+    for(size_t i=0;i<instrs.size();i++){
+        uint32_t l = detail::occupy(instrs[i], width, frontier.data());
+        level[i] = l;
+        depth = std::max(depth, l+1);
+    }
+    if(policy == SchedulePolicy::ALAP){
+        std::fill(frontier.begin(), frontier.end(), 0);
+        for(size_t i=instrs.size();i-- > 0;) level[i] = depth-1-detail::occupy(instrs[i], width, frontier.data());
+    }
+    return level;
+}
+
+// Reorder the circuit moment by moment (stable within a moment, so program
+// order is kept for gates sharing a qubit).
+inline CompiledCircuit scheduleMoments(const std::vector<Instruction> &instrs, int width, SchedulePolicy policy=SchedulePolicy::ASAP) {
+    uint32_t depth;
+    std::vector<uint32_t> level = assignMoments(instrs, width, policy, depth);
+
+    std::vector<uint32_t> offsets(depth+1, 0);
+    for(uint32_t l: level) offsets[l+1]++;
+    for(uint32_t m=0;m<depth;m++) offsets[m+1] += offsets[m];
+
+    std::vector<uint32_t> cursor(offsets.begin(), offsets.end()-1);
+    std::vector<Instruction> ordered(instrs.size());
+    for(size_t i=0;i<instrs.size();i++) ordered[cursor[level[i]]++] = instrs[i];
+    return CompiledCircuit(std::move(ordered), std::move(offsets), width);
+}
+
+inline CompiledCircuit scheduleMoments(const CompiledCircuit &circuit, SchedulePolicy policy=SchedulePolicy::ASAP) {
+    return scheduleMoments(circuit.instructions(), circuit.numQubits(), policy);
+}
+
+// --------------------------
+// Streaming Scheduler
+// --------------------------
+// ASAP levelling for a circuit that arrives a gate at a time and is run in
+// pieces. Moments stay open while later gates may still join them; seal()
+// cuts every moment but the newest `hold` off as a CompiledCircuit segment,
+// and gates after that never go below the cut. Segments run in order, so each
+// one only has to respect the dependencies inside it. The price is a little
+// depth at each cut against full-circuit ASAP.
+class MomentStream {
+private:
+    std::vector<uint32_t> frontier;            // next free level per qubit
+    std::vector<uint32_t> bit_frontier;        // and per classical bit
+    std::vector<std::vector<Instruction>> open; // ring of open levels, level floor at index `first`
+    size_t first = 0, levels = 0;              // ring window over `open`
+    uint32_t floor = 0;                        // first level not yet sealed
+    size_t hold, waiting = 0;
+    int width = 0;
+
+    std::vector<Instruction> &level(uint32_t l) { return open[(first + (l - floor)) % open.size()]; }
+
+public:
+    explicit MomentStream(size_t hold_ = 2) : open(hold_ + 2), hold(hold_) {}
+
+    void push(const Instruction &in) {
+        int hi = std::max(in.q0, in.q1);
+        if(hi >= (int)frontier.size()) frontier.resize(hi+1, 0);
+        width = std::max(width, hi+1);
+        uint32_t l = std::max(frontier[in.q0], floor);
+        if(isTwoQubit(in.op)) l = std::max(l, frontier[in.q1]);
+        if(isClassical(in)){
+            int hi = classicalEnd(in);
+            if(hi > (int)bit_frontier.size()) bit_frontier.resize(hi, 0);
+            for(int b=in.cbit;b<hi;b++) l = std::max(l, bit_frontier[b]);
+            for(int b=in.cbit;b<hi;b++) bit_frontier[b] = l+1;
+        }
+        frontier[in.q0] = l+1;
+        if(isTwoQubit(in.op)) frontier[in.q1] = l+1;
+        if(l - floor >= levels){
+            if(l - floor >= open.size()){
+                // grow the ring, unrolled so level floor is back at index 0
+                std::vector<std::vector<Instruction>> grown(std::max(open.size()*2, (size_t)(l - floor) + 1));
+                for(size_t i=0;i<levels;i++) grown[i] = std::move(open[(first + i) % open.size()]);
+                open = std::move(grown);
+                first = 0;
+            }
+            levels = l - floor + 1;
+        }
+        level(l).push_back(in);
+        waiting++;
+    }
+
+    size_t pending() const { return waiting; }
+    size_t openMoments() const { return levels; }
+
+    // Seal all but the newest `hold` moments (all of them when `final`) into
+    // a segment `width_` qubits wide (at least the widest qubit seen); the
+    // segment is empty when nothing can be cut yet.
+    CompiledCircuit seal(bool final, int width_ = 0) {
+        size_t cut = final ? levels : (levels > hold ? levels - hold : 0);
+        size_t total = 0;
+        for(size_t i=0;i<cut;i++) total += open[(first + i) % open.size()].size();
+        std::vector<Instruction> instrs;
+        std::vector<uint32_t> offsets{0};
+        instrs.reserve(total);
+        offsets.reserve(cut+1);
+        for(size_t i=0;i<cut;i++){
+            std::vector<Instruction> &m = open[(first + i) % open.size()];
+            instrs.insert(instrs.end(), m.begin(), m.end());
+            offsets.push_back((uint32_t)instrs.size());
+            m.clear(); // keeps its capacity for a later level
+        }
+        first = (first + cut) % open.size();
+        levels -= cut;
+        floor += (uint32_t)cut;
+        waiting -= total;
+        return CompiledCircuit(std::move(instrs), std::move(offsets), std::max(width, width_));
+    }
+};
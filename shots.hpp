@@ -0,0 +1,189 @@
+#pragma once
+#include <vector>
+#include <map>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// --------------------------
+// Packed Shot Buffer
+// --------------------------
+// Raw readouts stored as bitstrings: shot s occupies wordsPerShot() consecutive
+// uint64_t words, bit i of the row is measured qubit qubits()[i]. 100 qubits
+// take 2 words a shot, so 100k shots of a full register fit in 1.6 MB.
+
+inline int popcount64(uint64_t x) {
+#if defined(_MSC_VER)
+    return (int)__popcnt64(x);
+#else
+    return __builtin_popcountll(x);
+#endif
+}
+
+// In-place transpose of a 64x64 bit matrix (row r, bit c) -> (row c, bit r).
+inline void transpose64(uint64_t a[64]) {
+    uint64_t m = 0x00000000FFFFFFFFull;
+    for(int j=32;j!=0;j>>=1, m^=(m<<j)){
+        for(int k=0;k<64;k=(k+j+1)&~j){
+            uint64_t t = ((a[k] >> j) ^ a[k+j]) & m;
+            a[k] ^= t << j;
+            a[k+j] ^= t;
+        }
+    }
+}
+
+class ShotBuffer {
+private:
+    std::vector<int> qubit_map;
+    size_t words = 0;
+    size_t num_shots = 0;
+    std::vector<uint64_t> bits;
+
+    void resize(size_t shots) {
+        words = (qubit_map.size()+63)/64;
+        num_shots = shots;
+        bits.assign(words*shots, 0);
+    }
+
+public:
+    ShotBuffer() = default;
+    ShotBuffer(std::vector<int> qubits, size_t shots)
+        : qubit_map(std::move(qubits)), words((qubit_map.size()+63)/64), num_shots(shots), bits(words*shots, 0) {}
+
+    // Empty buffer of another shape in the same storage: once it has held a
+    // job this size, reshaping allocates nothing. The second form labels
+    // the columns 0..width-1 (classical bits).
+    void reshape(const std::vector<int> &qubits, size_t shots) {
+        qubit_map.assign(qubits.begin(), qubits.end());
+        resize(shots);
+    }
+    void reshape(size_t width, size_t shots) {
+        qubit_map.resize(width);
+        for(size_t i=0;i<width;i++) qubit_map[i] = (int)i;
+        resize(shots);
+    }
+
+    const std::vector<int> &qubits() const { return qubit_map; }
+    size_t width() const { return qubit_map.size(); }
+    size_t shots() const { return num_shots; }
+    size_t wordsPerShot() const { return words; }
+    const std::vector<uint64_t> &data() const { return bits; }
+
+    // Same bits under other qubit labels, e.g. logical qubits read from
+    // their routed physical positions.
+    void relabel(const std::vector<int> &qubits) {
+        if(qubits.size() != qubit_map.size()) throw std::invalid_argument("ShotBuffer::relabel: width mismatch");
+        qubit_map.assign(qubits.begin(), qubits.end());
+    }
+
+    uint64_t *shot(size_t s) { return bits.data() + s*words; }
+    const uint64_t *shot(size_t s) const { return bits.data() + s*words; }
+
+    void set(size_t s, size_t i, int v) {
+        uint64_t bit = 1ull << (i & 63);
+        if(v) shot(s)[i>>6] |= bit; else shot(s)[i>>6] &= ~bit;
+    }
+    int get(size_t s, size_t i) const { return (shot(s)[i>>6] >> (i & 63)) & 1; }
+
+    // Shots [first, first+count) as their own buffer.
+    ShotBuffer rows(size_t first, size_t count) const {
+        if(first + count > num_shots) throw std::out_of_range("ShotBuffer::rows: range past the last shot");
+        ShotBuffer out(qubit_map, count);
+        std::copy(shot(first), shot(first) + count*words, out.bits.begin());
+        return out;
+    }
+
+    // Shot-major -> qubit-major: column i holds bit i of every shot, 64 shots a word.
+    std::vector<std::vector<uint64_t>> columns() const {
+        size_t blocks = (num_shots+63)/64;
+        std::vector<std::vector<uint64_t>> cols(width(), std::vector<uint64_t>(blocks, 0));
+        uint64_t tile[64];
+        for(size_t b=0;b<blocks;b++){
+            size_t n = std::min<size_t>(64, num_shots - b*64);
+            for(size_t w=0;w<words;w++){
+                for(size_t r=0;r<64;r++) tile[r] = r < n ? shot(b*64+r)[w] : 0;
+                transpose64(tile);
+                for(size_t c=0;c<64 && w*64+c<width();c++) cols[w*64+c][b] = tile[c];
+            }
+        }
+        return cols;
+    }
+
+    // Inverse of columns(): builds shot-major rows from qubit-major columns.
+    static ShotBuffer fromColumns(std::vector<int> qubits, const std::vector<std::vector<uint64_t>> &cols, size_t shots) {
+        ShotBuffer buf(std::move(qubits), shots);
+        uint64_t tile[64];
+        for(size_t b=0;b<(shots+63)/64;b++){
+            size_t n = std::min<size_t>(64, shots - b*64);
+            for(size_t w=0;w<buf.words;w++){
+                for(size_t c=0;c<64;c++) tile[c] = w*64+c < buf.width() ? cols[w*64+c][b] : 0;
+                transpose64(tile);
+                for(size_t r=0;r<n;r++) buf.shot(b*64+r)[w] = tile[r];
+            }
+        }
+        return buf;
+    }
+
+    // Number of shots that read 1, per measured qubit (tile transpose + popcount).
+    std::vector<uint64_t> ones() const { return ones(0, num_shots); }
+
+    // The same over shots [first, first+len) only.
+    std::vector<uint64_t> ones(size_t first, size_t len) const {
+        std::vector<uint64_t> count(width(), 0);
+        addOnes(first, len, count.data());
+        return count;
+    }
+
+    // Adds the ones counts of shots [first, first+len) to count[0..width).
+    void addOnes(size_t first, size_t len, uint64_t *count) const {
+        uint64_t tile[64];
+        size_t end = first + len;
+        for(size_t base=first;base<end;base+=64){
+            size_t n = std::min<size_t>(64, end - base);
+            for(size_t w=0;w<words;w++){
+                for(size_t r=0;r<64;r++) tile[r] = r < n ? shot(base+r)[w] : 0;
+                transpose64(tile);
+                for(size_t c=0;c<64 && w*64+c<width();c++) count[w*64+c] += popcount64(tile[c]);
+            }
+        }
+    }
+
+    // Outcome counts keyed by bitstring, first measured qubit leftmost. Rows
+    // are sorted and counted in runs, so only distinct outcomes allocate.
+    std::map<std::string,uint64_t> histogram() const {
+        std::vector<uint32_t> order(num_shots);
+        for(size_t s=0;s<num_shots;s++) order[s] = (uint32_t)s;
+        std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+            return std::memcmp(shot(a), shot(b), words*sizeof(uint64_t)) < 0;
+        });
+        std::map<std::string,uint64_t> hist;
+        for(size_t i=0;i<order.size();){
+            size_t j = i+1;
+            while(j < order.size() && std::memcmp(shot(order[i]), shot(order[j]), words*sizeof(uint64_t)) == 0) j++;
+            std::string key(width(), '0');
+            for(size_t q=0;q<width();q++) if(get(order[i],q)) key[q] = '1';
+            hist[key] = j-i;
+            i = j;
+        }
+        return hist;
+    }
+
+    // Legacy per-qubit view: {qubit: {"0": zeros, "1": ones}}.
+    std::map<int,std::map<std::string,int>> marginals() const { return marginals(ones()); }
+
+    // The same view from ones counts already taken (see readShots).
+    std::map<int,std::map<std::string,int>> marginals(const std::vector<uint64_t> &count) const {
+        std::map<int,std::map<std::string,int>> results;
+        for(auto q: qubit_map) results[q] = {{"0",0},{"1",0}};
+        for(size_t i=0;i<width();i++){
+            results[qubit_map[i]]["1"] += (int)count[i];
+            results[qubit_map[i]]["0"] += (int)(num_shots - count[i]);
+        }
+        return results;
+    }
+};
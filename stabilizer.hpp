@@ -0,0 +1,333 @@
+#pragma once
+#include <vector>
+#include <random>
+#include <mutex>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include "backend.hpp"
+#include "shots.hpp"
+#include "rng.hpp"
+#include "parallel_shots.hpp"
+
+// --------------------------
+// Stabilizer Tableau
+// --------------------------
+// Aaronson-Gottesman (CHP) tableau: rows 0..n-1 are destabilizers, n..2n-1
+// stabilizers, 2n is scratch. X and Z bits are packed 64 qubits per word so a
+// row multiplication (rowsum) is a handful of word ops per 64 qubits, written
+// as straight loops over contiguous words for the compiler to vectorize.
+//
+// Phases are GF(2) vectors rather than single bits: bit 0 is the constant sign
+// and bit 1+v is random measurement outcome v. rowsum is linear in the phases,
+// so one symbolic pass over a copy yields every outcome as an affine function
+// of the random bits, and shots are then drawn 64 at a time.
+class StabilizerTableau {
+private:
+    int n;
+    size_t W;  // words per X or Z row
+    size_t P;  // words per phase vector
+    std::vector<uint64_t> xs, zs, ph;
+
+    uint64_t *xrow(size_t r) { return &xs[r*W]; }
+    uint64_t *zrow(size_t r) { return &zs[r*W]; }
+    uint64_t *phase(size_t r) { return &ph[r*P]; }
+    bool xbit(size_t r, int q) const { return (xs[r*W + (q>>6)] >> (q&63)) & 1; }
+
+    // Row h <- row i * row h.
+    void rowsum(size_t h, size_t i) {
+        uint64_t *xh = xrow(h), *zh = zrow(h);
+        const uint64_t *xi = xrow(i), *zi = zrow(i);
+        int64_t g = 0;
+        for(size_t w=0;w<W;w++){
+            uint64_t x1 = xi[w], z1 = zi[w], x2 = xh[w], z2 = zh[w];
+            uint64_t plus  = (x1 & z1 & z2 & ~x2) | (x1 & ~z1 & z2 & x2) | (~x1 & z1 & x2 & ~z2);
+            uint64_t minus = (x1 & z1 & x2 & ~z2) | (x1 & ~z1 & z2 & ~x2) | (~x1 & z1 & x2 & z2);
+            g += popcount64(plus) - popcount64(minus);
+            xh[w] = x2 ^ x1;
+            zh[w] = z2 ^ z1;
+        }
+        uint64_t *ph_h = phase(h);
+        const uint64_t *ph_i = phase(i);
+        for(size_t w=0;w<P;w++) ph_h[w] ^= ph_i[w];
+        if((g & 3) == 2) ph_h[0] ^= 1;
+    }
+
+    template<typename F>
+    void forRows(int q, F &&f) {
+        size_t w = q >> 6;
+        uint64_t m = 1ull << (q & 63);
+        for(size_t r=0;r<2*(size_t)n;r++) f(xs[r*W+w], zs[r*W+w], ph[r*P], m);
+    }
+
+public:
+    StabilizerTableau(int qubits, size_t phase_words=1)
+        : n(qubits), W((qubits+63)/64), P(phase_words), xs((2*qubits+1)*W, 0), zs((2*qubits+1)*W, 0), ph((2*qubits+1)*phase_words, 0) {
+        reset();
+    }
+
+    // Back to |0...0>, in place.
+    void reset() {
+        std::fill(xs.begin(), xs.end(), 0);
+        std::fill(zs.begin(), zs.end(), 0);
+        std::fill(ph.begin(), ph.end(), 0);
+        for(int q=0;q<n;q++){
+            xrow(q)[q>>6] |= 1ull << (q&63);
+            zrow(n+q)[q>>6] |= 1ull << (q&63);
+        }
+    }
+
+    // Copy this state into `t` with room for `phase_words` words of symbolic
+    // phase, reusing t's storage.
+    void copyWithPhaseWords(StabilizerTableau &t, size_t phase_words) const {
+        t.n = n;
+        t.W = W;
+        t.P = phase_words;
+        t.xs.assign(xs.begin(), xs.end());
+        t.zs.assign(zs.begin(), zs.end());
+        t.ph.assign((2*n+1)*phase_words, 0);
+        for(size_t r=0;r<(size_t)2*n+1;r++) t.ph[r*phase_words] = ph[r*P] & 1;
+    }
+
+    int numQubits() const { return n; }
+
+    void h(int q) { forRows(q, [](uint64_t &xw, uint64_t &zw, uint64_t &p, uint64_t m) {
+        if(xw & zw & m) p ^= 1;
+        uint64_t t = (xw ^ zw) & m; xw ^= t; zw ^= t;
+    }); }
+    void s(int q) { forRows(q, [](uint64_t &xw, uint64_t &zw, uint64_t &p, uint64_t m) {
+        if(xw & zw & m) p ^= 1;
+        zw ^= xw & m;
+    }); }
+    void x(int q) { forRows(q, [](uint64_t &, uint64_t &zw, uint64_t &p, uint64_t m) { if(zw & m) p ^= 1; }); }
+    void z(int q) { forRows(q, [](uint64_t &xw, uint64_t &, uint64_t &p, uint64_t m) { if(xw & m) p ^= 1; }); }
+    void y(int q) { forRows(q, [](uint64_t &xw, uint64_t &zw, uint64_t &p, uint64_t m) { if((xw ^ zw) & m) p ^= 1; }); }
+
+    void cnot(int a, int b) {
+        size_t wa = a>>6, wb = b>>6;
+        int sa = a&63, sb = b&63;
+        for(size_t r=0;r<2*(size_t)n;r++){
+            uint64_t &xa = xs[r*W+wa], &za = zs[r*W+wa], &xb = xs[r*W+wb], &zb = zs[r*W+wb];
+            uint64_t bxa = (xa>>sa)&1, bza = (za>>sa)&1, bxb = (xb>>sb)&1, bzb = (zb>>sb)&1;
+            ph[r*P] ^= bxa & bzb & (bxb ^ bza ^ 1);
+            xb ^= bxa << sb;
+            za ^= bzb << sa;
+        }
+    }
+    void cz(int a, int b) { h(b); cnot(a,b); h(b); }
+    void swap(int a, int b) { cnot(a,b); cnot(b,a); cnot(a,b); }
+
+    // Measure qubit q in Z and write the outcome's phase vector (P words) to
+    // out. For a random outcome, chooser(phase) fills in its value: a random
+    // constant bit for a real measurement, a fresh variable when sampling.
+    template<typename Chooser>
+    void measure(int q, Chooser &&chooser, uint64_t *out) {
+        size_t p = 0;
+        for(size_t r=n;r<2*(size_t)n;r++) if(xbit(r,q)) { p = r; break; }
+        if(p){
+            for(size_t r=0;r<2*(size_t)n;r++) if(r != p && xbit(r,q)) rowsum(r,p);
+            std::copy(xrow(p), xrow(p)+W, xrow(p-n));
+            std::copy(zrow(p), zrow(p)+W, zrow(p-n));
+            std::copy(phase(p), phase(p)+P, phase(p-n));
+            std::fill(xrow(p), xrow(p)+W, 0);
+            std::fill(zrow(p), zrow(p)+W, 0);
+            zrow(p)[q>>6] |= 1ull << (q&63);
+            std::fill(phase(p), phase(p)+P, 0);
+            chooser(phase(p));
+            std::copy(phase(p), phase(p)+P, out);
+            return;
+        }
+        size_t scratch = 2*n;
+        std::fill(xrow(scratch), xrow(scratch)+W, 0);
+        std::fill(zrow(scratch), zrow(scratch)+W, 0);
+        std::fill(phase(scratch), phase(scratch)+P, 0);
+        for(int i=0;i<n;i++) if(xbit(i,q)) rowsum(scratch, n+i);
+        std::copy(phase(scratch), phase(scratch)+P, out);
+    }
+};
+
+// --------------------------
+// Stabilizer Simulator Backend
+// --------------------------
+// Polynomial in the qubit count, so a whole 100-qubit machine (or all 500
+// qubits of the supercomputer) fits in memory for pre-flight validation of
+// Clifford circuits. T, TDG and fused U pulses are rejected.
+class StabilizerBackend : public Backend {
+private:
+    int n;
+    StabilizerTableau tableau;
+    std::mt19937_64 rng;
+    uint64_t stream;  // sampleShots draws from CounterRng(rngSeed(), stream)
+    std::mutex mtx;
+
+    // sampleShots scratch, kept so repeated jobs of one shape allocate
+    // nothing: the symbolic copy, its outcome functions, and each shot
+    // chunk's random variables.
+    StabilizerTableau symbolic;
+    std::vector<uint64_t> outcome, vars;
+
+    void check(int q) const {
+        if(q < 0 || q >= n) throw std::out_of_range("StabilizerBackend: qubit " + std::to_string(q) + " out of range");
+    }
+
+public:
+    explicit StabilizerBackend(int qubits, uint64_t seed=nextStreamSeed()) : n(qubits), tableau(qubits), rng(seed), stream(seed), symbolic(qubits) {
+        if(qubits < 1) throw std::invalid_argument("StabilizerBackend: needs at least one qubit");
+    }
+
+    // Rotations are Clifford at multiples of pi/2 (CPHASE: multiples of pi);
+    // returns the multiple mod 4, or -1.
+    static int cliffordQuarterTurns(GateOp op, double angle) {
+        const double quarter = 1.57079632679489661923;
+        double k = std::round(angle / quarter);
+        if(std::abs(angle - k*quarter) > 1e-9) return -1;
+        int turns = (int)(((long long)k % 4 + 4) % 4);
+        if(op == GateOp::CPHASE && turns % 2) return -1;
+        return turns;
+    }
+
+    // True when every gate of the circuit is Clifford, i.e. it can be simulated
+    // here. Symbolic angles must be bound first.
+    static bool supports(const CompiledCircuit &circuit) {
+        if(!circuit.bound()) return false;
+        for(const Instruction &in: circuit){
+            if(in.op == GateOp::T || in.op == GateOp::TDG || in.op == GateOp::U) return false;
+            if(isRotation(in.op) && cliffordQuarterTurns(in.op, in.params[0]) < 0) return false;
+        }
+        return true;
+    }
+
+    const char *name() const override { return "stabilizer"; }
+    int numQubits() const override { return n; }
+    bool concurrentPulses() const override { return false; }
+
+    QubitCalibration calibrate(int q) override {
+        check(q);
+        QubitCalibration c;
+        c.frequency_ghz = 5.0f;
+        c.pi_amplitude = 0.5f;
+        return c;
+    }
+
+    void reset() override {
+        std::lock_guard<std::mutex> guard(mtx);
+        tableau.reset();
+    }
+
+    void sendPulse(int q, GateOp op) override {
+        check(q);
+        std::lock_guard<std::mutex> guard(mtx);
+        switch(op){
+        case GateOp::H: tableau.h(q); break;
+        case GateOp::X: tableau.x(q); break;
+        case GateOp::Y: tableau.y(q); break;
+        case GateOp::Z: tableau.z(q); break;
+        case GateOp::S: tableau.s(q); break;
+        case GateOp::SDG: tableau.s(q); tableau.z(q); break;
+        case GateOp::T:
+        case GateOp::TDG: throw std::domain_error(std::string("StabilizerBackend: ") + gateName(op) + " is not a Clifford gate");
+        default: throw std::invalid_argument(std::string("StabilizerBackend: ") + gateName(op) + " is not a single-qubit gate");
+        }
+    }
+
+    // Clifford-angle rotations, up to global phase: RZ(k pi/2) = S^k,
+    // RX = H RZ H, RY(k pi/2) = S RX(k pi/2) SDG.
+    void sendRotation(int q, GateOp op, double angle) override {
+        check(q);
+        int k = cliffordQuarterTurns(op, angle);
+        if(k < 0) throw std::domain_error(std::string("StabilizerBackend: ") + gateName(op) + " angle is not a multiple of pi/2");
+        std::lock_guard<std::mutex> guard(mtx);
+        auto rz = [&]() { for(int i=0;i<k;i++) tableau.s(q); };
+        switch(op){
+        case GateOp::RZ: rz(); break;
+        case GateOp::RX: tableau.h(q); rz(); tableau.h(q); break;
+        case GateOp::RY: tableau.s(q); tableau.z(q); tableau.h(q); rz(); tableau.h(q); tableau.s(q); break;
+        default: throw std::invalid_argument(std::string("StabilizerBackend: ") + gateName(op) + " is not a single-qubit rotation");
+        }
+    }
+
+    void sendControlledPhase(int q1, int q2, double angle) override {
+        check(q1); check(q2);
+        int k = cliffordQuarterTurns(GateOp::CPHASE, angle);
+        if(k < 0) throw std::domain_error("StabilizerBackend: CPHASE angle is not a multiple of pi");
+        if(q1 == q2) throw std::invalid_argument("StabilizerBackend: two-qubit gate on one qubit");
+        std::lock_guard<std::mutex> guard(mtx);
+        if(k == 2) tableau.cz(q1, q2);
+    }
+
+    void sendTwoQubitPulse(int q1, int q2, GateOp op) override {
+        check(q1); check(q2);
+        if(q1 == q2) throw std::invalid_argument("StabilizerBackend: two-qubit gate on one qubit");
+        std::lock_guard<std::mutex> guard(mtx);
+        switch(op){
+        case GateOp::CNOT: tableau.cnot(q1,q2); break;
+        case GateOp::CZ: tableau.cz(q1,q2); break;
+        case GateOp::SWAP: tableau.swap(q1,q2); break;
+        default: throw std::invalid_argument(std::string("StabilizerBackend: ") + gateName(op) + " is not a two-qubit gate");
+        }
+    }
+
+    void setRngStream(uint64_t stream) override {
+        std::lock_guard<std::mutex> guard(mtx);
+        this->stream = stream;
+        rng.seed(CounterRng(rngSeed(), stream).word(0, 0));
+    }
+
+    // Projective measurement; collapses the state.
+    int readState(int q) override {
+        check(q);
+        std::lock_guard<std::mutex> guard(mtx);
+        uint64_t out;
+        tableau.measure(q, [this](uint64_t *p) { p[0] = rng() & 1; }, &out);
+        return (int)(out & 1);
+    }
+
+    // Draw independent shots of `qubits` from the current state without
+    // disturbing it: measure once symbolically, then evaluate the affine
+    // outcome functions on fresh random bits, 64 shots per word. Variable v of
+    // shot s is bit s%64 of CounterRng word (s - s%64, v), keyed by absolute
+    // shot number, so a shot reads the same however the range around it is
+    // split into requests or across threads; a range starting mid-block
+    // shifts each word out of two. Blocks are shared out over the pool in
+    // shot chunks, each transposed straight into its rows of `out`.
+    bool sampleShots(const std::vector<int> &qubits, uint64_t first, int shots, ShotBuffer &out, ThreadPool *pool) override {
+        for(int q: qubits) check(q);
+        size_t m = qubits.size(), P = (m + 1 + 63) / 64;
+        std::lock_guard<std::mutex> guard(mtx);
+        outcome.assign(m*P, 0);
+        tableau.copyWithPhaseWords(symbolic, P);
+        size_t var = 0;
+        for(size_t j=0;j<m;j++){
+            symbolic.measure(qubits[j], [&var](uint64_t *p) { size_t b = 1 + var++; p[b>>6] |= 1ull << (b&63); }, &outcome[j*P]);
+        }
+        out.reshape(qubits, shots);
+        vars.resize(((size_t)shots + shot_chunk - 1) / shot_chunk * (m+1));
+        CounterRng bits(rngSeed(), stream);
+        const unsigned shift = first & 63;
+        forShotChunks(pool, (size_t)shots, [&](size_t lo, size_t n) {
+            uint64_t *v = &vars[lo / shot_chunk * (m+1)], tile[64];
+            v[0] = ~0ull; // the constant term is set in every shot
+            for(size_t b=lo/64;b<(lo+n+63)/64;b++){
+                uint64_t block = first - shift + 64*b; // absolute block holding row 64*b
+                for(size_t k=1;k<=m;k++)
+                    v[k] = shift ? bits.word(block, k) >> shift | bits.word(block + 64, k) << (64 - shift) : bits.word(block, k);
+                size_t rows = std::min<size_t>(64, lo + n - 64*b);
+                for(size_t w=0;w<out.wordsPerShot();w++){
+                    for(size_t c=0;c<64;c++){
+                        size_t j = w*64 + c;
+                        uint64_t col = 0;
+                        if(j < m){
+                            const uint64_t *f = &outcome[j*P];
+                            for(size_t k=0;k<=m;k++) if((f[k>>6] >> (k&63)) & 1) col ^= v[k];
+                        }
+                        tile[c] = col;
+                    }
+                    transpose64(tile);
+                    for(size_t r=0;r<rows;r++) out.shot(64*b + r)[w] = tile[r];
+                }
+            }
+        });
+        return true;
+    }
+};
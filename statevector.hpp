@@ -0,0 +1,384 @@
+#pragma once
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <random>
+#include <mutex>
+#include <new>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+#include "backend.hpp"
+#include "rng.hpp"
+#include "parallel_shots.hpp"
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+// --------------------------
+// Statevector Simulator Backend
+// --------------------------
+// Full 2^n amplitude vector, practical up to ~32 qubits on one node (64 GB of
+// amplitudes at 32). Kernels walk amplitude pairs by a flat pair index, so the
+// two halves of each pair are contiguous runs for every target above bit 0:
+// AVX-512 processes 4 pairs per step, AVX2 2, with a scalar tail/fallback.
+// Large vectors are split across OpenMP threads by amplitude range.
+// Single-qubit gates below bit tile_bits only mix amplitudes inside one
+// aligned tile of 2^tile_bits (256 KB), so a run of them is queued and played
+// tile by tile while each tile sits in cache: one sweep of memory per run
+// rather than per gate. Anything else that touches the vector plays the run
+// first.
+
+#if defined(_MSC_VER)
+#define QC_PRAGMA(x) __pragma(x)
+#else
+#define QC_PRAGMA(x) _Pragma(#x)
+#endif
+#if defined(_OPENMP)
+#define QC_OMP_FOR(cond) QC_PRAGMA(omp parallel for schedule(static) if(cond))
+#define QC_OMP_SUM(cond, var) QC_PRAGMA(omp parallel for schedule(static) reduction(+:var) if(cond))
+#else
+#define QC_OMP_FOR(cond)
+#define QC_OMP_SUM(cond, var)
+#endif
+
+template<typename T>
+struct AlignedAllocator {
+    using value_type = T;
+    static constexpr std::align_val_t alignment{64};
+    AlignedAllocator() = default;
+    template<typename U> AlignedAllocator(const AlignedAllocator<U>&) {}
+    T *allocate(size_t n) { return static_cast<T*>(::operator new(n*sizeof(T), alignment)); }
+    void deallocate(T *p, size_t) { ::operator delete(p, alignment); }
+    template<typename U> bool operator==(const AlignedAllocator<U>&) const { return true; }
+    template<typename U> bool operator!=(const AlignedAllocator<U>&) const { return false; }
+};
+
+class StatevectorBackend : public Backend {
+public:
+    using amp_t = std::complex<double>;
+    using Mat2 = amp_t[4]; // row-major {m00, m01, m10, m11}
+
+private:
+    int n;
+    int64_t dim;
+    std::vector<amp_t, AlignedAllocator<amp_t>> amp;
+    std::mt19937_64 rng;
+    uint64_t stream;  // sampleShots draws from CounterRng(rngSeed(), stream)
+    std::mutex mtx;
+
+    static constexpr int64_t parallel_threshold = 1 << 14;
+    static constexpr int tile_bits = 14;
+    static constexpr size_t max_tiled = 256; // queued gates before a forced sweep
+
+    struct TileGate { int k; Mat2 m; };
+    std::vector<TileGate> tiled;
+
+    // sampleShots' CDF, one entry per block of 2^sample_block_bits amplitudes
+    // (sized once, 1/1024 of the vector): a shot picks a block by binary
+    // search and its basis state by a scan inside it.
+    static constexpr int sample_block_bits = 10;
+    std::vector<double> block_cdf;
+
+    static int64_t insertZero(int64_t p, int k) {
+        int64_t lo = p & ((int64_t(1) << k) - 1);
+        return ((p >> k) << (k+1)) | lo;
+    }
+
+    void check(int q) const {
+        if(q < 0 || q >= n) throw std::out_of_range("StatevectorBackend: qubit " + std::to_string(q) + " out of range");
+    }
+
+    // (a, b) <- (m00 a + m01 b, m10 a + m11 b) for every pair split on bit k of
+    // amplitudes [base, base+len), an aligned range wider than bit k.
+    void apply1q(int k, const Mat2 &m, int64_t base, int64_t len, [[maybe_unused]] bool big) {
+        int64_t half = len >> 1, stride = int64_t(1) << k;
+        amp_t *a0 = amp.data() + base;
+        double *d = reinterpret_cast<double*>(a0);
+#if defined(__AVX512F__)
+        if(k >= 2){
+            const __m512d r00 = _mm512_set1_pd(m[0].real()), i00 = _mm512_set1_pd(m[0].imag());
+            const __m512d r01 = _mm512_set1_pd(m[1].real()), i01 = _mm512_set1_pd(m[1].imag());
+            const __m512d r10 = _mm512_set1_pd(m[2].real()), i10 = _mm512_set1_pd(m[2].imag());
+            const __m512d r11 = _mm512_set1_pd(m[3].real()), i11 = _mm512_set1_pd(m[3].imag());
+            QC_OMP_FOR(big)
+            for(int64_t p=0;p<half;p+=4){
+                int64_t i = insertZero(p,k), j = i + stride;
+                __m512d a = _mm512_loadu_pd(d+2*i), b = _mm512_loadu_pd(d+2*j);
+                __m512d as = _mm512_shuffle_pd(a, a, 0x55), bs = _mm512_shuffle_pd(b, b, 0x55);
+                __m512d na = _mm512_add_pd(_mm512_fmaddsub_pd(a, r00, _mm512_mul_pd(as, i00)), _mm512_fmaddsub_pd(b, r01, _mm512_mul_pd(bs, i01)));
+                __m512d nb = _mm512_add_pd(_mm512_fmaddsub_pd(a, r10, _mm512_mul_pd(as, i10)), _mm512_fmaddsub_pd(b, r11, _mm512_mul_pd(bs, i11)));
+                _mm512_storeu_pd(d+2*i, na);
+                _mm512_storeu_pd(d+2*j, nb);
+            }
+            return;
+        }
+#endif
+#if defined(__AVX2__)
+        if(k >= 1){
+            const __m256d r00 = _mm256_set1_pd(m[0].real()), i00 = _mm256_set1_pd(m[0].imag());
+            const __m256d r01 = _mm256_set1_pd(m[1].real()), i01 = _mm256_set1_pd(m[1].imag());
+            const __m256d r10 = _mm256_set1_pd(m[2].real()), i10 = _mm256_set1_pd(m[2].imag());
+            const __m256d r11 = _mm256_set1_pd(m[3].real()), i11 = _mm256_set1_pd(m[3].imag());
+            QC_OMP_FOR(big)
+            for(int64_t p=0;p<half;p+=2){
+                int64_t i = insertZero(p,k), j = i + stride;
+                __m256d a = _mm256_loadu_pd(d+2*i), b = _mm256_loadu_pd(d+2*j);
+                __m256d as = _mm256_permute_pd(a, 0x5), bs = _mm256_permute_pd(b, 0x5);
+                __m256d na = _mm256_add_pd(_mm256_addsub_pd(_mm256_mul_pd(a, r00), _mm256_mul_pd(as, i00)), _mm256_addsub_pd(_mm256_mul_pd(b, r01), _mm256_mul_pd(bs, i01)));
+                __m256d nb = _mm256_add_pd(_mm256_addsub_pd(_mm256_mul_pd(a, r10), _mm256_mul_pd(as, i10)), _mm256_addsub_pd(_mm256_mul_pd(b, r11), _mm256_mul_pd(bs, i11)));
+                _mm256_storeu_pd(d+2*i, na);
+                _mm256_storeu_pd(d+2*j, nb);
+            }
+            return;
+        }
+#endif
+        (void)d;
+        QC_OMP_FOR(big)
+        for(int64_t p=0;p<half;p++){
+            int64_t i = insertZero(p,k), j = i + stride;
+            amp_t a = a0[i], b = a0[j];
+            a0[i] = m[0]*a + m[1]*b;
+            a0[j] = m[2]*a + m[3]*b;
+        }
+    }
+
+    void apply1q(int k, const Mat2 &m) {
+        flushTiles();
+        apply1q(k, m, 0, dim, dim >= parallel_threshold);
+    }
+
+    // Queue m on qubit k when it stays inside a tile; otherwise play the queue
+    // and return false for the caller to apply it at once.
+    bool queued(int k, const Mat2 &m) {
+        if(k >= tile_bits || dim <= (int64_t(1) << tile_bits)) { flushTiles(); return false; }
+        tiled.push_back({k, {m[0], m[1], m[2], m[3]}});
+        if(tiled.size() >= max_tiled) flushTiles();
+        return true;
+    }
+
+    void flushTiles() {
+        if(tiled.empty()) return;
+        const int64_t tile = int64_t(1) << tile_bits, tiles = dim >> tile_bits;
+        [[maybe_unused]] const bool big = dim >= parallel_threshold;
+        QC_OMP_FOR(big)
+        for(int64_t t=0;t<tiles;t++){
+            for(const TileGate &g: tiled) apply1q(g.k, g.m, t*tile, tile, false);
+        }
+        tiled.clear();
+    }
+
+    // b <- phase * b for every pair split on bit k (Z, S, T and inverses).
+    void applyPhase(int k, amp_t phase) {
+        flushTiles();
+        int64_t half = dim >> 1, stride = int64_t(1) << k;
+        [[maybe_unused]] const bool big = dim >= parallel_threshold;
+        QC_OMP_FOR(big)
+        for(int64_t p=0;p<half;p++) amp[insertZero(p,k) + stride] *= phase;
+    }
+
+    void applyX(int k) {
+        flushTiles();
+        int64_t half = dim >> 1, stride = int64_t(1) << k;
+        [[maybe_unused]] const bool big = dim >= parallel_threshold;
+        QC_OMP_FOR(big)
+        for(int64_t p=0;p<half;p++){
+            int64_t i = insertZero(p,k);
+            std::swap(amp[i], amp[i+stride]);
+        }
+    }
+
+    // Visit every index with bits lo and hi clear (lo < hi).
+    template<typename F>
+    void forQuarter(int lo, int hi, F &&f) {
+        flushTiles();
+        int64_t quarter = dim >> 2;
+        [[maybe_unused]] const bool big = dim >= parallel_threshold;
+        QC_OMP_FOR(big)
+        for(int64_t p=0;p<quarter;p++) f(insertZero(insertZero(p,lo),hi));
+    }
+
+    double probabilityOne(int k) {
+        flushTiles();
+        int64_t half = dim >> 1, stride = int64_t(1) << k;
+        [[maybe_unused]] const bool big = dim >= parallel_threshold;
+        double p1 = 0;
+        QC_OMP_SUM(big, p1)
+        for(int64_t p=0;p<half;p++) p1 += std::norm(amp[insertZero(p,k) + stride]);
+        return p1;
+    }
+
+    // Project qubit k onto `bit` and renormalize.
+    void collapse(int k, int bit, double prob) {
+        int64_t half = dim >> 1, stride = int64_t(1) << k;
+        [[maybe_unused]] const bool big = dim >= parallel_threshold;
+        double scale = 1.0 / std::sqrt(prob);
+        QC_OMP_FOR(big)
+        for(int64_t p=0;p<half;p++){
+            int64_t i = insertZero(p,k);
+            amp_t &keep = bit ? amp[i+stride] : amp[i];
+            amp_t &drop = bit ? amp[i] : amp[i+stride];
+            keep *= scale;
+            drop = 0;
+        }
+    }
+
+public:
+    explicit StatevectorBackend(int qubits, uint64_t seed=nextStreamSeed()) : n(qubits), rng(seed), stream(seed) {
+        if(qubits < 1 || qubits > 34) throw std::invalid_argument("StatevectorBackend: supports 1..34 qubits");
+        dim = int64_t(1) << n;
+        amp.assign(dim, amp_t(0));
+        amp[0] = 1;
+        block_cdf.assign(std::max<int64_t>(1, dim >> sample_block_bits), 0.0);
+    }
+
+    const char *name() const override { return "statevector"; }
+    int numQubits() const override { return n; }
+    bool concurrentPulses() const override { return false; }
+
+    QubitCalibration calibrate(int q) override {
+        check(q);
+        QubitCalibration c;
+        c.frequency_ghz = 5.0f;
+        c.pi_amplitude = 0.5f;
+        return c;
+    }
+
+    void reset() override {
+        std::lock_guard<std::mutex> guard(mtx);
+        tiled.clear();
+        std::fill(amp.begin(), amp.end(), amp_t(0));
+        amp[0] = 1;
+    }
+
+    void sendPulse(int q, GateOp op) override {
+        check(q);
+        std::lock_guard<std::mutex> guard(mtx);
+        const double r = 1.0 / std::sqrt(2.0);
+        auto phase = [&](amp_t ph) { Mat2 m = {1, 0, 0, ph}; if(!queued(q, m)) applyPhase(q, ph); };
+        switch(op){
+        case GateOp::H: { Mat2 m = {r, r, r, -r}; if(!queued(q, m)) apply1q(q, m); break; }
+        case GateOp::X: { Mat2 m = {0, 1, 1, 0}; if(!queued(q, m)) applyX(q); break; }
+        case GateOp::Y: { Mat2 m = {0, amp_t(0,-1), amp_t(0,1), 0}; if(!queued(q, m)) apply1q(q, m); break; }
+        case GateOp::Z: phase(-1.0); break;
+        case GateOp::S: phase(amp_t(0,1)); break;
+        case GateOp::T: phase(amp_t(r,r)); break;
+        case GateOp::SDG: phase(amp_t(0,-1)); break;
+        case GateOp::TDG: phase(amp_t(r,-r)); break;
+        default: throw std::invalid_argument(std::string("StatevectorBackend: ") + gateName(op) + " is not a single-qubit gate");
+        }
+    }
+
+    bool supportsUnitary() const override { return true; }
+    void sendUnitary(int q, const double params[3]) override {
+        check(q);
+        std::lock_guard<std::mutex> guard(mtx);
+        Mat2 m;
+        u3Matrix(params[0], params[1], params[2], m);
+        if(!queued(q, m)) apply1q(q, m);
+    }
+
+    void sendRotation(int q, GateOp op, double angle) override {
+        check(q);
+        std::lock_guard<std::mutex> guard(mtx);
+        Mat2 m;
+        gateMatrix(Instruction{op, q, -1, {angle}}, m);
+        if(!queued(q, m)) apply1q(q, m);
+    }
+
+    void sendControlledPhase(int q1, int q2, double angle) override {
+        check(q1); check(q2);
+        if(q1 == q2) throw std::invalid_argument("StatevectorBackend: two-qubit gate on one qubit");
+        std::lock_guard<std::mutex> guard(mtx);
+        int64_t both = (int64_t(1) << q1) | (int64_t(1) << q2);
+        amp_t *a = amp.data();
+        amp_t phase = std::polar(1.0, angle);
+        forQuarter(std::min(q1,q2), std::max(q1,q2), [=](int64_t i) { a[i|both] *= phase; });
+    }
+
+    void sendTwoQubitPulse(int q1, int q2, GateOp op) override {
+        check(q1); check(q2);
+        if(q1 == q2) throw std::invalid_argument("StatevectorBackend: two-qubit gate on one qubit");
+        std::lock_guard<std::mutex> guard(mtx);
+        int lo = std::min(q1,q2), hi = std::max(q1,q2);
+        int64_t b1 = int64_t(1) << q1, b2 = int64_t(1) << q2;
+        amp_t *a = amp.data();
+        switch(op){
+        case GateOp::CNOT: forQuarter(lo, hi, [=](int64_t i) { std::swap(a[i|b1], a[i|b1|b2]); }); break;
+        case GateOp::CZ:   forQuarter(lo, hi, [=](int64_t i) { a[i|b1|b2] = -a[i|b1|b2]; }); break;
+        case GateOp::SWAP: forQuarter(lo, hi, [=](int64_t i) { std::swap(a[i|b1], a[i|b2]); }); break;
+        default: throw std::invalid_argument(std::string("StatevectorBackend: ") + gateName(op) + " is not a two-qubit gate");
+        }
+    }
+
+    // Play any queued run of tile gates.
+    void flush() override {
+        std::lock_guard<std::mutex> guard(mtx);
+        flushTiles();
+    }
+
+    void setRngStream(uint64_t stream) override {
+        std::lock_guard<std::mutex> guard(mtx);
+        this->stream = stream;
+        rng.seed(CounterRng(rngSeed(), stream).word(0, 0));
+    }
+
+    // Projective measurement: samples the Born probability and collapses.
+    int readState(int q) override {
+        check(q);
+        std::lock_guard<std::mutex> guard(mtx);
+        double p1 = probabilityOne(q);
+        int bit = std::uniform_real_distribution<double>(0.0, 1.0)(rng) < p1 ? 1 : 0;
+        collapse(q, bit, bit ? p1 : 1.0 - p1);
+        return bit;
+    }
+
+    // Draw independent shots of `qubits` from |amp|^2 without collapsing. The
+    // block CDF is rebuilt under the lock, which is held while drawing; shot s
+    // then inverts it at CounterRng word (s, 0), so a shot range gives the
+    // same bits serially or split across the pool in shot chunks.
+    bool sampleShots(const std::vector<int> &qubits, uint64_t first, int shots, ShotBuffer &out, ThreadPool *pool) override {
+        for(int q: qubits) check(q);
+        std::lock_guard<std::mutex> guard(mtx);
+        flushTiles();
+        const int64_t blocks = (int64_t)block_cdf.size(), block = dim / blocks;
+        const amp_t *a = amp.data();
+        double *cdf = block_cdf.data();
+        QC_OMP_FOR(dim >= parallel_threshold)
+        for(int64_t b=0;b<blocks;b++){
+            double sum = 0;
+            for(int64_t i=b*block;i<(b+1)*block;i++) sum += std::norm(a[i]);
+            cdf[b] = sum;
+        }
+        for(int64_t b=1;b<blocks;b++) cdf[b] += cdf[b-1];
+        out.reshape(qubits, shots);
+        CounterRng bits(rngSeed(), stream);
+        const double total = cdf[blocks-1];
+        forShotChunks(pool, (size_t)shots, [&](size_t lo, size_t count) {
+            for(size_t k=lo;k<lo+count;k++){
+                double u = (bits.word(first + k, 0) >> 11) * 0x1p-53 * total;
+                int64_t b = std::min<int64_t>(std::upper_bound(cdf, cdf + blocks, u) - cdf, blocks-1);
+                double acc = b ? cdf[b-1] : 0.0;
+                int64_t i = b*block, end = i + block - 1;
+                for(;i<end;i++) if((acc += std::norm(a[i])) > u) break;
+                uint64_t *row = out.shot(k);
+                for(size_t j=0;j<qubits.size();j++) row[j>>6] |= uint64_t((i >> qubits[j]) & 1) << (j & 63);
+            }
+        });
+        return true;
+    }
+
+    // Inspection for tests and validation; not available on hardware.
+    amp_t amplitude(int64_t index) {
+        std::lock_guard<std::mutex> guard(mtx);
+        flushTiles();
+        return amp[index];
+    }
+    double probability(int q) {
+        std::lock_guard<std::mutex> guard(mtx);
+        return probabilityOne(q);
+    }
+};
@@ -0,0 +1,344 @@
+// Correctness checks run by ctest: simulator results and shot replay,
+// immediate-mode errors, job batching, compile reports, pulse frames,
+// routing, QASM parsing, the binary result format and the union-find
+// decoder. Each check prints a line on failure; the run exits non-zero if
+// any failed.
+#define QC_NO_MAIN
+#include "../QuantumComputerFull.cpp"
+#include <cstdio>
+#include <cstddef>
+
+namespace {
+    int failures = 0;
+
+    void check(bool ok, const std::string &what) {
+        if(ok) return;
+        std::cerr << "FAILED: " << what << std::endl;
+        failures++;
+    }
+
+    // Play an instruction stream straight onto a backend.
+    void play(Backend &b, const std::vector<Instruction> &instrs) {
+        for(const Instruction &in: instrs){
+            if(in.op == GateOp::CPHASE) b.sendControlledPhase(in.q0, in.q1, in.params[0]);
+            else if(isTwoQubit(in.op)) b.sendTwoQubitPulse(in.q0, in.q1, in.op);
+            else if(isRotation(in.op)) b.sendRotation(in.q0, in.op, in.params[0]);
+            else if(in.op == GateOp::U) b.sendUnitary(in.q0, in.params);
+            else b.sendPulse(in.q0, in.op);
+        }
+        b.flush();
+    }
+
+    bool sameInstruction(const Instruction &a, const Instruction &b) {
+        if(a.op != b.op || a.q0 != b.q0 || a.q1 != b.q1 || a.cbit != b.cbit || a.cwidth != b.cwidth || a.cvalue != b.cvalue) return false;
+        for(int i=0;i<3;i++) if(std::abs(a.params[i] - b.params[i]) > 1e-12) return false;
+        return true;
+    }
+
+    // Bell pair: only 00 and 11, both about half the time.
+    void testBell(std::unique_ptr<Backend> backend) {
+        std::string name = backend->name();
+        QuantumComputer qc(std::move(backend), 2, "qc_tests.json");
+        qc.calibrateAll();
+        qc.seedShots(1);
+        CircuitIR bell;
+        bell.h(0);
+        bell.cnot(0, 1);
+        const int shots = 2000;
+        std::map<std::string,uint64_t> hist = qc.runShots(compile(bell), {0, 1}, shots).histogram();
+        check(hist["00"] + hist["11"] == (uint64_t)shots, name + " Bell: uncorrelated outcomes");
+        check(hist["00"] > shots/2 - 150 && hist["00"] < shots/2 + 150, name + " Bell: 00 in " + std::to_string(hist["00"]) + " of " + std::to_string(shots) + " shots");
+    }
+
+    // Bulk-sampled shots are addressed by shot number: one request for a
+    // range reads the same as any split of it, aligned to 64 or not.
+    void testShotReplay(std::unique_ptr<Backend> backend) {
+        std::string name = backend->name();
+        std::vector<int> qubits = {0, 1, 2, 3};
+        for(int q=0;q<3;q++) backend->sendPulse(q, GateOp::H);
+        backend->sendTwoQubitPulse(2, 3, GateOp::CNOT);
+        backend->flush();
+        ShotBuffer whole, part;
+        backend->sampleShots(qubits, 0, 300, whole, nullptr);
+        bool same = true;
+        for(auto [first, n]: {std::pair<uint64_t,int>{0, 100}, {100, 37}, {137, 63}, {200, 100}}){
+            backend->sampleShots(qubits, first, n, part, nullptr);
+            for(int s=0;s<n;s++) same &= std::equal(part.shot(s), part.shot(s) + part.wordsPerShot(), whole.shot(first + s));
+        }
+        check(same, name + ": shots differ between one request and a split of it");
+    }
+
+    // A failed immediate-mode gate surfaces from wait(), and a circuit that
+    // is never waited on still goes out of scope without terminating.
+    void testImmediateErrors() {
+        QuantumComputer qc(std::make_unique<StatevectorBackend>(4), 2, "qc_tests.json");
+        qc.calibrateAll();
+        qc.setCouplingMap(std::make_shared<CouplingMap>(CouplingMap::grid(2, 2)));
+        bool threw = false;
+        try {
+            QuantumCircuit c(qc);
+            c.cnot(0, 3);
+            c.wait();
+        } catch(const std::invalid_argument &) { threw = true; }
+        check(threw, "immediate mode: wait() should rethrow the uncoupled CNOT");
+        try {
+            QuantumCircuit c(qc);
+            c.cnot(0, 3);
+        } catch(...) {}
+    }
+
+    // Jobs of one circuit batch together, but not past a maintenance task
+    // queued between them: the job behind it runs after it.
+    void testJobQueueMaintenance() {
+        std::mutex m;
+        std::vector<std::string> events;
+        std::promise<void> release;
+        std::shared_future<void> released = release.get_future().share();
+        auto circuit = std::make_shared<const CompiledCircuit>(compile(CircuitIR()));
+        std::future<JobResult> a, b, c, maintenance;
+        {
+            JobQueue queue([&](const CompiledCircuit &, const std::vector<int> &qubits, int shots) {
+                released.wait();
+                std::lock_guard<std::mutex> guard(m);
+                events.push_back("run " + std::to_string(shots));
+                return ShotBuffer(qubits, shots);
+            });
+            a = queue.submit(circuit, {0}, 1);
+            while(queue.stats().queued) std::this_thread::yield(); // a is running
+            b = queue.submit(circuit, {0}, 2);
+            maintenance = queue.submitMaintenance([&]() { std::lock_guard<std::mutex> guard(m); events.push_back("maintenance"); }, 0);
+            c = queue.submit(circuit, {0}, 4);
+            release.set_value();
+        }
+        check(events == std::vector<std::string>({"run 1", "run 2", "maintenance", "run 4"}), "job queue: a job was batched past a maintenance task");
+        check(c.get().batch_size == 1, "job queue: job behind maintenance should run on its own");
+    }
+
+    // The sequence table of a pulse program image (see PulseSequencer::seal).
+    std::vector<PulseEvent> pulseEvents(const unsigned char *image) {
+        uint32_t header[4];
+        std::memcpy(header, image, sizeof(header));
+        const unsigned char *p = image + sizeof(header);
+        for(uint32_t e=0;e<header[1];e++){
+            uint32_t fresh[2];
+            std::memcpy(fresh, p, sizeof(fresh));
+            p += sizeof(fresh) + fresh[1] * 2 * sizeof(int16_t);
+        }
+        std::vector<PulseEvent> events(header[2]);
+        std::memcpy(events.data(), p, events.size() * sizeof(PulseEvent));
+        return events;
+    }
+
+    // Virtual-Z frames through two-qubit gates: a SWAP carries q0's frame to
+    // q1, and a CNOT is played as H CZ H on the target, whose drives pick up
+    // the target's frame.
+    void testPulseFrames() {
+        const double pi = 3.14159265358979323846, a = 0.3;
+        std::vector<PulseEvent> events;
+        PulseSequencer seq(2, [&](const unsigned char *image, size_t, uint32_t) { events = pulseEvents(image); });
+        auto near = [pi](double x, double y) { return std::abs(std::remainder(x - y, 2*pi)) < 1e-6; };
+
+        seq.rotation(GateOp::RZ, 0, a);
+        seq.twoQubit(GateOp::SWAP, 0, 1);
+        seq.gate(GateOp::X, 0);
+        seq.gate(GateOp::X, 1);
+        seq.flush();
+        check(near(seq.framePhase(0), 0) && near(seq.framePhase(1), a), "pulse: SWAP should exchange the two frames");
+        bool drives = events.size() == 3 && events[1].channel == 0 && events[2].channel == 1 && near(events[1].phase, 0) && near(events[2].phase, a);
+        check(drives, "pulse: drives after SWAP should carry the swapped frames");
+
+        seq.reset();
+        seq.rotation(GateOp::RZ, 1, a);
+        seq.twoQubit(GateOp::CNOT, 0, 1);
+        seq.flush();
+        check(near(seq.framePhase(0), 0) && near(seq.framePhase(1), a), "pulse: CNOT should leave the frames as RZ set them");
+        bool lowered = events.size() == 3 && events[0].channel == 1 && events[0].partner == 0xffff && near(events[0].phase, a + 3*pi/2)
+                    && events[1].channel == 0 && events[1].partner == 1
+                    && events[2].channel == 1 && events[2].partner == 0xffff && near(events[2].phase, a + pi/2);
+        check(lowered, "pulse: CNOT should be H CZ H on the target in the target's frame");
+    }
+
+    // Routed onto a 2x3 grid, a random circuit touches only coupled pairs and
+    // leaves the same state, read from the final layout.
+    void testRouting() {
+        CouplingMap grid = CouplingMap::grid(2, 3);
+        Xoshiro256 pick(11);
+        for(int trial=0;trial<20;trial++){
+            const int width = 5;
+            CircuitIR ir;
+            for(int i=0;i<40;i++){
+                int a = (int)(pick() % width), b = (a + 1 + (int)(pick() % (width-1))) % width;
+                switch(pick() % 5){
+                    case 0: ir.h(a); break;
+                    case 1: ir.t(a); break;
+                    case 2: ir.rx(a, 0.1 * (i + 1)); break;
+                    case 3: ir.cz(a, b); break;
+                    default: ir.cnot(a, b); break;
+                }
+            }
+            RoutingReport report;
+            std::vector<Instruction> routed = routeCircuit(ir.instructions(), width, grid, {}, &report);
+            bool coupled = true;
+            for(const Instruction &in: routed) if(isTwoQubit(in.op) && !grid.connected(in.q0, in.q1)) coupled = false;
+            check(coupled, "routing: gate on an uncoupled pair (trial " + std::to_string(trial) + ")");
+
+            StatevectorBackend logical(width, 1), physical(grid.numQubits(), 1);
+            play(logical, ir.instructions());
+            play(physical, routed);
+            double diff = 0;
+            for(int64_t i=0;i<(int64_t(1) << width);i++){
+                int64_t p = 0;
+                for(int q=0;q<width;q++) if(i >> q & 1) p |= int64_t(1) << report.final_layout[q];
+                diff = std::max(diff, std::abs(logical.amplitude(i) - physical.amplitude(p)));
+            }
+            check(diff < 1e-9, "routing: routed circuit differs from the original (trial " + std::to_string(trial) + ")");
+        }
+    }
+
+    // The report describes input and output whichever passes ran.
+    void testCompileReport() {
+        CircuitIR ir;
+        ir.h(0); ir.h(0); ir.cnot(0, 1); ir.x(2);
+        CompileOptions opts;
+        opts.optimize = false;
+        OptimizationReport report;
+        CompiledCircuit out = compile(ir, opts, &report);
+        check(report.gates_before == 4 && report.depth_before == 3 && report.gates_after == out.size() && report.depth_after == out.depth() && out.size() == 4,
+              "compile: report without optimization");
+        opts.optimize = true;
+        out = compile(ir, opts, &report);
+        check(report.gates_before == 4 && report.gates_after == 2 && report.depth_after == out.depth(), "compile: report with optimization");
+    }
+
+    void testQasm() {
+        std::vector<int> readout;
+        CircuitIR parsed = parseQasm("OPENQASM 2.0;\ninclude \"qelib1.inc\";\nqreg q[3];\ncreg c[3];\n"
+                                     "h q;\ncx q[0],q[1];\nrz(pi/4) q[1];\nswap q[1],q[2];\ncp(pi/2) q[0],q[2];\n"
+                                     "measure q[0] -> c[0];\nif(c==1) x q[2];\nmeasure q -> c;\n", &readout);
+        CircuitIR expected;
+        for(int q=0;q<3;q++) expected.h(q);
+        expected.cnot(0, 1);
+        expected.rz(1, 3.14159265358979323846/4);
+        expected.swap(1, 2);
+        expected.cphase(0, 2, 3.14159265358979323846/2);
+        expected.measure(0, 0);
+        expected.when(0, 3, 1).x(2);
+        bool same = parsed.size() == expected.size();
+        for(size_t i=0;same && i<parsed.size();i++) same = sameInstruction(parsed.instructions()[i], expected.instructions()[i]);
+        check(same, "qasm: parsed program differs from the hand-built IR");
+        check(readout == std::vector<int>({0, 1, 2}), "qasm: terminal measures should read q[0..2]");
+
+        // A condition on a bit past the IR's 16-bit index is a QasmError at
+        // the register, on the whole-program and the streamed path alike
+        const std::string far = "OPENQASM 2.0;\nqreg q[1];\ncreg c[40000];\nif(c[39000]==1) x q[0];\n";
+        std::string error;
+        try { parseQasm(far); } catch(const QasmError &e) { error = e.what(); }
+        check(error.rfind("qasm:4:4:", 0) == 0, "qasm: out-of-range condition bit should fail at 4:4, got \"" + error + "\"");
+        bool streamed = false;
+        try {
+            std::istringstream in(far);
+            QasmStream stream(in);
+            CompiledCircuit segment;
+            while(stream.next(segment)) {}
+        } catch(const QasmError &) { streamed = true; }
+        check(streamed, "qasm: streamed out-of-range condition bit should be a QasmError");
+    }
+
+    void testResultFile() {
+        const std::string path = "qc_tests_results.bin";
+        ShotBuffer a({3, 70, 5}, 200), b({1}, 64);
+        Xoshiro256 pick(3);
+        for(size_t s=0;s<a.shots();s++) for(size_t i=0;i<a.width();i++) a.set(s, i, (int)(pick() & 1));
+        for(size_t s=0;s<b.shots();s++) b.set(s, 0, (int)(s % 3 == 0));
+        result_store::WriterOptions opts;
+        opts.chunk_shots = 64;
+        {
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            out << result_store::encodeRecord(a, {0x1234, 7, 99, 0}, opts) << result_store::encodeRecord(b, {0x5678, 8, 100, 1}, opts);
+        }
+        {
+            result_store::ResultFile file(path);
+            check(file.size() == 2, "results: expected two records");
+            if(file.size() == 2){
+                const result_store::ResultRecord &r = file[0];
+                check(r.circuitHash() == 0x1234 && r.calibrationEpoch() == 7 && r.timestampMs() == 99 && r.sequence() == 0, "results: header fields");
+                check(r.numChunks() == 4 && r.qubits() == a.qubits(), "results: chunking or qubit map");
+                check(r.toShotBuffer().data() == a.data(), "results: shots differ after the round trip");
+                check(r.ones() == a.ones(), "results: column counts");
+                check(file[1].sequence() == 1 && file[1].toShotBuffer().data() == b.data(), "results: second record");
+            }
+        }
+
+        // A header whose shot count disagrees with its chunks is refused on
+        // open rather than followed (100 shots in 64-shot chunks, header
+        // patched to 10, then to 100 with the second chunk claiming 100)
+        std::string record = result_store::encodeRecord(ShotBuffer({0, 1}, 100), {}, opts);
+        auto refused = [&](const std::string &bytes) {
+            std::ofstream(path, std::ios::binary | std::ios::trunc) << bytes;
+            try { result_store::ResultFile file(path); }
+            catch(const std::runtime_error &) { return true; }
+            return false;
+        };
+        std::string patched = record;
+        uint64_t shots = 10;
+        std::memcpy(&patched[offsetof(result_store::RecordHeader, shots)], &shots, sizeof(shots));
+        check(refused(patched), "results: a record with fewer header shots than chunk shots was accepted");
+        patched = record;
+        size_t second = result_store::pad8(result_store::pad8(sizeof(result_store::RecordHeader) + 2*sizeof(int32_t)) + sizeof(result_store::ChunkHeader) + 2*8);
+        uint32_t chunk = 100;
+        std::memcpy(&patched[second + offsetof(result_store::ChunkHeader, shots)], &chunk, sizeof(chunk));
+        check(refused(patched), "results: a chunk larger than the record's chunk size was accepted");
+        std::remove(path.c_str());
+    }
+
+    // Distance-7 repetition code over 10 noisy rounds and a final readout:
+    // every pattern of up to 3 faults (data flips at any round, measurement
+    // errors) must decode to no logical error.
+    void testUnionFind() {
+        const int d = 7, rounds = 10, t = (d-1)/2;
+        QecCode code = QecCode::repetition(d);
+        UnionFindDecoder decoder(code);
+        Xoshiro256 pick(5);
+        int bad = 0;
+        for(int trial=0;trial<2000;trial++){
+            int faults = 1 + trial % t;
+            std::vector<int> data_round(d, -1);                              // round a data flip appears, -1 for none
+            std::vector<std::vector<uint8_t>> meas(rounds, std::vector<uint8_t>(d-1, 0));
+            for(int f=0;f<faults;f++){
+                if(trial < 1000 || pick() % 2) data_round[pick() % d] = (int)(pick() % rounds);
+                else meas[pick() % rounds][pick() % (d-1)] ^= 1;
+            }
+            decoder.reset();
+            std::vector<uint8_t> flipped(d), syndrome(d-1);
+            for(int r=0;r<=rounds;r++){
+                for(int q=0;q<d;q++) flipped[q] = data_round[q] >= 0 && data_round[q] <= r;
+                for(int k=0;k<d-1;k++) syndrome[k] = (flipped[k] ^ flipped[k+1]) ^ (r < rounds ? meas[r][k] : 0);
+                decoder.push(syndrome.data(), r == rounds);
+            }
+            bool ok = true;
+            for(int q=0;q<d;q++) ok &= (decoder.frame()[q] ^ flipped[q]) == 0;
+            if(!ok) bad++;
+        }
+        check(bad == 0, "union-find: " + std::to_string(bad) + " fault patterns of weight <= (d-1)/2 not corrected");
+    }
+}
+
+int main() {
+    setConsoleVerbosity(Quiet);
+    testBell(std::make_unique<StatevectorBackend>(2));
+    testBell(std::make_unique<StabilizerBackend>(2));
+    testShotReplay(std::make_unique<StatevectorBackend>(4, 9));
+    testShotReplay(std::make_unique<StabilizerBackend>(4, 9));
+    testImmediateErrors();
+    testJobQueueMaintenance();
+    testRouting();
+    testCompileReport();
+    testPulseFrames();
+    testQasm();
+    testResultFile();
+    testUnionFind();
+    std::remove("qc_tests.json");
+    if(failures) { std::cerr << failures << " check(s) failed" << std::endl; return 1; }
+    std::cout << "All checks passed" << std::endl;
+    return 0;
+}
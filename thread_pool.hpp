@@ -0,0 +1,200 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <exception>
+#include <type_traits>
+
+// --------------------------
+// Work-stealing Thread Pool
+// --------------------------
+// Long-lived workers, one deque each. A worker pops its own deque from the
+// front and steals from the back of the others when it runs dry, so a burst of
+// gates submitted from one thread still spreads across every control channel.
+//
+// parallelFor doesn't go through the deques: its chunks are claimed by index
+// from a descriptor on the caller's stack, so a moment dispatch allocates
+// nothing. Chunks are taken before deque tasks.
+class ThreadPool {
+private:
+    struct Worker {
+        std::deque<std::function<void()>> tasks;
+        std::mutex mtx;
+    };
+
+    // One parallelFor in flight, linked into `bulk` while it has unclaimed chunks.
+    struct Bulk {
+        void (*run)(void *fn, size_t lo, size_t hi);
+        void *fn;
+        size_t n, step, chunks;
+        size_t claimed = 0;                // under bulk_mtx
+        std::atomic<size_t> unfinished;
+        std::atomic<bool> failed{false};
+        std::exception_ptr error;          // written by the first failing chunk
+        Bulk *next = nullptr;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::mutex wake_mtx;
+    std::condition_variable wake;
+    std::atomic<size_t> pending{0};
+    std::atomic<size_t> next{0};
+    bool stopping = false;
+    std::mutex bulk_mtx;
+    Bulk *bulk = nullptr;
+    std::mutex finished_mtx;
+    std::condition_variable finished;
+
+    static inline thread_local const ThreadPool *current_pool = nullptr;
+    static inline thread_local size_t current_index = 0;
+
+    bool popLocal(size_t i, std::function<void()> &task) {
+        std::lock_guard<std::mutex> guard(workers[i]->mtx);
+        if(workers[i]->tasks.empty()) return false;
+        task = std::move(workers[i]->tasks.front());
+        workers[i]->tasks.pop_front();
+        return true;
+    }
+
+    // Next unclaimed chunk of `only`, or of any bulk job if null.
+    bool claim(Bulk *only, Bulk *&b, size_t &chunk) {
+        std::lock_guard<std::mutex> guard(bulk_mtx);
+        Bulk **link = &bulk;
+        while(*link && only && *link != only) link = &(*link)->next;
+        if(!*link) return false;
+        b = *link;
+        chunk = b->claimed++;
+        if(b->claimed == b->chunks) *link = b->next;
+        pending--;
+        return true;
+    }
+
+    void runChunk(Bulk *b, size_t chunk) {
+        size_t lo = chunk*b->step, hi = std::min(b->n, lo + b->step);
+        try { b->run(b->fn, lo, hi); }
+        catch(...) { if(!b->failed.exchange(true)) b->error = std::current_exception(); }
+        if(b->unfinished.fetch_sub(1) == 1) { std::lock_guard<std::mutex> guard(finished_mtx); finished.notify_all(); }
+    }
+
+    bool steal(size_t thief, std::function<void()> &task) {
+        for(size_t k=1;k<workers.size();k++){
+            Worker &victim = *workers[(thief+k)%workers.size()];
+            std::lock_guard<std::mutex> guard(victim.mtx);
+            if(victim.tasks.empty()) continue;
+            task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            return true;
+        }
+        return false;
+    }
+
+    void run(size_t i) {
+        current_pool = this;
+        current_index = i;
+        std::function<void()> task;
+        Bulk *b;
+        size_t chunk;
+        for(;;){
+            if(claim(nullptr, b, chunk)) { runChunk(b, chunk); continue; }
+            if(popLocal(i,task) || steal(i,task)){
+                pending--;
+                task();
+                task = nullptr;
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(wake_mtx);
+            wake.wait(lock, [this]{ return stopping || pending > 0; });
+            if(stopping && pending == 0) return;
+        }
+    }
+
+public:
+    // n == 0 sizes the pool to the number of hardware threads.
+    explicit ThreadPool(unsigned n=0) {
+        if(n == 0) n = std::max(1u, std::thread::hardware_concurrency());
+        for(unsigned i=0;i<n;i++) workers.push_back(std::make_unique<Worker>());
+        for(unsigned i=0;i<n;i++) threads.emplace_back([this, i]() { run(i); });
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> guard(wake_mtx);
+            stopping = true;
+        }
+        wake.notify_all();
+        for(auto &t: threads) t.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool &operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return workers.size(); }
+
+    // Queue a task and get a future for its result. Tasks submitted from a
+    // worker land on that worker's own deque; external submits round-robin.
+    template<typename F>
+    auto submit(F &&f) -> std::future<decltype(f())> {
+        using R = decltype(f());
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+        std::future<R> result = task->get_future();
+        size_t i = (current_pool == this) ? current_index : next++ % workers.size();
+        {
+            // Count before publishing so a worker never sees the task without it.
+            std::lock_guard<std::mutex> guard(wake_mtx);
+            pending++;
+        }
+        {
+            std::lock_guard<std::mutex> guard(workers[i]->mtx);
+            workers[i]->tasks.emplace_back([task]() { (*task)(); });
+        }
+        wake.notify_one();
+        return result;
+    }
+
+    // Run fn(i) for every i in [0,n), split into contiguous chunks across the
+    // workers. The caller works through unclaimed chunks itself rather than
+    // sitting idle, then waits for the ones still running elsewhere.
+    template<typename F>
+    void parallelFor(size_t n, F &&fn) {
+        if(n == 0) return;
+        using Fn = std::remove_reference_t<F>;
+        Bulk job;
+        job.run = [](void *f, size_t lo, size_t hi) { for(size_t i=lo;i<hi;i++) (*static_cast<Fn*>(f))(i); };
+        job.fn = (void*)&fn;
+        job.n = n;
+        job.chunks = std::min(n, size() + (current_pool == this ? 0 : 1));
+        job.step = (n + job.chunks - 1) / job.chunks;
+        job.chunks = (n + job.step - 1) / job.step;
+        job.unfinished = job.chunks;
+        if(job.chunks > 1){
+            {
+                std::lock_guard<std::mutex> guard(wake_mtx);
+                pending += job.chunks;
+            }
+            {
+                std::lock_guard<std::mutex> guard(bulk_mtx);
+                job.next = bulk;
+                bulk = &job;
+            }
+            wake.notify_all();
+            Bulk *b;
+            size_t chunk;
+            while(claim(&job, b, chunk)) runChunk(&job, chunk);
+        }
+        else runChunk(&job, 0);
+        for(int spin=0;job.unfinished.load() && spin<64;spin++) std::this_thread::yield();
+        if(job.unfinished.load()){
+            std::unique_lock<std::mutex> lock(finished_mtx);
+            finished.wait(lock, [&job]() { return job.unfinished.load() == 0; });
+        }
+        if(job.error) std::rethrow_exception(job.error);
+    }
+};